@@ -0,0 +1,75 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+# Measures how quickly connections are accepted: with an accept per readiness
+# event as in examples/echo_server.rb, and with Selector#accept_loop. Client
+# processes connect and disconnect as fast as they can.
+#
+#   CONNECTIONS=20000 CLIENTS=4 BACKEND=io_uring ruby benchmark/accept_rate.rb
+
+$LOAD_PATH.push File.expand_path("../lib", __dir__)
+require "nio"
+require "socket"
+
+CONNECTIONS = Integer(ENV.fetch("CONNECTIONS", "10000"))
+CLIENTS = Integer(ENV.fetch("CLIENTS", "4"))
+BATCH = Integer(ENV.fetch("BATCH", "64"))
+BACKEND = ENV["BACKEND"]&.to_sym
+
+def connect(port)
+  CLIENTS.times.map do
+    fork do
+      (CONNECTIONS / CLIENTS).times do
+        TCPSocket.new("127.0.0.1", port).close
+      rescue Errno::ECONNREFUSED, Errno::ECONNRESET, Errno::EADDRNOTAVAIL
+        retry
+      end
+    end
+  end
+end
+
+def measure(name)
+  selector = NIO::Selector.new(BACKEND)
+  server = TCPServer.new("127.0.0.1", 0)
+  server.listen(1024)
+  accepted = 0
+  total = CONNECTIONS / CLIENTS * CLIENTS
+
+  accept = yield selector, server
+  start = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+  clients = connect(server.local_address.ip_port)
+
+  selector.select { |ready| accepted += accept.call(ready) } while accepted < total
+
+  elapsed = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start
+  format("%-12s %10.0f connections/s", name, total / elapsed)
+ensure
+  clients&.each { |pid| Process.wait(pid) }
+  selector&.close
+  server&.close
+end
+
+puts "nio4r #{NIO::VERSION} (#{NIO.engine}, #{NIO::Selector.new(BACKEND).backend}), #{CONNECTIONS} connections from #{CLIENTS} clients"
+
+puts(measure("accept") do |selector, server|
+  selector.register(server, :r)
+
+  lambda do |_monitor|
+    socket = server.accept_nonblock(exception: false)
+    next 0 if socket == :wait_readable
+
+    socket.close
+    1
+  end
+end)
+
+puts(measure("accept_loop") do |selector, server|
+  selector.accept_loop(server, batch: BATCH)
+
+  lambda do |operation|
+    operation.data.each(&:close)
+    operation.data.size
+  end
+end)
@@ -0,0 +1,60 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+# Measures threads writing large ByteBuffers to files alongside a thread doing
+# Ruby work, with and without the GVL released during each write. Holding the
+# GVL stalls the other threads for the whole copy into the page cache.
+#
+#   SIZE=8388608 THREADS=4 DURATION=3 ruby benchmark/bytebuffer_gvl.rb
+#
+# The pure Ruby implementation writes with Ruby's IO, which always releases
+# the GVL, so both runs should look the same there.
+
+$LOAD_PATH.push File.expand_path("../lib", __dir__)
+require "nio"
+require "etc"
+require "tempfile"
+
+SIZE = Integer(ENV.fetch("SIZE", 8 * 1_048_576))
+THREADS = Integer(ENV.fetch("THREADS", 4))
+DURATION = Float(ENV.fetch("DURATION", "3"))
+
+def measure(threshold)
+  NIO::ByteBuffer.gvl_threshold = threshold
+  deadline = Process.clock_gettime(Process::CLOCK_MONOTONIC) + DURATION
+
+  writers = Array.new(THREADS) do
+    Thread.new do
+      buffer = NIO::ByteBuffer.new(SIZE)
+      buffer << "x" * SIZE
+      written = 0
+
+      Tempfile.create("nio4r") do |file|
+        while Process.clock_gettime(Process::CLOCK_MONOTONIC) < deadline
+          buffer.rewind
+          written += buffer.write_to(file) while buffer.remaining.positive?
+          file.rewind
+        end
+      end
+
+      written
+    end
+  end
+
+  ticker = Thread.new do
+    ticks = 0
+    ticks += 1 while Process.clock_gettime(Process::CLOCK_MONOTONIC) < deadline
+    ticks
+  end
+
+  [writers.sum(&:value), ticker.value]
+end
+
+puts "nio4r #{NIO::VERSION} (#{NIO.engine}), #{THREADS} threads writing #{SIZE} byte buffers, #{Etc.nprocessors} CPUs"
+
+{"holding the GVL" => 1 << 62, "releasing the GVL" => 65_536}.each do |label, threshold|
+  written, ticks = measure(threshold)
+  printf("%-20s %10.1f MiB/s written, %12d ticks in another thread\n", label, written / DURATION / 1_048_576, ticks)
+end
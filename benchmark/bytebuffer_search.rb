@@ -0,0 +1,80 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+# Measures framing lines and finding delimiters in a ByteBuffer natively,
+# against pulling its bytes into Ruby with each and [].
+#
+#   LINE=64 LINES=1024 ITERATIONS=200 ruby benchmark/bytebuffer_search.rb
+#
+# The pure Ruby [] unpacks the whole buffer on every call, so keep ITERATIONS
+# small with NIO4R_PURE=true.
+
+$LOAD_PATH.push File.expand_path("../lib", __dir__)
+require "nio"
+require "benchmark"
+
+LINE = Integer(ENV.fetch("LINE", 64))
+LINES = Integer(ENV.fetch("LINES", 1024))
+ITERATIONS = Integer(ENV.fetch("ITERATIONS", 200))
+
+data = ("x" * (LINE - 2) + "\r\n") * LINES
+buffer = NIO::ByteBuffer.new(data.bytesize)
+buffer << data
+buffer.flip
+
+body = "y" * (LINES * LINE) + "\r\n\r\n"
+body_buffer = NIO::ByteBuffer.new(body.bytesize)
+body_buffer << body
+body_buffer.flip
+
+puts "nio4r #{NIO::VERSION} (#{NIO.engine}), #{LINES} lines of #{LINE} bytes, #{ITERATIONS} iterations"
+
+Benchmark.bm(24) do |x|
+  x.report("lines with each") do
+    ITERATIONS.times do
+      buffer.rewind
+      line = String.new
+      buffer.each do |byte|
+        line << byte
+        line = String.new if byte == 10
+      end
+    end
+  end
+
+  x.report("lines with []") do
+    ITERATIONS.times do
+      start = 0
+      limit = buffer.limit
+      i = 0
+      while i < limit
+        if buffer[i] == 10
+          buffer.position = start
+          buffer.get(i + 1 - start)
+          start = i + 1
+        end
+        i += 1
+      end
+    end
+  end
+
+  x.report("lines with read_line") do
+    ITERATIONS.times do
+      buffer.rewind
+      nil while buffer.read_line(chomp: true)
+    end
+  end
+
+  x.report("CRLFCRLF with []") do
+    ITERATIONS.times do
+      limit = body_buffer.limit - 3
+      i = 0
+      i += 1 until i >= limit || (body_buffer[i] == 13 && body_buffer[i + 1] == 10 && body_buffer[i + 2] == 13 && body_buffer[i + 3] == 10)
+    end
+  end
+
+  x.report("CRLFCRLF with index") do
+    ITERATIONS.times { body_buffer.index("\r\n\r\n", 0) }
+  end
+end
@@ -0,0 +1,55 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+# Measures dispatching ready monitors to Procs stored as their values, with
+# every registered pipe readable on every select: from a block yielded each
+# monitor as libev finds it, from a block yielded them once the loop has run,
+# by having the selector call the values itself, and from an array.
+#
+#   SIZE=2000 TICKS=500 ruby benchmark/selector_dispatch.rb
+
+$LOAD_PATH.push File.expand_path("../lib", __dir__)
+require "nio"
+require "benchmark"
+
+SIZE = Integer(ENV.fetch("SIZE", 2000))
+TICKS = Integer(ENV.fetch("TICKS", 500))
+
+pipes = Array.new(SIZE) { IO.pipe }
+pipes.each { |_, writer| writer << "x" }
+
+def with_selector(dispatch, pipes)
+  selector = NIO::Selector.new(dispatch: dispatch)
+  handled = 0
+  handler = proc { |_monitor| handled += 1 }
+  pipes.each { |reader, _| selector.register(reader, :r).value = handler }
+
+  yield selector
+ensure
+  selector&.close
+end
+
+puts "nio4r #{NIO::VERSION} (#{NIO.engine}), #{SIZE} ready monitors, #{TICKS} selects"
+
+Benchmark.bm(24) do |x|
+  %i[inline deferred].each do |dispatch|
+    with_selector(dispatch, pipes) do |selector|
+      x.report("#{dispatch} block") { TICKS.times { selector.select { |monitor| monitor.value.call(monitor) } } }
+    end
+  end
+
+  with_selector(:call, pipes) do |selector|
+    x.report("call values") { TICKS.times { selector.select } }
+  end
+
+  with_selector(:inline, pipes) do |selector|
+    ready = []
+    x.report("select_into and each") do
+      TICKS.times { selector.select_into(ready).each { |monitor| monitor.value.call(monitor) } }
+    end
+  end
+end
+
+pipes.flatten.each(&:close)
@@ -0,0 +1,84 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+# Measures fibers waiting for readable pipes the way a Fiber::Scheduler would:
+# registering a monitor for every wait and deregistering it afterwards, against
+# NIO::Selector#io_wait. Reports waits per second and objects allocated by each,
+# including the String each fiber reads once it's woken up.
+#
+#   FIBERS=100 ROUNDS=1000 ruby benchmark/selector_io_wait.rb
+
+$LOAD_PATH.push File.expand_path("../lib", __dir__)
+require "nio"
+
+FIBERS = Integer(ENV.fetch("FIBERS", 100))
+ROUNDS = Integer(ENV.fetch("ROUNDS", 1000))
+
+def measure(selector, pipes, fibers)
+  fibers.each(&:resume)
+
+  allocated = GC.stat(:total_allocated_objects)
+  started_at = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+
+  ROUNDS.times do
+    pipes.each { |_, writer| writer.write_nonblock("x") }
+    yield
+  end
+
+  elapsed = Process.clock_gettime(Process::CLOCK_MONOTONIC) - started_at
+  waits = FIBERS * ROUNDS
+
+  [waits / elapsed, (GC.stat(:total_allocated_objects) - allocated).fdiv(waits)]
+end
+
+def with_pipes
+  pipes = Array.new(FIBERS) { IO.pipe }
+  yield NIO::Selector.new, pipes
+ensure
+  pipes.flatten.each(&:close)
+end
+
+puts "nio4r #{NIO::VERSION} (#{NIO.engine}), #{FIBERS} fibers, #{ROUNDS} rounds"
+
+results = {}
+
+results["monitor per wait"] = with_pipes do |selector, pipes|
+  waiting = {}
+  fibers = pipes.map do |reader, _|
+    Fiber.new do
+      loop do
+        waiting[selector.register(reader, :r)] = Fiber.current
+        Fiber.yield
+        reader.read_nonblock(1)
+      end
+    end
+  end
+
+  measure(selector, pipes, fibers) do
+    selector.select do |monitor|
+      selector.deregister(monitor.io)
+      waiting.delete(monitor).resume
+    end
+  end
+end
+
+if NIO::Selector.method_defined?(:io_wait)
+  results["io_wait"] = with_pipes do |selector, pipes|
+    fibers = pipes.map do |reader, _|
+      Fiber.new do
+        loop do
+          selector.io_wait(reader, IO::READABLE)
+          reader.read_nonblock(1)
+        end
+      end
+    end
+
+    measure(selector, pipes, fibers) { selector.select }
+  end
+end
+
+results.each do |label, (rate, allocations)|
+  printf("%-18s %12.0f waits/s %8.2f objects allocated per wait\n", label, rate, allocations)
+end
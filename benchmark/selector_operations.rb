@@ -0,0 +1,59 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+# Measures the per-call overhead of the synchronized selector operations.
+
+$LOAD_PATH.push File.expand_path("../lib", __dir__)
+require "nio"
+require "benchmark"
+
+ITERATIONS = Integer(ENV.fetch("ITERATIONS", 200_000))
+
+selector = NIO::Selector.new
+reader, writer = IO.pipe
+writer << "x"
+
+ready = reader
+unready = IO.pipe.first
+selector.register(ready, :r)
+
+puts "nio4r #{NIO::VERSION} (#{NIO.engine}, #{selector.backend}), #{ITERATIONS} iterations"
+
+Benchmark.bm(24) do |x|
+  x.report("register/deregister") do
+    ITERATIONS.times do
+      selector.register(unready, :r)
+      selector.deregister(unready)
+    end
+  end
+
+  batch = Array.new(500) { IO.pipe.first }
+
+  x.report("register x500") do
+    (ITERATIONS / 500).times do
+      batch.each { |io| selector.register(io, :r) }
+      batch.each { |io| selector.deregister(io) }
+    end
+  end
+
+  x.report("register_all x500") do
+    (ITERATIONS / 500).times do
+      selector.register_all(batch, :r)
+      selector.deregister_all(batch)
+    end
+  end
+
+  x.report("select(0)") do
+    ITERATIONS.times { selector.select(0) }
+  end
+
+  x.report("select(0) with block") do
+    ITERATIONS.times { selector.select(0) { |_monitor| } }
+  end
+
+  x.report("closed?") do
+    ITERATIONS.times { selector.closed? }
+  end
+end
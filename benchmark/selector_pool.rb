@@ -0,0 +1,53 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+# Measures how readiness throughput scales with the number of selectors in a
+# NIO::SelectorPool. Each pipe keeps itself busy: whenever its reader becomes
+# readable, a byte is read and another one written back.
+#
+#   SHARDS=1,2,4,8 PIPES=1000 DURATION=5 ruby benchmark/selector_pool.rb
+
+$LOAD_PATH.push File.expand_path("../lib", __dir__)
+require "nio"
+require "etc"
+
+SHARDS = ENV.fetch("SHARDS", [1, 2, 4, Etc.nprocessors].uniq.join(",")).split(",").map { |size| Integer(size) }
+PIPES = Integer(ENV.fetch("PIPES", "1000"))
+DURATION = Float(ENV.fetch("DURATION", "3"))
+
+_soft, hard = Process.getrlimit(:NOFILE)
+Process.setrlimit(:NOFILE, hard)
+
+def measure(shards)
+  pipes = Array.new(PIPES) { IO.pipe }
+
+  pool = NIO::SelectorPool.new(shards) do |monitor|
+    monitor.io.read_nonblock(1, exception: false)
+    monitor.value[0].write_nonblock("x", exception: false)
+    monitor.value[1] += 1
+  end
+
+  monitors = pipes.map do |reader, writer|
+    monitor = pool.register(reader, :r)
+    monitor.value = [writer, 0]
+    monitor
+  end
+
+  pipes.each { |_reader, writer| writer << "x" }
+  sleep DURATION
+  pool.close
+
+  events = monitors.sum { |monitor| monitor.value[1] }
+  format("%-3d shards %10.0f events/s", shards, events / DURATION)
+ensure
+  pool&.close
+  pipes&.flatten&.each(&:close)
+end
+
+puts "nio4r #{NIO::VERSION} (#{NIO.engine}, #{NIO::Selector.new.backend}), #{PIPES} pipes"
+
+SHARDS.each do |shards|
+  puts measure(shards)
+end
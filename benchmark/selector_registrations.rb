@@ -0,0 +1,55 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+# Measures registration throughput and selector memory usage with many
+# registered IO objects. Raise the open file limit to run the larger sizes:
+#
+#   ulimit -n 2100000 && ruby benchmark/selector_registrations.rb
+
+$LOAD_PATH.push File.expand_path("../lib", __dir__)
+require "nio"
+require "benchmark"
+require "objspace"
+
+SIZES = ENV.fetch("SIZES", "10000,100000,1000000").split(",").map { |size| Integer(size) }
+
+_soft, hard = Process.getrlimit(:NOFILE)
+Process.setrlimit(:NOFILE, hard)
+
+def measure(size)
+  ios = []
+  (size / 2).times { ios.concat(IO.pipe) }
+
+  selector = NIO::Selector.new
+
+  register = Benchmark.realtime { ios.each { |io| selector.register(io, :r) } }
+  # Include any table of selectables the selector keeps as a Ruby object
+  memory = ObjectSpace.memsize_of(selector)
+  memory += ObjectSpace.reachable_objects_from(selector).grep(Hash).sum { |hash| ObjectSpace.memsize_of(hash) }
+  lookup = Benchmark.realtime { ios.each { |io| selector.registered?(io) } }
+  deregister = Benchmark.realtime { ios.each { |io| selector.deregister(io) } }
+
+  format(
+    "%-9d register %8.0f/s  registered? %9.0f/s  deregister %8.0f/s  selector %7.1f MiB",
+    size,
+    size / register,
+    size / lookup,
+    size / deregister,
+    memory / 1024.0 / 1024.0
+  )
+ensure
+  selector&.close
+  ios&.each(&:close)
+end
+
+puts "nio4r #{NIO::VERSION} (#{NIO.engine}, #{NIO::Selector.new.backend})"
+
+SIZES.each do |size|
+  if size + 64 > hard
+    puts format("%-9d skipped (open file limit is %d)", size, hard)
+  else
+    puts measure(size)
+  end
+end
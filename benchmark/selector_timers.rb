@@ -0,0 +1,35 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+# Measures keepalive-style idle timers: adding one per connection, pushing
+# them all back as if each connection had just seen activity, and selecting
+# with every timer pending.
+#
+#   SIZES=10000,200000 ruby benchmark/selector_timers.rb
+
+$LOAD_PATH.push File.expand_path("../lib", __dir__)
+require "nio"
+require "benchmark"
+
+SIZES = ENV.fetch("SIZES", "10000,200000").split(",").map { |size| Integer(size) }
+
+puts "nio4r #{NIO::VERSION} (#{NIO.engine})"
+
+SIZES.each do |size|
+  selector = NIO::Selector.new
+  timers = nil
+
+  add = Benchmark.realtime { timers = Array.new(size) { |i| selector.add_timer(30, i) } }
+  reschedule = Benchmark.realtime { timers.each { |timer| timer.reschedule(30) } }
+  select = Benchmark.realtime { selector.select(0) }
+  cancel = Benchmark.realtime { timers.each(&:cancel) }
+
+  printf(
+    "%8d timers: add %7.1f ns, reschedule %7.1f ns, cancel %7.1f ns each, select %8.3f ms\n",
+    size, add * 1e9 / size, reschedule * 1e9 / size, cancel * 1e9 / size, select * 1e3
+  )
+
+  selector.close
+end
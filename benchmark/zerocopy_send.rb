@@ -0,0 +1,78 @@
+#!/usr/bin/env ruby
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+# Measures write throughput over a loopback TCP connection with large
+# messages, copying them into the socket and sending them with MSG_ZEROCOPY.
+# A few messages are kept in flight at once, each in a buffer of its own.
+#
+#   SIZES=16384,262144,1048576 DURATION=3 INFLIGHT=4 ruby benchmark/zerocopy_send.rb
+#
+# Loopback never transmits straight from the buffer: the kernel copies it once
+# it reaches the receiving socket, so this measures the overhead of pinning
+# and completions. The savings only show up with a real network device.
+#
+# With TCP, the kernel lets go of a buffer once the data has been
+# acknowledged, so small messages wait out the peer's delayed ACKs unless
+# enough of them are in flight.
+
+$LOAD_PATH.push File.expand_path("../lib", __dir__)
+require "nio"
+require "socket"
+
+SIZES = ENV.fetch("SIZES", "16384,262144,1048576").split(",").map { |size| Integer(size) }
+DURATION = Float(ENV.fetch("DURATION", "3"))
+INFLIGHT = Integer(ENV.fetch("INFLIGHT", "4"))
+
+def measure(size, zerocopy)
+  server = TCPServer.new("127.0.0.1", 0)
+  client = TCPSocket.new("127.0.0.1", server.local_address.ip_port)
+  peer = server.accept
+
+  drain = Thread.new do
+    buffer = String.new(capacity: 1 << 20)
+    loop { peer.readpartial(1 << 20, buffer) }
+  rescue IOError, SystemCallError
+  end
+
+  selector = NIO::Selector.new
+  monitor = selector.register(client, :w)
+  monitor.interests = nil
+
+  buffers = Array.new(INFLIGHT) { NIO::ByteBuffer.new(size).tap { |buffer| buffer << "x" * size } }
+  buffers.each { |buffer| monitor.submit_write(buffer.flip, zerocopy: zerocopy) }
+
+  written = zerocopied = 0
+  deadline = Process.clock_gettime(Process::CLOCK_MONOTONIC) + DURATION
+
+  while Process.clock_gettime(Process::CLOCK_MONOTONIC) < deadline
+    selector.select(1) do |operation|
+      written += operation.result
+      zerocopied += operation.result if operation.zerocopy?
+
+      buffer = operation.buffer
+      buffer.flip if buffer.remaining.zero?
+      monitor.submit_write(buffer, zerocopy: zerocopy)
+    end
+  end
+
+  format(
+    "%-8d %-9s %10.1f MiB/s %5.1f%% zero-copy",
+    size,
+    zerocopy ? "zerocopy" : "copy",
+    written / DURATION / (1 << 20),
+    written.zero? ? 0 : 100.0 * zerocopied / written
+  )
+ensure
+  selector&.close
+  [client, peer, server].each { |io| io&.close }
+  drain&.join
+end
+
+puts "nio4r #{NIO::VERSION} (#{NIO.engine}, #{NIO::Selector.new.backend}), #{INFLIGHT} messages in flight"
+
+SIZES.each do |size|
+  puts measure(size, false)
+  puts measure(size, true)
+end
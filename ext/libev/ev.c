@@ -3191,6 +3191,43 @@ ev_backend (EV_P) EV_NOEXCEPT
   return backend;
 }
 
+/* ########## NIO4R PATCHERY HO! ########## */
+int
+ev_iouring_submit (EV_P_ ev_iouring_op *op, int kind, int fd, void *buf, unsigned int len, int index) EV_NOEXCEPT
+{
+#if EV_USE_IOURING
+  if (backend == EVBACKEND_IOURING)
+    {
+      iouring_op_submit (EV_A_ op, kind, fd, buf, len, index);
+      return 0;
+    }
+#endif
+
+  return -1;
+}
+
+void
+ev_iouring_cancel (EV_P_ ev_iouring_op *op) EV_NOEXCEPT
+{
+#if EV_USE_IOURING
+  if (backend == EVBACKEND_IOURING)
+    iouring_op_cancel (EV_A_ op);
+#endif
+}
+
+int
+ev_iouring_register (EV_P_ unsigned int opcode, void *arg, unsigned int nr_args) EV_NOEXCEPT
+{
+#if EV_USE_IOURING
+  if (backend == EVBACKEND_IOURING)
+    return evsys_io_uring_register (iouring_fd, opcode, arg, nr_args);
+#endif
+
+  errno = ENOSYS;
+  return -1;
+}
+/* ######################################## */
+
 #if EV_FEATURE_API
 unsigned int
 ev_iteration (EV_P) EV_NOEXCEPT
@@ -4400,7 +4437,7 @@ ev_io_start (EV_P_ ev_io *w) EV_NOEXCEPT
     return;
 
   assert (("libev: ev_io_start called with negative fd", fd >= 0));
-  assert (("libev: ev_io_start called with illegal event mask", !(w->events & ~(EV__IOFDSET | EV_READ | EV_WRITE))));
+  assert (("libev: ev_io_start called with illegal event mask", !(w->events & ~(EV__IOFDSET | EV__IOEDGE | EV_READ | EV_WRITE))));
 
 #if EV_VERIFY >= 2
   assert (("libev: ev_io_start called on watcher with invalid fd", fd_valid (fd)));
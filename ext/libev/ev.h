@@ -224,6 +224,9 @@ enum {
   EV_READ     =            0x01, /* ev_io detected read will not block */
   EV_WRITE    =            0x02, /* ev_io detected write will not block */
   EV__IOFDSET =            0x80, /* internal use only */
+/* ########## NIO4R PATCHERY HO! ########## */
+  EV__IOEDGE  =            0x40, /* request edge-triggered notification where the backend supports it, for every watcher on the fd */
+/* ######################################## */
   EV_IO       =         EV_READ, /* alias for type-detection */
   EV_TIMER    =      0x00000100, /* timer timed out */
 #if EV_COMPAT3
@@ -616,6 +619,34 @@ EV_API_DECL unsigned int ev_backend (EV_P) EV_NOEXCEPT; /* backend in use by loo
 
 EV_API_DECL void ev_now_update (EV_P) EV_NOEXCEPT; /* update event loop time */
 
+/* ########## NIO4R PATCHERY HO! ########## */
+/* reads and writes submitted directly to the io_uring backend. the callback */
+/* is invoked from within the backend poll with the number of bytes */
+/* transferred, or a negated errno, and the cqe flags, so it must not call */
+/* back into the loop. multishot receives invoke it once per buffer filled */
+typedef struct ev_iouring_op
+{
+  void (*cb)(EV_P_ struct ev_iouring_op *op, int res, unsigned int flags);
+} ev_iouring_op;
+
+enum {
+  EV_IOURING_READ,
+  EV_IOURING_WRITE,
+  EV_IOURING_READ_FIXED,    /* from/into the registered buffer index */
+  EV_IOURING_WRITE_FIXED,
+  EV_IOURING_RECV_MULTISHOT,  /* into buffers provided by group index, buf and len are unused */
+  EV_IOURING_ACCEPT_MULTISHOT /* connections, with index as accept4 flags, buf and len are unused */
+};
+
+/* returns 0 if the operation was queued, -1 if the backend is not io_uring */
+EV_API_DECL int ev_iouring_submit (EV_P_ ev_iouring_op *op, int kind, int fd, void *buf, unsigned int len, int index) EV_NOEXCEPT;
+/* ask the kernel to cancel a submitted operation, which still completes */
+EV_API_DECL void ev_iouring_cancel (EV_P_ ev_iouring_op *op) EV_NOEXCEPT;
+/* io_uring_register (2) on the loop's ring, returns -1 with errno ENOSYS if */
+/* the backend is not io_uring. registrations are lost if the ring is recreated */
+EV_API_DECL int ev_iouring_register (EV_P_ unsigned int opcode, void *arg, unsigned int nr_args) EV_NOEXCEPT;
+/* ######################################## */
+
 #if EV_WALK_ENABLE
 /* walk (almost) all watchers in the loop of a given type, invoking the */
 /* callback on every such watcher. The callback might stop the watcher, */
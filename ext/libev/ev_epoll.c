@@ -91,7 +91,10 @@ epoll_modify (EV_P_ int fd, int oev, int nev)
   ev.data.u64 = (uint64_t)(uint32_t)fd
               | ((uint64_t)(uint32_t)++anfds [fd].egen << 32);
   ev.events   = (nev & EV_READ  ? EPOLLIN  : 0)
-              | (nev & EV_WRITE ? EPOLLOUT : 0);
+              | (nev & EV_WRITE ? EPOLLOUT : 0)
+/* ########## NIO4R PATCHERY HO! ########## */
+              | (nev & EV__IOEDGE ? EPOLLET : 0);
+/* ######################################## */
 
   if (ecb_expect_true (!epoll_ctl (backend_fd, oev && oldmask != nev ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev)))
     return;
@@ -201,7 +204,10 @@ epoll_poll (EV_P_ ev_tstamp timeout)
            * to EV_READ or EV_WRITE, we might issue redundant EPOLL_CTL_MOD calls.
            */
           ev->events = (want & EV_READ  ? EPOLLIN  : 0)
-                     | (want & EV_WRITE ? EPOLLOUT : 0);
+                     | (want & EV_WRITE ? EPOLLOUT : 0)
+/* ########## NIO4R PATCHERY HO! ########## */
+                     | (want & EV__IOEDGE ? EPOLLET : 0);
+/* ######################################## */
 
           /* pre-2.6.9 kernels require a non-null pointer with EPOLL_CTL_DEL, */
           /* which is fortunately easy to do for us. */
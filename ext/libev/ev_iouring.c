@@ -178,6 +178,28 @@ struct io_uring_params
 #define IORING_OP_POLL_REMOVE     7
 #define IORING_OP_TIMEOUT        11
 #define IORING_OP_TIMEOUT_REMOVE 12
+/* ########## NIO4R PATCHERY HO! ########## */
+#define IORING_OP_READ_FIXED      4
+#define IORING_OP_WRITE_FIXED     5
+#define IORING_OP_ACCEPT         13
+#define IORING_OP_ASYNC_CANCEL   14
+#define IORING_OP_READ           22
+#define IORING_OP_WRITE          23
+#define IORING_OP_RECV           27
+
+#define IOSQE_BUFFER_SELECT   (1U << 5)
+#define IORING_RECV_MULTISHOT (1U << 1)
+#define IORING_ACCEPT_MULTISHOT (1U << 0)
+
+#ifndef SYS_io_uring_register
+# define SYS_io_uring_register 427
+#endif
+
+/* user_data of ev_iouring_op submissions, which are told apart from poll */
+/* requests by the top bit, so generation counters only use 31 bits */
+#define EV_IOURING_OP_TAG ((__u64)1 << 63)
+#define EV_IOURING_GEN(fd) ((uint32_t)anfds [fd].egen & 0x7fffffffU)
+/* ######################################## */
 
 /* relative or absolute, reference clock is CLOCK_MONOTONIC */
 struct iouring_kernel_timespec
@@ -212,6 +234,15 @@ evsys_io_uring_enter (int fd, unsigned to_submit, unsigned min_complete, unsigne
   return ev_syscall6 (SYS_io_uring_enter, fd, to_submit, min_complete, flags, sig, sigsz);
 }
 
+/* ########## NIO4R PATCHERY HO! ########## */
+inline_size
+int
+evsys_io_uring_register (int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+  return ev_syscall4 (SYS_io_uring_register, fd, opcode, arg, nr_args);
+}
+/* ######################################## */
+
 /*****************************************************************************/
 /* actual backed implementation */
 
@@ -283,7 +314,15 @@ iouring_sqe_get (EV_P)
 
   /*assert (("libev: io_uring queue full after flush", tail + 1 - EV_SQ_VAR (head) <= EV_SQ_VAR (ring_entries)));*/
 
-  return EV_SQES + (tail & EV_SQ_VAR (ring_mask));
+/* ########## NIO4R PATCHERY HO! ########## */
+  /* operations set flags and fields the poll requests leave alone, so */
+  /* entries are no longer "properly" initialised when they are reused */
+  {
+    struct io_uring_sqe *sqe = EV_SQES + (tail & EV_SQ_VAR (ring_mask));
+    memset (sqe, 0, sizeof (*sqe));
+    return sqe;
+  }
+/* ######################################## */
 }
 
 inline_size
@@ -445,7 +484,7 @@ iouring_modify (EV_P_ int fd, int oev, int nev)
        * be removed. Since we don't *really* have that, we pass in the old
        * generation counter - if that fails, too bad, it will hopefully be removed
        * at close time and then be ignored. */
-      sqe->addr      = (uint32_t)fd | ((__u64)(uint32_t)anfds [fd].egen << 32);
+      sqe->addr      = (uint32_t)fd | ((__u64)EV_IOURING_GEN (fd) << 32);
       sqe->user_data = (uint64_t)-1;
       iouring_sqe_submit (EV_A_ sqe);
 
@@ -459,7 +498,7 @@ iouring_modify (EV_P_ int fd, int oev, int nev)
       sqe->opcode      = IORING_OP_POLL_ADD;
       sqe->fd          = fd;
       sqe->addr        = 0;
-      sqe->user_data   = (uint32_t)fd | ((__u64)(uint32_t)anfds [fd].egen << 32);
+      sqe->user_data   = (uint32_t)fd | ((__u64)EV_IOURING_GEN (fd) << 32);
       sqe->poll_events =
         (nev & EV_READ ? POLLIN : 0)
         | (nev & EV_WRITE ? POLLOUT : 0);
@@ -467,6 +506,64 @@ iouring_modify (EV_P_ int fd, int oev, int nev)
     }
 }
 
+/* ########## NIO4R PATCHERY HO! ########## */
+inline_size
+void
+iouring_op_submit (EV_P_ ev_iouring_op *op, int kind, int fd, void *buf, unsigned int len, int index)
+{
+  static const __u8 opcodes [] = {
+    IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED, IORING_OP_RECV, IORING_OP_ACCEPT
+  };
+
+  struct io_uring_sqe *sqe = iouring_sqe_get (EV_A);
+  sqe->opcode    = opcodes [kind];
+  sqe->flags     = 0;
+  sqe->ioprio    = 0;
+  sqe->fd        = fd;
+  sqe->off       = (__u64)-1; /* the current file position, which streams ignore */
+  sqe->addr      = (__u64)(uintptr_t)buf;
+  sqe->len       = len;
+  sqe->rw_flags  = 0;
+  sqe->buf_index = kind == EV_IOURING_READ_FIXED || kind == EV_IOURING_WRITE_FIXED ? index : 0;
+  sqe->user_data = (__u64)(uintptr_t)op | EV_IOURING_OP_TAG;
+
+  if (kind == EV_IOURING_RECV_MULTISHOT)
+    {
+      sqe->flags     = IOSQE_BUFFER_SELECT;
+      sqe->ioprio    = IORING_RECV_MULTISHOT;
+      sqe->off       = 0;
+      sqe->addr      = 0;
+      sqe->len       = 0;
+      sqe->buf_index = index; /* the buffer group */
+    }
+  else if (kind == EV_IOURING_ACCEPT_MULTISHOT)
+    {
+      sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+      sqe->off          = 0; /* no peer address */
+      sqe->addr         = 0;
+      sqe->len          = 0;
+      sqe->accept_flags = index;
+    }
+
+  iouring_sqe_submit (EV_A_ sqe);
+}
+
+inline_size
+void
+iouring_op_cancel (EV_P_ ev_iouring_op *op)
+{
+  struct io_uring_sqe *sqe = iouring_sqe_get (EV_A);
+  sqe->opcode       = IORING_OP_ASYNC_CANCEL;
+  sqe->fd           = -1;
+  sqe->off          = 0;
+  sqe->addr         = (__u64)(uintptr_t)op | EV_IOURING_OP_TAG;
+  sqe->len          = 0;
+  sqe->cancel_flags = 0;
+  sqe->user_data    = (uint64_t)-1;
+  iouring_sqe_submit (EV_A_ sqe);
+}
+/* ######################################## */
+
 inline_size
 void
 iouring_tfd_update (EV_P_ ev_tstamp timeout)
@@ -502,6 +599,15 @@ iouring_process_cqe (EV_P_ struct io_uring_cqe *cqe)
   if (cqe->user_data == (uint64_t)-1)
     return;
 
+/* ########## NIO4R PATCHERY HO! ########## */
+  if (cqe->user_data & EV_IOURING_OP_TAG)
+    {
+      ev_iouring_op *op = (ev_iouring_op *)(uintptr_t)(cqe->user_data & ~EV_IOURING_OP_TAG);
+      op->cb (EV_A_ op, res, cqe->flags);
+      return;
+    }
+/* ######################################## */
+
   assert (("libev: io_uring fd must be in-bounds", fd >= 0 && fd < anfdmax));
 
   /* documentation lies, of course. the result value is NOT like
@@ -513,7 +619,7 @@ iouring_process_cqe (EV_P_ struct io_uring_cqe *cqe)
   /* ignore event if generation doesn't match */
   /* other than skipping removal events, */
   /* this should actually be very rare */
-  if (ecb_expect_false (gen != (uint32_t)anfds [fd].egen))
+  if (ecb_expect_false (gen != EV_IOURING_GEN (fd)))
     return;
 
   if (ecb_expect_false (res < 0))
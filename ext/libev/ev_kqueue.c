@@ -76,11 +76,14 @@ kqueue_modify (EV_P_ int fd, int oev, int nev)
   /* to detect close/reopen reliably, we have to re-add */
   /* event requests even when oev == nev */
 
+/* ########## NIO4R PATCHERY HO! ########## */
+  /* EV_CLEAR resets the filter state after delivery, i.e. edge-triggered */
   if (nev & EV_READ)
-    kqueue_change (EV_A_ fd, EVFILT_READ , EV_ADD | EV_ENABLE, NOTE_EOF);
+    kqueue_change (EV_A_ fd, EVFILT_READ , EV_ADD | EV_ENABLE | (nev & EV__IOEDGE ? EV_CLEAR : 0), NOTE_EOF);
 
   if (nev & EV_WRITE)
-    kqueue_change (EV_A_ fd, EVFILT_WRITE, EV_ADD | EV_ENABLE, NOTE_EOF);
+    kqueue_change (EV_A_ fd, EVFILT_WRITE, EV_ADD | EV_ENABLE | (nev & EV__IOEDGE ? EV_CLEAR : 0), NOTE_EOF);
+/* ######################################## */
 }
 
 static void
@@ -1,5 +1,31 @@
 #include "nio4r.h"
 
+#include <limits.h>
+#include <sys/uio.h>
+
+#include "ruby/thread.h"
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+/* The most buffers a single readv or writev can transfer */
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* Transfers this large or larger are made without the GVL by default */
+#define NIO_BYTEBUFFER_GVL_THRESHOLD 65536
+
+/* A read or write of one or more buffers */
+struct NIO_ByteBuffer_transfer {
+    VALUE io;
+    int fd, writing, count, error;
+    struct iovec *iovecs;
+    struct NIO_ByteBuffer **vectored;
+    ssize_t result;
+};
+
 static VALUE mNIO = Qnil;
 static VALUE cNIO_ByteBuffer = Qnil;
 static VALUE cNIO_ByteBuffer_OverflowError = Qnil;
@@ -11,6 +37,12 @@ static VALUE NIO_ByteBuffer_allocate(VALUE klass);
 static void NIO_ByteBuffer_free(void *data);
 static size_t NIO_ByteBuffer_memsize(const void *data);
 
+/* Class methods */
+static VALUE NIO_ByteBuffer_write_all_to(VALUE klass, VALUE io, VALUE buffers);
+static VALUE NIO_ByteBuffer_read_all_from(VALUE klass, VALUE io, VALUE buffers);
+static VALUE NIO_ByteBuffer_get_gvl_threshold(VALUE klass);
+static VALUE NIO_ByteBuffer_set_gvl_threshold(VALUE klass, VALUE threshold);
+
 /* Methods */
 static VALUE NIO_ByteBuffer_initialize(VALUE self, VALUE capacity);
 static VALUE NIO_ByteBuffer_clear(VALUE self);
@@ -22,7 +54,11 @@ static VALUE NIO_ByteBuffer_capacity(VALUE self);
 static VALUE NIO_ByteBuffer_remaining(VALUE self);
 static VALUE NIO_ByteBuffer_full(VALUE self);
 static VALUE NIO_ByteBuffer_get(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_ByteBuffer_view(int argc, VALUE *argv, VALUE self);
 static VALUE NIO_ByteBuffer_fetch(VALUE self, VALUE index);
+static VALUE NIO_ByteBuffer_index(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_ByteBuffer_read_until(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_ByteBuffer_read_line(int argc, VALUE *argv, VALUE self);
 static VALUE NIO_ByteBuffer_put(VALUE self, VALUE string);
 static VALUE NIO_ByteBuffer_write_to(VALUE self, VALUE file);
 static VALUE NIO_ByteBuffer_read_from(VALUE self, VALUE file);
@@ -34,7 +70,18 @@ static VALUE NIO_ByteBuffer_compact(VALUE self);
 static VALUE NIO_ByteBuffer_each(VALUE self);
 static VALUE NIO_ByteBuffer_inspect(VALUE self);
 
-#define MARK_UNSET -1
+/* Internal functions */
+static int NIO_ByteBuffer_iovecs(VALUE buffers, struct iovec *iovecs, struct NIO_ByteBuffer **vectored, int writing);
+static int NIO_ByteBuffer_remaining_length(struct NIO_ByteBuffer *buffer, VALUE length);
+static long NIO_ByteBuffer_find(struct NIO_ByteBuffer *buffer, VALUE pattern, long offset, long *pattern_length);
+static VALUE NIO_ByteBuffer_take_until(struct NIO_ByteBuffer *buffer, VALUE delimiter, VALUE options);
+static void NIO_ByteBuffer_advance(struct NIO_ByteBuffer **vectored, int count, ssize_t nbytes);
+static ssize_t NIO_ByteBuffer_transfer(VALUE io, struct NIO_ByteBuffer **vectored, struct iovec *iovecs, int count, int writing);
+static VALUE NIO_ByteBuffer_transfer_blocking(VALUE data);
+static VALUE NIO_ByteBuffer_transfer_unpin(VALUE data);
+static void *NIO_ByteBuffer_transfer_without_gvl(void *data);
+
+static size_t NIO_ByteBuffer_gvl_threshold = NIO_BYTEBUFFER_GVL_THRESHOLD;
 
 /* Compatibility for Ruby <= 3.1 */
 #ifndef HAVE_RB_IO_DESCRIPTOR
@@ -48,6 +95,11 @@ io_descriptor_fallback(VALUE io)
 #define rb_io_descriptor io_descriptor_fallback
 #endif
 
+/* Compatibility for Ruby <= 3.3, which exports this without declaring it */
+#if !defined(HAVE_RB_IO_BLOCKING_REGION) && defined(HAVE_RB_THREAD_IO_BLOCKING_REGION)
+VALUE rb_thread_io_blocking_region(rb_blocking_function_t *func, void *data, int fd);
+#endif
+
 static void
 io_set_nonblock(VALUE io)
 {
@@ -68,6 +120,11 @@ void Init_NIO_ByteBuffer()
 
     rb_include_module(cNIO_ByteBuffer, rb_mEnumerable);
 
+    rb_define_singleton_method(cNIO_ByteBuffer, "write_all_to", NIO_ByteBuffer_write_all_to, 2);
+    rb_define_singleton_method(cNIO_ByteBuffer, "read_all_from", NIO_ByteBuffer_read_all_from, 2);
+    rb_define_singleton_method(cNIO_ByteBuffer, "gvl_threshold", NIO_ByteBuffer_get_gvl_threshold, 0);
+    rb_define_singleton_method(cNIO_ByteBuffer, "gvl_threshold=", NIO_ByteBuffer_set_gvl_threshold, 1);
+
     rb_define_method(cNIO_ByteBuffer, "initialize", NIO_ByteBuffer_initialize, 1);
     rb_define_method(cNIO_ByteBuffer, "clear", NIO_ByteBuffer_clear, 0);
     rb_define_method(cNIO_ByteBuffer, "position", NIO_ByteBuffer_get_position, 0);
@@ -79,7 +136,11 @@ void Init_NIO_ByteBuffer()
     rb_define_method(cNIO_ByteBuffer, "remaining", NIO_ByteBuffer_remaining, 0);
     rb_define_method(cNIO_ByteBuffer, "full?", NIO_ByteBuffer_full, 0);
     rb_define_method(cNIO_ByteBuffer, "get", NIO_ByteBuffer_get, -1);
+    rb_define_method(cNIO_ByteBuffer, "view", NIO_ByteBuffer_view, -1);
     rb_define_method(cNIO_ByteBuffer, "[]", NIO_ByteBuffer_fetch, 1);
+    rb_define_method(cNIO_ByteBuffer, "index", NIO_ByteBuffer_index, -1);
+    rb_define_method(cNIO_ByteBuffer, "read_until", NIO_ByteBuffer_read_until, -1);
+    rb_define_method(cNIO_ByteBuffer, "read_line", NIO_ByteBuffer_read_line, -1);
     rb_define_method(cNIO_ByteBuffer, "<<", NIO_ByteBuffer_put, 1);
     rb_define_method(cNIO_ByteBuffer, "read_from", NIO_ByteBuffer_read_from, 1);
     rb_define_method(cNIO_ByteBuffer, "write_to", NIO_ByteBuffer_write_to, 1);
@@ -108,22 +169,113 @@ static VALUE NIO_ByteBuffer_allocate(VALUE klass)
 {
     struct NIO_ByteBuffer *bytebuffer = (struct NIO_ByteBuffer *)xmalloc(sizeof(struct NIO_ByteBuffer));
     bytebuffer->buffer = NULL;
+    bytebuffer->size_class = -1;
+    bytebuffer->pins = 0;
+    bytebuffer->shared = NULL;
+    bytebuffer->mapping = NULL;
+    bytebuffer->mapping_length = 0;
+    bytebuffer->readonly = 0;
     return TypedData_Wrap_Struct(klass, &NIO_ByteBuffer_type, bytebuffer);
 }
 
+struct NIO_ByteBuffer *NIO_ByteBuffer_unwrap(VALUE self)
+{
+    struct NIO_ByteBuffer *buffer;
+    TypedData_Get_Struct(self, struct NIO_ByteBuffer, &NIO_ByteBuffer_type, buffer);
+    return buffer;
+}
+
 static void NIO_ByteBuffer_free(void *data)
 {
     struct NIO_ByteBuffer *buffer = (struct NIO_ByteBuffer *)data;
-    if (buffer->buffer)
-        xfree(buffer->buffer);
+    NIO_ByteBuffer_release(buffer);
     xfree(buffer);
 }
 
+void NIO_ByteBuffer_release(struct NIO_ByteBuffer *buffer)
+{
+#ifdef HAVE_SYS_MMAN_H
+    if (buffer->mapping) {
+        munmap(buffer->mapping, buffer->mapping_length);
+        buffer->mapping = NULL;
+        buffer->mapping_length = 0;
+        buffer->readonly = 0;
+    } else
+#endif
+    if (buffer->shared) {
+        NIO_ByteBuffer_memory_release(buffer->shared);
+    } else if (buffer->size_class >= 0) {
+        NIO_ByteBuffer_Pool_release(buffer->buffer, buffer->size_class);
+    } else if (buffer->buffer) {
+        xfree(buffer->buffer);
+    }
+
+    buffer->buffer = NULL;
+    buffer->size_class = -1;
+    buffer->shared = NULL;
+}
+
+void NIO_ByteBuffer_memory_release(struct NIO_ByteBuffer_memory *memory)
+{
+    if (--memory->refs > 0) {
+        return;
+    }
+
+    if (memory->size_class >= 0) {
+        NIO_ByteBuffer_Pool_release(memory->data, memory->size_class);
+    } else {
+        xfree(memory->data);
+    }
+
+    xfree(memory);
+}
+
+/* Copy on write: Views keep the memory they share, and the buffer carries on
+   with a copy. Nothing is copied if the Views have all been collected */
+void NIO_ByteBuffer_modify(struct NIO_ByteBuffer *buffer, int preserve)
+{
+    struct NIO_ByteBuffer_memory *shared = buffer->shared;
+    char *data;
+
+    if (buffer->readonly) {
+        rb_raise(rb_eIOError, "buffer is read-only");
+    }
+
+    if (!shared) {
+        return;
+    }
+
+    if (shared->refs > 1) {
+        data = buffer->size_class >= 0 ? NIO_ByteBuffer_Pool_take(buffer->size_class) : xmalloc(buffer->capacity);
+        if (preserve) {
+            memcpy(data, buffer->buffer, buffer->capacity);
+        }
+
+        /* Allocating may have collected the last View */
+        buffer->buffer = data;
+        NIO_ByteBuffer_memory_release(shared);
+    } else {
+        xfree(shared);
+    }
+
+    buffer->shared = NULL;
+}
+
+void NIO_ByteBuffer_pin(struct NIO_ByteBuffer *buffer)
+{
+    __atomic_add_fetch(&buffer->pins, 1, __ATOMIC_RELAXED);
+}
+
+void NIO_ByteBuffer_unpin(struct NIO_ByteBuffer *buffer)
+{
+    __atomic_sub_fetch(&buffer->pins, 1, __ATOMIC_RELEASE);
+}
+
 static size_t NIO_ByteBuffer_memsize(const void *data)
 {
     const struct NIO_ByteBuffer *buffer = (const struct NIO_ByteBuffer *)data;
     size_t memsize = sizeof(struct NIO_ByteBuffer);
-    if (buffer->buffer)
+    if (buffer->buffer && !buffer->mapping)
         memsize += buffer->capacity;
     return memsize;
 }
@@ -146,7 +298,11 @@ static VALUE NIO_ByteBuffer_clear(VALUE self)
     struct NIO_ByteBuffer *buffer;
     TypedData_Get_Struct(self, struct NIO_ByteBuffer, &NIO_ByteBuffer_type, buffer);
 
-    memset(buffer->buffer, 0, buffer->capacity);
+    /* Mapped memory is the file's, so it's left alone */
+    if (!buffer->mapping) {
+        NIO_ByteBuffer_modify(buffer, 0);
+        memset(buffer->buffer, 0, buffer->capacity);
+    }
 
     buffer->position = 0;
     buffer->limit = buffer->capacity;
@@ -257,6 +413,37 @@ static VALUE NIO_ByteBuffer_get(int argc, VALUE *argv, VALUE self)
     TypedData_Get_Struct(self, struct NIO_ByteBuffer, &NIO_ByteBuffer_type, buffer);
 
     rb_scan_args(argc, argv, "01", &length);
+    len = NIO_ByteBuffer_remaining_length(buffer, length);
+
+    result = rb_str_new(buffer->buffer + buffer->position, len);
+    buffer->position += len;
+
+    return result;
+}
+
+/* Like get, but returns an NIO::ByteBuffer::View of the data rather than
+   copying it into a String. The buffer is copied instead if it's written to
+   while Views of it are still around */
+static VALUE NIO_ByteBuffer_view(int argc, VALUE *argv, VALUE self)
+{
+    int len;
+    VALUE length, result;
+    struct NIO_ByteBuffer *buffer;
+    TypedData_Get_Struct(self, struct NIO_ByteBuffer, &NIO_ByteBuffer_type, buffer);
+
+    rb_scan_args(argc, argv, "01", &length);
+    len = NIO_ByteBuffer_remaining_length(buffer, length);
+
+    result = NIO_ByteBuffer_View_new(buffer, buffer->position, len);
+    buffer->position += len;
+
+    return result;
+}
+
+/* The length of data get and view are asked for, or all that remains */
+static int NIO_ByteBuffer_remaining_length(struct NIO_ByteBuffer *buffer, VALUE length)
+{
+    int len;
 
     if (length == Qnil) {
         len = buffer->limit - buffer->position;
@@ -272,10 +459,7 @@ static VALUE NIO_ByteBuffer_get(int argc, VALUE *argv, VALUE self)
         rb_raise(cNIO_ByteBuffer_UnderflowError, "not enough data in buffer");
     }
 
-    result = rb_str_new(buffer->buffer + buffer->position, len);
-    buffer->position += len;
-
-    return result;
+    return len;
 }
 
 static VALUE NIO_ByteBuffer_fetch(VALUE self, VALUE index)
@@ -297,6 +481,118 @@ static VALUE NIO_ByteBuffer_fetch(VALUE self, VALUE index)
     return INT2NUM(buffer->buffer[i]);
 }
 
+/* Index of the first occurrence of a byte (given as an Integer) or a String
+   between the offset (the position by default) and the limit, or nil */
+static VALUE NIO_ByteBuffer_index(int argc, VALUE *argv, VALUE self)
+{
+    long offset, pattern_length, index;
+    VALUE pattern, from;
+    struct NIO_ByteBuffer *buffer;
+    TypedData_Get_Struct(self, struct NIO_ByteBuffer, &NIO_ByteBuffer_type, buffer);
+
+    rb_scan_args(argc, argv, "11", &pattern, &from);
+
+    offset = from == Qnil ? buffer->position : NUM2LONG(from);
+    if (offset < 0) {
+        rb_raise(rb_eArgError, "negative offset given");
+    }
+
+    index = NIO_ByteBuffer_find(buffer, pattern, offset, &pattern_length);
+
+    return index < 0 ? Qnil : LONG2NUM(index);
+}
+
+/* Read up to and including the next occurrence of the delimiter, or return
+   nil (leaving the position where it is) if there isn't one before the
+   limit. With chomp: true, the delimiter is left out of the String */
+static VALUE NIO_ByteBuffer_read_until(int argc, VALUE *argv, VALUE self)
+{
+    VALUE delimiter, options;
+    struct NIO_ByteBuffer *buffer;
+    TypedData_Get_Struct(self, struct NIO_ByteBuffer, &NIO_ByteBuffer_type, buffer);
+
+    rb_scan_args(argc, argv, "1:", &delimiter, &options);
+
+    return NIO_ByteBuffer_take_until(buffer, delimiter, options);
+}
+
+/* Read the next line, if the buffer holds all of it. With chomp: true, the
+   line ending (LF or CRLF) is left out of the String */
+static VALUE NIO_ByteBuffer_read_line(int argc, VALUE *argv, VALUE self)
+{
+    VALUE options;
+    struct NIO_ByteBuffer *buffer;
+    TypedData_Get_Struct(self, struct NIO_ByteBuffer, &NIO_ByteBuffer_type, buffer);
+
+    rb_scan_args(argc, argv, "0:", &options);
+
+    return NIO_ByteBuffer_take_until(buffer, Qnil, options);
+}
+
+/* Search for a byte or String between the offset and the limit, returning
+   its index or -1 */
+static long NIO_ByteBuffer_find(struct NIO_ByteBuffer *buffer, VALUE pattern, long offset, long *pattern_length)
+{
+    char byte;
+    const char *needle, *found;
+    int value;
+
+    if (RB_INTEGER_TYPE_P(pattern)) {
+        value = NUM2INT(pattern);
+        if (value < 0 || value > 255) {
+            rb_raise(rb_eArgError, "byte out of range: %d", value);
+        }
+
+        byte = (char)value;
+        needle = &byte;
+        *pattern_length = 1;
+    } else {
+        StringValue(pattern);
+        needle = RSTRING_PTR(pattern);
+        *pattern_length = RSTRING_LEN(pattern);
+    }
+
+    if (offset > buffer->limit) {
+        return -1;
+    }
+
+    found = NIO_ByteBuffer_search(buffer->buffer + offset, buffer->limit - offset, needle, *pattern_length);
+
+    return found ? found - buffer->buffer : -1;
+}
+
+/* Take data up to the delimiter, or a line if it's nil */
+static VALUE NIO_ByteBuffer_take_until(struct NIO_ByteBuffer *buffer, VALUE delimiter, VALUE options)
+{
+    long index, delimiter_length, length;
+    VALUE chomp = Qundef, result;
+    ID chomp_id = rb_intern("chomp");
+    int line = delimiter == Qnil;
+
+    if (options != Qnil) {
+        rb_get_kwargs(options, &chomp_id, 0, 1, &chomp);
+    }
+
+    index = NIO_ByteBuffer_find(buffer, line ? INT2FIX('\n') : delimiter, buffer->position, &delimiter_length);
+    if (index < 0) {
+        return Qnil;
+    }
+
+    length = index - buffer->position;
+    if (chomp != Qundef && RTEST(chomp)) {
+        if (line && length > 0 && buffer->buffer[index - 1] == '\r') {
+            length--;
+        }
+    } else {
+        length += delimiter_length;
+    }
+
+    result = rb_str_new(buffer->buffer + buffer->position, length);
+    buffer->position = (int)(index + delimiter_length);
+
+    return result;
+}
+
 static VALUE NIO_ByteBuffer_put(VALUE self, VALUE string)
 {
     long length;
@@ -310,6 +606,7 @@ static VALUE NIO_ByteBuffer_put(VALUE self, VALUE string)
         rb_raise(cNIO_ByteBuffer_OverflowError, "buffer is full");
     }
 
+    NIO_ByteBuffer_modify(buffer, 1);
     memcpy(buffer->buffer + buffer->position, StringValuePtr(string), length);
     buffer->position += length;
 
@@ -319,6 +616,7 @@ static VALUE NIO_ByteBuffer_put(VALUE self, VALUE string)
 static VALUE NIO_ByteBuffer_read_from(VALUE self, VALUE io)
 {
     struct NIO_ByteBuffer *buffer;
+    struct iovec iovec;
     ssize_t nbytes, bytes_read;
 
     TypedData_Get_Struct(self, struct NIO_ByteBuffer, &NIO_ByteBuffer_type, buffer);
@@ -331,7 +629,10 @@ static VALUE NIO_ByteBuffer_read_from(VALUE self, VALUE io)
         rb_raise(cNIO_ByteBuffer_OverflowError, "buffer is full");
     }
 
-    bytes_read = read(rb_io_descriptor(io), buffer->buffer + buffer->position, nbytes);
+    NIO_ByteBuffer_modify(buffer, 1);
+    iovec.iov_base = buffer->buffer + buffer->position;
+    iovec.iov_len = nbytes;
+    bytes_read = NIO_ByteBuffer_transfer(io, &buffer, &iovec, 1, 0);
 
     if (bytes_read < 0) {
         if (errno == EAGAIN) {
@@ -349,6 +650,7 @@ static VALUE NIO_ByteBuffer_read_from(VALUE self, VALUE io)
 static VALUE NIO_ByteBuffer_write_to(VALUE self, VALUE io)
 {
     struct NIO_ByteBuffer *buffer;
+    struct iovec iovec;
     ssize_t nbytes, bytes_written;
 
     TypedData_Get_Struct(self, struct NIO_ByteBuffer, &NIO_ByteBuffer_type, buffer);
@@ -360,7 +662,9 @@ static VALUE NIO_ByteBuffer_write_to(VALUE self, VALUE io)
         rb_raise(cNIO_ByteBuffer_UnderflowError, "no data remaining in buffer");
     }
 
-    bytes_written = write(rb_io_descriptor(io), buffer->buffer + buffer->position, nbytes);
+    iovec.iov_base = buffer->buffer + buffer->position;
+    iovec.iov_len = nbytes;
+    bytes_written = NIO_ByteBuffer_transfer(io, &buffer, &iovec, 1, 1);
 
     if (bytes_written < 0) {
         if (errno == EAGAIN) {
@@ -375,6 +679,243 @@ static VALUE NIO_ByteBuffer_write_to(VALUE self, VALUE io)
     return SIZET2NUM(bytes_written);
 }
 
+/* Perform a non-blocking write of the remaining contents of several buffers
+   with a single writev, advancing each of them past what was written. At most
+   IOV_MAX buffers are written at a time */
+static VALUE NIO_ByteBuffer_write_all_to(VALUE klass, VALUE io, VALUE buffers)
+{
+    struct iovec iovecs[IOV_MAX];
+    struct NIO_ByteBuffer *vectored[IOV_MAX];
+    ssize_t bytes_written;
+    int count;
+
+    buffers = rb_convert_type(buffers, T_ARRAY, "Array", "to_ary");
+    io = rb_convert_type(io, T_FILE, "IO", "to_io");
+    io_set_nonblock(io);
+
+    count = NIO_ByteBuffer_iovecs(buffers, iovecs, vectored, 0);
+    if (count == 0) {
+        rb_raise(cNIO_ByteBuffer_UnderflowError, "no data remaining in buffers");
+    }
+
+    bytes_written = NIO_ByteBuffer_transfer(io, vectored, iovecs, count, 1);
+
+    if (bytes_written < 0) {
+        if (errno == EAGAIN) {
+            return INT2NUM(0);
+        } else {
+            rb_sys_fail("writev");
+        }
+    }
+
+    NIO_ByteBuffer_advance(vectored, count, bytes_written);
+
+    return SSIZET2NUM(bytes_written);
+}
+
+/* Perform a non-blocking read into the space remaining in several buffers
+   with a single readv, filling them in order and advancing each of them past
+   what was read. Returns 0 if no data was available, or nil at end of file */
+static VALUE NIO_ByteBuffer_read_all_from(VALUE klass, VALUE io, VALUE buffers)
+{
+    struct iovec iovecs[IOV_MAX];
+    struct NIO_ByteBuffer *vectored[IOV_MAX];
+    ssize_t bytes_read;
+    int count;
+
+    buffers = rb_convert_type(buffers, T_ARRAY, "Array", "to_ary");
+    io = rb_convert_type(io, T_FILE, "IO", "to_io");
+    io_set_nonblock(io);
+
+    count = NIO_ByteBuffer_iovecs(buffers, iovecs, vectored, 1);
+    if (count == 0) {
+        rb_raise(cNIO_ByteBuffer_OverflowError, "buffers are full");
+    }
+
+    bytes_read = NIO_ByteBuffer_transfer(io, vectored, iovecs, count, 0);
+
+    if (bytes_read < 0) {
+        if (errno == EAGAIN) {
+            return INT2NUM(0);
+        } else {
+            rb_sys_fail("readv");
+        }
+    }
+
+    if (bytes_read == 0) {
+        return Qnil;
+    }
+
+    NIO_ByteBuffer_advance(vectored, count, bytes_read);
+
+    return SSIZET2NUM(bytes_read);
+}
+
+/* Size in bytes from which reads and writes are made without holding the GVL,
+   so other threads can run while large buffers are copied */
+static VALUE NIO_ByteBuffer_get_gvl_threshold(VALUE klass)
+{
+    return SIZET2NUM(NIO_ByteBuffer_gvl_threshold);
+}
+
+static VALUE NIO_ByteBuffer_set_gvl_threshold(VALUE klass, VALUE threshold)
+{
+    if (NUM2LONG(threshold) < 0) {
+        rb_raise(rb_eArgError, "negative threshold given");
+    }
+
+    NIO_ByteBuffer_gvl_threshold = NUM2SIZET(threshold);
+    return threshold;
+}
+
+/* Describe the part between position and limit of up to IOV_MAX buffers,
+   skipping any with nothing remaining, and whether they're about to be
+   written to. Returns how many were described */
+static int NIO_ByteBuffer_iovecs(VALUE buffers, struct iovec *iovecs, struct NIO_ByteBuffer **vectored, int writing)
+{
+    struct NIO_ByteBuffer *buffer;
+    long i;
+    int count = 0;
+
+    for (i = 0; i < RARRAY_LEN(buffers) && count < IOV_MAX; i++) {
+        TypedData_Get_Struct(RARRAY_AREF(buffers, i), struct NIO_ByteBuffer, &NIO_ByteBuffer_type, buffer);
+
+        if (buffer->limit == buffer->position) {
+            continue;
+        }
+
+        if (writing) {
+            NIO_ByteBuffer_modify(buffer, 1);
+        }
+
+        iovecs[count].iov_base = buffer->buffer + buffer->position;
+        iovecs[count].iov_len = buffer->limit - buffer->position;
+        vectored[count++] = buffer;
+    }
+
+    return count;
+}
+
+/* Advance the buffers in order past a partial transfer */
+static void NIO_ByteBuffer_advance(struct NIO_ByteBuffer **vectored, int count, ssize_t nbytes)
+{
+    int i, length;
+
+    for (i = 0; i < count && nbytes > 0; i++) {
+        length = vectored[i]->limit - vectored[i]->position;
+        if (length > nbytes) {
+            length = (int)nbytes;
+        }
+
+        vectored[i]->position += length;
+        nbytes -= length;
+    }
+}
+
+/* Read into or write from the described parts of some buffers, errno being
+   set on failure. Transfers of at least gvl_threshold bytes release the GVL,
+   with the buffers pinned so their memory can't be returned to the pool */
+static ssize_t NIO_ByteBuffer_transfer(VALUE io, struct NIO_ByteBuffer **vectored, struct iovec *iovecs, int count, int writing)
+{
+    struct NIO_ByteBuffer_transfer transfer;
+    size_t nbytes = 0;
+    int i;
+
+    transfer.io = io;
+    transfer.fd = rb_io_descriptor(io);
+    transfer.writing = writing;
+    transfer.iovecs = iovecs;
+    transfer.vectored = vectored;
+    transfer.count = count;
+
+    for (i = 0; i < count; i++) {
+        nbytes += iovecs[i].iov_len;
+    }
+
+    if (nbytes < NIO_ByteBuffer_gvl_threshold) {
+        NIO_ByteBuffer_transfer_without_gvl(&transfer);
+        errno = transfer.error;
+        return transfer.result;
+    }
+
+    for (;;) {
+        for (i = 0; i < count; i++) {
+            NIO_ByteBuffer_pin(vectored[i]);
+        }
+
+        rb_ensure(NIO_ByteBuffer_transfer_blocking, (VALUE)&transfer, NIO_ByteBuffer_transfer_unpin, (VALUE)&transfer);
+
+        if (transfer.result >= 0 || transfer.error != EINTR) {
+            break;
+        }
+
+        /* Interrupted, so handle any signals or Thread#raise and retry */
+        rb_thread_check_ints();
+    }
+
+    errno = transfer.error;
+    return transfer.result;
+}
+
+#if defined(HAVE_RB_IO_BLOCKING_REGION) || defined(HAVE_RB_THREAD_IO_BLOCKING_REGION)
+static VALUE NIO_ByteBuffer_transfer_region(void *data)
+{
+    NIO_ByteBuffer_transfer_without_gvl(data);
+    return Qnil;
+}
+#endif
+
+/* Release the GVL for the transfer. Where Ruby lets us, it's done as a
+   blocking operation on the IO, so IO#close in another thread interrupts it
+   rather than closing the descriptor underneath it */
+static VALUE NIO_ByteBuffer_transfer_blocking(VALUE data)
+{
+    struct NIO_ByteBuffer_transfer *transfer = (struct NIO_ByteBuffer_transfer *)data;
+
+#if defined(HAVE_RB_IO_BLOCKING_REGION)
+    rb_io_t *fptr;
+    GetOpenFile(transfer->io, fptr);
+    rb_io_blocking_region(fptr, NIO_ByteBuffer_transfer_region, transfer);
+#elif defined(HAVE_RB_THREAD_IO_BLOCKING_REGION)
+    rb_thread_io_blocking_region(NIO_ByteBuffer_transfer_region, transfer, transfer->fd);
+#else
+    rb_thread_call_without_gvl(NIO_ByteBuffer_transfer_without_gvl, transfer, RUBY_UBF_IO, NULL);
+#endif
+
+    return Qnil;
+}
+
+/* Unpin the buffers, however the transfer ended */
+static VALUE NIO_ByteBuffer_transfer_unpin(VALUE data)
+{
+    struct NIO_ByteBuffer_transfer *transfer = (struct NIO_ByteBuffer_transfer *)data;
+    int i;
+
+    for (i = 0; i < transfer->count; i++) {
+        NIO_ByteBuffer_unpin(transfer->vectored[i]);
+    }
+
+    return Qnil;
+}
+
+static void *NIO_ByteBuffer_transfer_without_gvl(void *data)
+{
+    struct NIO_ByteBuffer_transfer *transfer = (struct NIO_ByteBuffer_transfer *)data;
+
+    if (transfer->count == 1) {
+        transfer->result = transfer->writing
+            ? write(transfer->fd, transfer->iovecs[0].iov_base, transfer->iovecs[0].iov_len)
+            : read(transfer->fd, transfer->iovecs[0].iov_base, transfer->iovecs[0].iov_len);
+    } else {
+        transfer->result = transfer->writing
+            ? writev(transfer->fd, transfer->iovecs, transfer->count)
+            : readv(transfer->fd, transfer->iovecs, transfer->count);
+    }
+
+    transfer->error = errno;
+    return NULL;
+}
+
 static VALUE NIO_ByteBuffer_flip(VALUE self)
 {
     struct NIO_ByteBuffer *buffer;
@@ -426,6 +967,7 @@ static VALUE NIO_ByteBuffer_compact(VALUE self)
     struct NIO_ByteBuffer *buffer;
     TypedData_Get_Struct(self, struct NIO_ByteBuffer, &NIO_ByteBuffer_type, buffer);
 
+    NIO_ByteBuffer_modify(buffer, 1);
     memmove(buffer->buffer, buffer->buffer + buffer->position, buffer->limit - buffer->position);
     buffer->position = buffer->limit - buffer->position;
     buffer->limit = buffer->capacity;
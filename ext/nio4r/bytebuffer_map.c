@@ -0,0 +1,265 @@
+/*
+ * Distributed under the MIT License. See LICENSE.txt for further details.
+ */
+
+#include "nio4r.h"
+
+#include <limits.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#if defined(HAVE_SYS_MMAN_H) && !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+/* What NIO::ByteBuffer.map was asked for */
+struct NIO_ByteBuffer_mapping {
+    VALUE klass, file, length;
+    off_t offset;
+    int prot, flags, huge_pages;
+};
+
+static VALUE mNIO = Qnil;
+static VALUE cNIO_ByteBuffer = Qnil;
+
+/* Class methods */
+static VALUE NIO_ByteBuffer_map(int argc, VALUE *argv, VALUE klass);
+
+/* Methods */
+static VALUE NIO_ByteBuffer_is_mapped(VALUE self);
+static VALUE NIO_ByteBuffer_advise(VALUE self, VALUE advice);
+
+/* Internal functions */
+#ifdef HAVE_SYS_MMAN_H
+static VALUE NIO_ByteBuffer_map_file(VALUE mapping);
+#endif
+
+/* Compatibility for Ruby <= 3.1 */
+#ifndef HAVE_RB_IO_DESCRIPTOR
+static int
+io_descriptor_fallback(VALUE io)
+{
+    rb_io_t *fptr;
+    GetOpenFile(io, fptr);
+    return fptr->fd;
+}
+#define rb_io_descriptor io_descriptor_fallback
+#endif
+
+/* ByteBuffers over memory-mapped files and anonymous shared memory */
+void Init_NIO_ByteBuffer_Map()
+{
+    mNIO = rb_define_module("NIO");
+    cNIO_ByteBuffer = rb_define_class_under(mNIO, "ByteBuffer", rb_cObject);
+
+    rb_define_singleton_method(cNIO_ByteBuffer, "map", NIO_ByteBuffer_map, -1);
+
+    rb_define_method(cNIO_ByteBuffer, "mapped?", NIO_ByteBuffer_is_mapped, 0);
+    rb_define_method(cNIO_ByteBuffer, "advise", NIO_ByteBuffer_advise, 1);
+}
+
+/* Map part of a file (given as a File or a path) into a ByteBuffer, or
+   anonymous shared memory if the file is nil. The region extends to the end
+   of the file unless a length is given, which can't reach past its end. The
+   buffer's limit is the end of the region, so a mapped file is ready to be
+   written to a socket.
+
+   The mode is :r (read-only, the default for files), :rw (writes go to the
+   file or are shared with forked processes, the default for anonymous memory)
+   or :private (writes stay in this process). With huge_pages: true, the kernel
+   is asked to back the mapping with transparent huge pages.
+
+   The mapping is removed when the buffer is garbage collected. Clearing a
+   mapped buffer leaves its contents alone, and shrinking a file while it's
+   mapped makes access to the missing part crash the process with SIGBUS */
+static VALUE NIO_ByteBuffer_map(int argc, VALUE *argv, VALUE klass)
+{
+#ifdef HAVE_SYS_MMAN_H
+    VALUE file, offset, length, mode, options, huge_pages = Qundef;
+    ID huge_pages_id = rb_intern("huge_pages");
+    struct NIO_ByteBuffer_mapping mapping;
+
+    rb_scan_args(argc, argv, "13:", &file, &offset, &length, &mode, &options);
+    if (options != Qnil) {
+        rb_get_kwargs(options, &huge_pages_id, 0, 1, &huge_pages);
+    }
+
+    if (mode == Qnil) {
+        mode = ID2SYM(rb_intern(file == Qnil ? "rw" : "r"));
+    }
+
+    if (mode == ID2SYM(rb_intern("r"))) {
+        mapping.prot = PROT_READ;
+        mapping.flags = MAP_SHARED;
+    } else if (mode == ID2SYM(rb_intern("rw"))) {
+        mapping.prot = PROT_READ | PROT_WRITE;
+        mapping.flags = MAP_SHARED;
+    } else if (mode == ID2SYM(rb_intern("private"))) {
+        mapping.prot = PROT_READ | PROT_WRITE;
+        mapping.flags = MAP_PRIVATE;
+    } else {
+        rb_raise(rb_eArgError, "invalid mode: %" PRIsVALUE " (expected :r, :rw or :private)", mode);
+    }
+
+    mapping.klass = klass;
+    mapping.file = Qnil;
+    mapping.offset = offset == Qnil ? 0 : NUM2OFFT(offset);
+    mapping.length = length;
+    mapping.huge_pages = huge_pages != Qundef && RTEST(huge_pages);
+
+    if (mapping.offset < 0) {
+        rb_raise(rb_eArgError, "negative offset given");
+    }
+
+    if (length != Qnil && NUM2LONG(length) < 0) {
+        rb_raise(rb_eArgError, "negative length given");
+    }
+
+    if (file == Qnil) {
+        if (length == Qnil) {
+            rb_raise(rb_eArgError, "anonymous mappings need a length");
+        }
+
+        mapping.flags |= MAP_ANONYMOUS;
+        mapping.offset = 0;
+        return NIO_ByteBuffer_map_file((VALUE)&mapping);
+    }
+
+    /* Paths are opened just long enough to map them */
+    if (RB_TYPE_P(file, T_STRING) || rb_respond_to(file, rb_intern("to_path"))) {
+        mapping.file = rb_funcall(rb_cFile, rb_intern("open"), 2, rb_get_path(file), rb_str_new_cstr(mapping.prot & PROT_WRITE && mapping.flags & MAP_SHARED ? "r+b" : "rb"));
+        return rb_ensure(NIO_ByteBuffer_map_file, (VALUE)&mapping, rb_io_close, mapping.file);
+    }
+
+    mapping.file = rb_convert_type(file, T_FILE, "IO", "to_io");
+    return NIO_ByteBuffer_map_file((VALUE)&mapping);
+#else
+    rb_notimplement();
+    return Qnil;
+#endif
+}
+
+static VALUE NIO_ByteBuffer_is_mapped(VALUE self)
+{
+    return NIO_ByteBuffer_unwrap(self)->mapping ? Qtrue : Qfalse;
+}
+
+/* Tell the kernel how a mapped buffer is about to be used: :sequential
+   (read ahead aggressively), :random, :willneed (read it in now), :dontneed
+   (drop pages which have already been written out) or :normal */
+static VALUE NIO_ByteBuffer_advise(VALUE self, VALUE advice)
+{
+#ifdef HAVE_SYS_MMAN_H
+    struct NIO_ByteBuffer *buffer = NIO_ByteBuffer_unwrap(self);
+    int value;
+
+    if (advice == ID2SYM(rb_intern("normal"))) {
+        value = MADV_NORMAL;
+    } else if (advice == ID2SYM(rb_intern("sequential"))) {
+        value = MADV_SEQUENTIAL;
+    } else if (advice == ID2SYM(rb_intern("random"))) {
+        value = MADV_RANDOM;
+    } else if (advice == ID2SYM(rb_intern("willneed"))) {
+        value = MADV_WILLNEED;
+    } else if (advice == ID2SYM(rb_intern("dontneed"))) {
+        value = MADV_DONTNEED;
+    } else {
+        rb_raise(rb_eArgError, "invalid advice: %" PRIsVALUE, advice);
+    }
+
+    if (!buffer->mapping) {
+        if (buffer->capacity == 0) {
+            return self;
+        }
+        rb_raise(rb_eIOError, "buffer isn't mapped");
+    }
+
+    if (madvise(buffer->mapping, buffer->mapping_length, value) < 0) {
+        rb_sys_fail("madvise");
+    }
+
+    return self;
+#else
+    rb_notimplement();
+    return Qnil;
+#endif
+}
+
+#ifdef HAVE_SYS_MMAN_H
+static VALUE NIO_ByteBuffer_map_file(VALUE arg)
+{
+    struct NIO_ByteBuffer_mapping *mapping = (struct NIO_ByteBuffer_mapping *)arg;
+    struct NIO_ByteBuffer *buffer;
+    struct stat st;
+    off_t aligned;
+    size_t size;
+    long page_size = sysconf(_SC_PAGESIZE);
+    int fd = -1;
+    void *memory;
+    VALUE self;
+
+    if (mapping->file != Qnil) {
+        fd = rb_io_descriptor(mapping->file);
+        if (fstat(fd, &st) < 0) {
+            rb_sys_fail("fstat");
+        }
+
+        if (mapping->offset > st.st_size) {
+            rb_raise(rb_eArgError, "offset is outside the file");
+        }
+    }
+
+    size = mapping->length == Qnil ? (size_t)(st.st_size - mapping->offset) : NUM2SIZET(mapping->length);
+
+    /* Touching pages past the end of the file raises SIGBUS */
+    if (mapping->file != Qnil && size > (size_t)(st.st_size - mapping->offset)) {
+        rb_raise(rb_eArgError, "length extends past the end of the file");
+    }
+
+    /* ByteBuffer positions are ints */
+    if (size > INT_MAX) {
+        rb_raise(rb_eArgError, "can't map more than %d bytes into a ByteBuffer", INT_MAX);
+    }
+
+    self = rb_obj_alloc(mapping->klass);
+    buffer = NIO_ByteBuffer_unwrap(self);
+    buffer->capacity = buffer->limit = (int)size;
+    buffer->position = 0;
+    buffer->mark = MARK_UNSET;
+    buffer->readonly = !(mapping->prot & PROT_WRITE);
+
+    /* Nothing to map */
+    if (size == 0) {
+        return self;
+    }
+
+    /* Mappings start on a page boundary */
+    aligned = mapping->offset - mapping->offset % page_size;
+
+    memory = mmap(NULL, size + (mapping->offset - aligned), mapping->prot, mapping->flags, fd, aligned);
+    if (memory == MAP_FAILED) {
+        rb_sys_fail("mmap");
+    }
+
+    buffer->mapping = memory;
+    buffer->mapping_length = size + (mapping->offset - aligned);
+    buffer->buffer = (char *)memory + (mapping->offset - aligned);
+
+#ifdef MADV_HUGEPAGE
+    if (mapping->huge_pages) {
+        madvise(memory, buffer->mapping_length, MADV_HUGEPAGE);
+    }
+#endif
+
+    return self;
+}
+#endif
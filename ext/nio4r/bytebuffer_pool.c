@@ -0,0 +1,327 @@
+/*
+ * Distributed under the MIT License. See LICENSE.txt for further details.
+ */
+
+#include "nio4r.h"
+#include "ruby/thread_native.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Memory each thread keeps per size class before sharing it */
+#define NIO_POOL_CACHE_SIZE 8
+
+/* How much memory the pool holds on to by default */
+#define NIO_POOL_MAX_RETAINED (32 * 1024 * 1024)
+
+/* Memory waiting to be checked out again is chained through its first bytes */
+struct NIO_Pooled {
+    struct NIO_Pooled *next;
+};
+
+struct NIO_Pool_list {
+    struct NIO_Pooled *head;
+    int count;
+};
+
+/* Checked-in memory a thread can reuse without taking the lock */
+struct NIO_Pool_cache {
+    struct NIO_Pool_list lists[NIO_POOL_CLASSES];
+};
+
+/* Shared by every thread in the process, and flushed into by threads as they
+   exit. Memory comes from malloc rather than xmalloc, so reusing it doesn't
+   count towards the GC's malloc limit, and xmalloc can't run the GC (and
+   free buffers) while the lock is held. The counters are updated atomically */
+static struct {
+    rb_nativethread_lock_t lock;
+    pthread_key_t cache_key;
+    struct NIO_Pool_list lists[NIO_POOL_CLASSES];
+    size_t hits, misses, checked_out, retained, max_retained;
+} NIO_ByteBuffer_pool;
+
+static VALUE mNIO = Qnil;
+static VALUE cNIO_ByteBuffer = Qnil;
+static VALUE mNIO_ByteBuffer_Pool = Qnil;
+
+/* Module methods */
+static VALUE NIO_ByteBuffer_Pool_checkout(VALUE self, VALUE capacity);
+static VALUE NIO_ByteBuffer_Pool_checkin(VALUE self, VALUE buffer);
+static VALUE NIO_ByteBuffer_Pool_stats(VALUE self);
+static VALUE NIO_ByteBuffer_Pool_get_max_retained_bytes(VALUE self);
+static VALUE NIO_ByteBuffer_Pool_set_max_retained_bytes(VALUE self, VALUE bytes);
+
+/* Internal functions */
+static int NIO_ByteBuffer_Pool_size_class(int capacity);
+static int NIO_ByteBuffer_Pool_detach(VALUE buffer);
+static VALUE NIO_ByteBuffer_Pool_yield(VALUE buffer);
+static VALUE NIO_ByteBuffer_Pool_ensure_checkin(VALUE buffer);
+static struct NIO_Pool_cache *NIO_ByteBuffer_Pool_cache(void);
+static void NIO_ByteBuffer_Pool_flush_cache(void *data);
+
+#define NIO_POOL_CLASS_SIZE(size_class) ((size_t)1 << ((size_class) + NIO_POOL_MIN_SHIFT))
+
+/* Reuse of ByteBuffer memory across short-lived buffers, instead of
+   allocating and freeing it for each one */
+void Init_NIO_ByteBuffer_Pool()
+{
+    rb_nativethread_lock_initialize(&NIO_ByteBuffer_pool.lock);
+    if (pthread_key_create(&NIO_ByteBuffer_pool.cache_key, NIO_ByteBuffer_Pool_flush_cache) != 0) {
+        rb_sys_fail("pthread_key_create");
+    }
+    NIO_ByteBuffer_pool.max_retained = NIO_POOL_MAX_RETAINED;
+
+    mNIO = rb_define_module("NIO");
+    cNIO_ByteBuffer = rb_define_class_under(mNIO, "ByteBuffer", rb_cObject);
+    mNIO_ByteBuffer_Pool = rb_define_module_under(cNIO_ByteBuffer, "Pool");
+
+    rb_define_const(mNIO_ByteBuffer_Pool, "MIN_SIZE", INT2NUM(1 << NIO_POOL_MIN_SHIFT));
+    rb_define_const(mNIO_ByteBuffer_Pool, "MAX_SIZE", INT2NUM(1 << NIO_POOL_MAX_SHIFT));
+
+    rb_define_module_function(mNIO_ByteBuffer_Pool, "checkout", NIO_ByteBuffer_Pool_checkout, 1);
+    rb_define_module_function(mNIO_ByteBuffer_Pool, "checkin", NIO_ByteBuffer_Pool_checkin, 1);
+    rb_define_module_function(mNIO_ByteBuffer_Pool, "stats", NIO_ByteBuffer_Pool_stats, 0);
+    rb_define_module_function(mNIO_ByteBuffer_Pool, "max_retained_bytes", NIO_ByteBuffer_Pool_get_max_retained_bytes, 0);
+    rb_define_module_function(mNIO_ByteBuffer_Pool, "max_retained_bytes=", NIO_ByteBuffer_Pool_set_max_retained_bytes, 1);
+}
+
+/* Check a cleared ByteBuffer of the given capacity out of the pool. Buffers
+   larger than MAX_SIZE are allocated as usual. Given a block, the buffer is
+   yielded and checked back in afterwards */
+static VALUE NIO_ByteBuffer_Pool_checkout(VALUE self, VALUE capacity)
+{
+    VALUE buffer;
+    struct NIO_ByteBuffer *bytebuffer;
+    int size = NUM2INT(capacity);
+    int size_class;
+
+    if (size < 0) {
+        rb_raise(rb_eArgError, "negative capacity");
+    }
+
+    size_class = NIO_ByteBuffer_Pool_size_class(size);
+    if (size_class < 0) {
+        __atomic_add_fetch(&NIO_ByteBuffer_pool.misses, 1, __ATOMIC_RELAXED);
+        buffer = rb_class_new_instance(1, &capacity, cNIO_ByteBuffer);
+    } else {
+        buffer = rb_obj_alloc(cNIO_ByteBuffer);
+        bytebuffer = NIO_ByteBuffer_unwrap(buffer);
+
+        bytebuffer->buffer = NIO_ByteBuffer_Pool_take(size_class);
+        bytebuffer->size_class = size_class;
+
+        /* Don't hand out what the last buffer held */
+        memset(bytebuffer->buffer, 0, size);
+        bytebuffer->capacity = bytebuffer->limit = size;
+        bytebuffer->position = 0;
+        bytebuffer->mark = MARK_UNSET;
+    }
+
+    if (rb_block_given_p()) {
+        return rb_ensure(NIO_ByteBuffer_Pool_yield, buffer, NIO_ByteBuffer_Pool_ensure_checkin, buffer);
+    }
+
+    return buffer;
+}
+
+/* Give a buffer's memory back to the pool. The buffer is left empty, with a
+   capacity of 0. Raises ArgumentError if operations or registered buffers
+   mean the kernel may still use it */
+static VALUE NIO_ByteBuffer_Pool_checkin(VALUE self, VALUE buffer)
+{
+    if (!NIO_ByteBuffer_Pool_detach(buffer)) {
+        rb_raise(rb_eArgError, "buffer is still in use by the kernel");
+    }
+
+    return Qnil;
+}
+
+/* Reuse statistics: checkouts served from the pool (hits) or by allocating
+   memory (misses), pooled buffers which are checked out, and the memory the
+   pool holds on to in between */
+static VALUE NIO_ByteBuffer_Pool_stats(VALUE self)
+{
+    VALUE stats = rb_hash_new();
+
+    rb_hash_aset(stats, ID2SYM(rb_intern("hits")), SIZET2NUM(__atomic_load_n(&NIO_ByteBuffer_pool.hits, __ATOMIC_RELAXED)));
+    rb_hash_aset(stats, ID2SYM(rb_intern("misses")), SIZET2NUM(__atomic_load_n(&NIO_ByteBuffer_pool.misses, __ATOMIC_RELAXED)));
+    rb_hash_aset(stats, ID2SYM(rb_intern("checked_out")), SIZET2NUM(__atomic_load_n(&NIO_ByteBuffer_pool.checked_out, __ATOMIC_RELAXED)));
+    rb_hash_aset(stats, ID2SYM(rb_intern("retained_bytes")), SIZET2NUM(__atomic_load_n(&NIO_ByteBuffer_pool.retained, __ATOMIC_RELAXED)));
+
+    return stats;
+}
+
+static VALUE NIO_ByteBuffer_Pool_get_max_retained_bytes(VALUE self)
+{
+    return SIZET2NUM(__atomic_load_n(&NIO_ByteBuffer_pool.max_retained, __ATOMIC_RELAXED));
+}
+
+/* Limit the memory the pool holds on to. Memory checked in beyond the limit
+   is freed, although what the pool already holds is kept */
+static VALUE NIO_ByteBuffer_Pool_set_max_retained_bytes(VALUE self, VALUE bytes)
+{
+    __atomic_store_n(&NIO_ByteBuffer_pool.max_retained, NUM2SIZET(bytes), __ATOMIC_RELAXED);
+    return bytes;
+}
+
+/* The smallest class a capacity fits in, or -1 if it's too large to pool */
+static int NIO_ByteBuffer_Pool_size_class(int capacity)
+{
+    int size_class = 0;
+
+    if (capacity > (1 << NIO_POOL_MAX_SHIFT)) {
+        return -1;
+    }
+
+    while (NIO_POOL_CLASS_SIZE(size_class) < (size_t)capacity) {
+        size_class++;
+    }
+
+    return size_class;
+}
+
+/* Memory of a size class, from this thread's cache, the shared lists, or
+   freshly allocated */
+char *NIO_ByteBuffer_Pool_take(int size_class)
+{
+    struct NIO_Pool_cache *cache = NIO_ByteBuffer_Pool_cache();
+    struct NIO_Pool_list *list;
+    struct NIO_Pooled *pooled = 0;
+    char *memory;
+
+    if (cache && cache->lists[size_class].head) {
+        list = &cache->lists[size_class];
+        pooled = list->head;
+        list->head = pooled->next;
+        list->count--;
+    } else {
+        rb_nativethread_lock_lock(&NIO_ByteBuffer_pool.lock);
+        list = &NIO_ByteBuffer_pool.lists[size_class];
+        if ((pooled = list->head)) {
+            list->head = pooled->next;
+            list->count--;
+        }
+        rb_nativethread_lock_unlock(&NIO_ByteBuffer_pool.lock);
+    }
+
+    __atomic_add_fetch(&NIO_ByteBuffer_pool.checked_out, 1, __ATOMIC_RELAXED);
+
+    if (pooled) {
+        __atomic_add_fetch(&NIO_ByteBuffer_pool.hits, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&NIO_ByteBuffer_pool.retained, NIO_POOL_CLASS_SIZE(size_class), __ATOMIC_RELAXED);
+        return (char *)pooled;
+    }
+
+    __atomic_add_fetch(&NIO_ByteBuffer_pool.misses, 1, __ATOMIC_RELAXED);
+
+    memory = (char *)malloc(NIO_POOL_CLASS_SIZE(size_class));
+    if (!memory) {
+        __atomic_sub_fetch(&NIO_ByteBuffer_pool.checked_out, 1, __ATOMIC_RELAXED);
+        rb_memerror();
+    }
+
+    return memory;
+}
+
+/* Called as buffers are checked in or garbage collected */
+void NIO_ByteBuffer_Pool_release(char *memory, int size_class)
+{
+    struct NIO_Pool_cache *cache;
+    struct NIO_Pool_list *list;
+    struct NIO_Pooled *pooled = (struct NIO_Pooled *)memory;
+    size_t size = NIO_POOL_CLASS_SIZE(size_class);
+
+    __atomic_sub_fetch(&NIO_ByteBuffer_pool.checked_out, 1, __ATOMIC_RELAXED);
+
+    if (__atomic_add_fetch(&NIO_ByteBuffer_pool.retained, size, __ATOMIC_RELAXED) > __atomic_load_n(&NIO_ByteBuffer_pool.max_retained, __ATOMIC_RELAXED)) {
+        __atomic_sub_fetch(&NIO_ByteBuffer_pool.retained, size, __ATOMIC_RELAXED);
+        free(memory);
+        return;
+    }
+
+    cache = NIO_ByteBuffer_Pool_cache();
+    if (cache && cache->lists[size_class].count < NIO_POOL_CACHE_SIZE) {
+        list = &cache->lists[size_class];
+        pooled->next = list->head;
+        list->head = pooled;
+        list->count++;
+        return;
+    }
+
+    rb_nativethread_lock_lock(&NIO_ByteBuffer_pool.lock);
+    list = &NIO_ByteBuffer_pool.lists[size_class];
+    pooled->next = list->head;
+    list->head = pooled;
+    list->count++;
+    rb_nativethread_lock_unlock(&NIO_ByteBuffer_pool.lock);
+}
+
+/* Take a buffer's memory away from it, unless the kernel may still use it */
+static int NIO_ByteBuffer_Pool_detach(VALUE buffer)
+{
+    struct NIO_ByteBuffer *bytebuffer = NIO_ByteBuffer_unwrap(buffer);
+
+    if (__atomic_load_n(&bytebuffer->pins, __ATOMIC_ACQUIRE) > 0) {
+        return 0;
+    }
+
+    NIO_ByteBuffer_release(bytebuffer);
+    bytebuffer->capacity = bytebuffer->limit = bytebuffer->position = 0;
+    bytebuffer->mark = MARK_UNSET;
+
+    return 1;
+}
+
+static VALUE NIO_ByteBuffer_Pool_yield(VALUE buffer)
+{
+    return rb_yield(buffer);
+}
+
+/* Buffers the kernel is still using are left to the garbage collector rather
+   than raising over whatever the block did */
+static VALUE NIO_ByteBuffer_Pool_ensure_checkin(VALUE buffer)
+{
+    NIO_ByteBuffer_Pool_detach(buffer);
+    return Qnil;
+}
+
+/* This thread's cache, created on first use. Nil if it can't be allocated,
+   in which case the shared lists are used */
+static struct NIO_Pool_cache *NIO_ByteBuffer_Pool_cache(void)
+{
+    struct NIO_Pool_cache *cache = (struct NIO_Pool_cache *)pthread_getspecific(NIO_ByteBuffer_pool.cache_key);
+
+    if (!cache) {
+        cache = (struct NIO_Pool_cache *)calloc(1, sizeof(struct NIO_Pool_cache));
+        if (cache && pthread_setspecific(NIO_ByteBuffer_pool.cache_key, cache) != 0) {
+            free(cache);
+            cache = 0;
+        }
+    }
+
+    return cache;
+}
+
+/* Hand an exiting thread's memory over to the other threads */
+static void NIO_ByteBuffer_Pool_flush_cache(void *data)
+{
+    struct NIO_Pool_cache *cache = (struct NIO_Pool_cache *)data;
+    struct NIO_Pool_list *list;
+    struct NIO_Pooled *pooled;
+    int i;
+
+    rb_nativethread_lock_lock(&NIO_ByteBuffer_pool.lock);
+    for (i = 0; i < NIO_POOL_CLASSES; i++) {
+        list = &NIO_ByteBuffer_pool.lists[i];
+        while ((pooled = cache->lists[i].head)) {
+            cache->lists[i].head = pooled->next;
+            pooled->next = list->head;
+            list->head = pooled;
+            list->count++;
+        }
+    }
+    rb_nativethread_lock_unlock(&NIO_ByteBuffer_pool.lock);
+
+    free(cache);
+}
@@ -0,0 +1,133 @@
+/*
+ * Distributed under the MIT License. See LICENSE.txt for further details.
+ */
+
+#include "nio4r.h"
+
+#include <string.h>
+
+/* SSE2 is part of x86-64, while AVX2 has to be checked for at runtime */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define NIO_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+/* Searches for strings of 2 or more bytes */
+typedef const char *(*NIO_search_func)(const char *data, size_t length, const char *needle, size_t needle_length);
+
+static const char *NIO_search_scalar(const char *data, size_t length, const char *needle, size_t needle_length);
+#ifdef NIO_SEARCH_X86
+static const char *NIO_search_sse2(const char *data, size_t length, const char *needle, size_t needle_length);
+static const char *NIO_search_avx2(const char *data, size_t length, const char *needle, size_t needle_length);
+#endif
+
+static NIO_search_func NIO_search_string = NIO_search_scalar;
+
+/* Pick the widest kernel the CPU supports */
+void Init_NIO_ByteBuffer_Search()
+{
+#ifdef NIO_SEARCH_X86
+    __builtin_cpu_init();
+    NIO_search_string = __builtin_cpu_supports("avx2") ? NIO_search_avx2 : NIO_search_sse2;
+#endif
+}
+
+const char *NIO_ByteBuffer_search(const char *data, size_t length, const char *needle, size_t needle_length)
+{
+    if (needle_length == 0) {
+        return data;
+    }
+
+    if (needle_length > length) {
+        return NULL;
+    }
+
+    /* The C library's memchr is already vectorized */
+    if (needle_length == 1) {
+        return (const char *)memchr(data, (unsigned char)needle[0], length);
+    }
+
+    return NIO_search_string(data, length, needle, needle_length);
+}
+
+/* Skip to each occurrence of the first byte, then compare the rest */
+static const char *NIO_search_scalar(const char *data, size_t length, const char *needle, size_t needle_length)
+{
+    const char *end = data + length - needle_length + 1;
+    const char *candidate = data;
+
+    if (needle_length > length) {
+        return NULL;
+    }
+
+    while (candidate < end) {
+        candidate = (const char *)memchr(candidate, (unsigned char)needle[0], end - candidate);
+        if (!candidate) {
+            return NULL;
+        }
+
+        if (memcmp(candidate + 1, needle + 1, needle_length - 1) == 0) {
+            return candidate;
+        }
+
+        candidate++;
+    }
+
+    return NULL;
+}
+
+#ifdef NIO_SEARCH_X86
+/* Compare the needle's first and last bytes against a block of positions at
+   once, and only compare the bytes in between where both match. The rest of
+   the data, too short for a whole block, is searched a byte at a time */
+static const char *NIO_search_sse2(const char *data, size_t length, const char *needle, size_t needle_length)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needle_length - 1]);
+    size_t i;
+    unsigned int mask;
+    int bit;
+
+    for (i = 0; i + needle_length - 1 + sizeof(__m128i) <= length; i += sizeof(__m128i)) {
+        __m128i block_first = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i block_last = _mm_loadu_si128((const __m128i *)(data + i + needle_length - 1));
+
+        mask = (unsigned int)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+        while (mask) {
+            bit = __builtin_ctz(mask);
+            if (memcmp(data + i + bit + 1, needle + 1, needle_length - 2) == 0) {
+                return data + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return NIO_search_scalar(data + i, length - i, needle, needle_length);
+}
+
+__attribute__((target("avx2")))
+static const char *NIO_search_avx2(const char *data, size_t length, const char *needle, size_t needle_length)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needle_length - 1]);
+    size_t i;
+    unsigned int mask;
+    int bit;
+
+    for (i = 0; i + needle_length - 1 + sizeof(__m256i) <= length; i += sizeof(__m256i)) {
+        __m256i block_first = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i block_last = _mm256_loadu_si256((const __m256i *)(data + i + needle_length - 1));
+
+        mask = (unsigned int)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last)));
+        while (mask) {
+            bit = __builtin_ctz(mask);
+            if (memcmp(data + i + bit + 1, needle + 1, needle_length - 2) == 0) {
+                return data + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return NIO_search_scalar(data + i, length - i, needle, needle_length);
+}
+#endif
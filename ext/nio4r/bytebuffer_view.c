@@ -0,0 +1,238 @@
+/*
+ * Distributed under the MIT License. See LICENSE.txt for further details.
+ */
+
+#include "nio4r.h"
+
+#include <string.h>
+
+struct NIO_ByteBuffer_View {
+    struct NIO_ByteBuffer_memory *memory; /* shared with a buffer... */
+    VALUE string;                         /* ...or copied, if it couldn't be */
+    int offset, length;
+};
+
+static VALUE mNIO = Qnil;
+static VALUE cNIO_ByteBuffer = Qnil;
+static VALUE cNIO_ByteBuffer_View = Qnil;
+
+/* Allocator/deallocator */
+static void NIO_ByteBuffer_View_mark(void *data);
+static void NIO_ByteBuffer_View_free(void *data);
+static size_t NIO_ByteBuffer_View_memsize(const void *data);
+
+/* Methods */
+static VALUE NIO_ByteBuffer_View_size(VALUE self);
+static VALUE NIO_ByteBuffer_View_to_s(VALUE self);
+static VALUE NIO_ByteBuffer_View_getbyte(VALUE self, VALUE index);
+static VALUE NIO_ByteBuffer_View_index(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_ByteBuffer_View_start_with(VALUE self, VALUE prefix);
+static VALUE NIO_ByteBuffer_View_equal(VALUE self, VALUE other);
+static VALUE NIO_ByteBuffer_View_inspect(VALUE self);
+
+/* Internal functions */
+static struct NIO_ByteBuffer_View *NIO_ByteBuffer_View_unwrap(VALUE self);
+static const char *NIO_ByteBuffer_View_data(struct NIO_ByteBuffer_View *view);
+
+/* Read-only views of data in ByteBuffers, which share the buffer's memory
+   rather than copying it until the buffer is written to */
+void Init_NIO_ByteBuffer_View()
+{
+    mNIO = rb_define_module("NIO");
+    cNIO_ByteBuffer = rb_define_class_under(mNIO, "ByteBuffer", rb_cObject);
+    cNIO_ByteBuffer_View = rb_define_class_under(cNIO_ByteBuffer, "View", rb_cObject);
+    rb_undef_alloc_func(cNIO_ByteBuffer_View);
+
+    rb_define_method(cNIO_ByteBuffer_View, "size", NIO_ByteBuffer_View_size, 0);
+    rb_define_method(cNIO_ByteBuffer_View, "bytesize", NIO_ByteBuffer_View_size, 0);
+    rb_define_method(cNIO_ByteBuffer_View, "to_s", NIO_ByteBuffer_View_to_s, 0);
+    rb_define_method(cNIO_ByteBuffer_View, "to_str", NIO_ByteBuffer_View_to_s, 0);
+    rb_define_method(cNIO_ByteBuffer_View, "getbyte", NIO_ByteBuffer_View_getbyte, 1);
+    rb_define_method(cNIO_ByteBuffer_View, "index", NIO_ByteBuffer_View_index, -1);
+    rb_define_method(cNIO_ByteBuffer_View, "start_with?", NIO_ByteBuffer_View_start_with, 1);
+    rb_define_method(cNIO_ByteBuffer_View, "==", NIO_ByteBuffer_View_equal, 1);
+    rb_define_method(cNIO_ByteBuffer_View, "inspect", NIO_ByteBuffer_View_inspect, 0);
+}
+
+static const rb_data_type_t NIO_ByteBuffer_View_type = {
+    "NIO::ByteBuffer::View",
+    {
+        NIO_ByteBuffer_View_mark,
+        NIO_ByteBuffer_View_free,
+        NIO_ByteBuffer_View_memsize,
+    },
+    0,
+    0,
+    RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+VALUE NIO_ByteBuffer_View_new(struct NIO_ByteBuffer *buffer, int offset, int length)
+{
+    struct NIO_ByteBuffer_View *view;
+    struct NIO_ByteBuffer_memory *shared;
+    VALUE self = TypedData_Make_Struct(cNIO_ByteBuffer_View, struct NIO_ByteBuffer_View, &NIO_ByteBuffer_View_type, view);
+
+    RB_OBJ_WRITE(self, &view->string, Qnil);
+    view->length = length;
+
+    /* Buffers the kernel may be using, and mapped buffers, can't move to new
+       memory if they're written to, so their data is copied up front */
+    if (length == 0 || buffer->mapping || __atomic_load_n(&buffer->pins, __ATOMIC_ACQUIRE) > 0) {
+        RB_OBJ_WRITE(self, &view->string, rb_obj_freeze(rb_str_new(buffer->buffer + offset, length)));
+        return rb_obj_freeze(self);
+    }
+
+    if (!buffer->shared) {
+        shared = (struct NIO_ByteBuffer_memory *)xmalloc(sizeof(struct NIO_ByteBuffer_memory));
+        shared->data = buffer->buffer;
+        shared->size_class = buffer->size_class;
+        shared->refs = 1;
+        buffer->shared = shared;
+    }
+
+    buffer->shared->refs++;
+    view->memory = buffer->shared;
+    view->offset = offset;
+
+    return rb_obj_freeze(self);
+}
+
+static struct NIO_ByteBuffer_View *NIO_ByteBuffer_View_unwrap(VALUE self)
+{
+    struct NIO_ByteBuffer_View *view;
+    TypedData_Get_Struct(self, struct NIO_ByteBuffer_View, &NIO_ByteBuffer_View_type, view);
+    return view;
+}
+
+static void NIO_ByteBuffer_View_mark(void *data)
+{
+    struct NIO_ByteBuffer_View *view = (struct NIO_ByteBuffer_View *)data;
+    rb_gc_mark(view->string);
+}
+
+static void NIO_ByteBuffer_View_free(void *data)
+{
+    struct NIO_ByteBuffer_View *view = (struct NIO_ByteBuffer_View *)data;
+
+    if (view->memory) {
+        NIO_ByteBuffer_memory_release(view->memory);
+    }
+
+    xfree(view);
+}
+
+static size_t NIO_ByteBuffer_View_memsize(const void *data)
+{
+    return sizeof(struct NIO_ByteBuffer_View);
+}
+
+static const char *NIO_ByteBuffer_View_data(struct NIO_ByteBuffer_View *view)
+{
+    return view->memory ? view->memory->data + view->offset : RSTRING_PTR(view->string);
+}
+
+static VALUE NIO_ByteBuffer_View_size(VALUE self)
+{
+    return INT2NUM(NIO_ByteBuffer_View_unwrap(self)->length);
+}
+
+/* Copy the data into a String */
+static VALUE NIO_ByteBuffer_View_to_s(VALUE self)
+{
+    struct NIO_ByteBuffer_View *view = NIO_ByteBuffer_View_unwrap(self);
+    return rb_str_new(NIO_ByteBuffer_View_data(view), view->length);
+}
+
+/* The byte at the given index, counting back from the end if it's negative,
+   or nil if it's out of range */
+static VALUE NIO_ByteBuffer_View_getbyte(VALUE self, VALUE index)
+{
+    struct NIO_ByteBuffer_View *view = NIO_ByteBuffer_View_unwrap(self);
+    long i = NUM2LONG(index);
+
+    if (i < 0) {
+        i += view->length;
+    }
+
+    if (i < 0 || i >= view->length) {
+        return Qnil;
+    }
+
+    return INT2FIX((unsigned char)NIO_ByteBuffer_View_data(view)[i]);
+}
+
+/* Byte offset of the first occurrence of a string at or after the given
+   offset, or nil if there isn't one */
+static VALUE NIO_ByteBuffer_View_index(int argc, VALUE *argv, VALUE self)
+{
+    struct NIO_ByteBuffer_View *view = NIO_ByteBuffer_View_unwrap(self);
+    VALUE substring, offset;
+    const char *data, *found;
+    long from = 0;
+
+    rb_scan_args(argc, argv, "11", &substring, &offset);
+    StringValue(substring);
+
+    if (offset != Qnil) {
+        from = NUM2LONG(offset);
+        if (from < 0) {
+            from += view->length;
+        }
+        if (from < 0 || from > view->length) {
+            return Qnil;
+        }
+    }
+
+    data = NIO_ByteBuffer_View_data(view);
+    found = NIO_ByteBuffer_search(data + from, view->length - from, RSTRING_PTR(substring), RSTRING_LEN(substring));
+
+    return found ? LONG2NUM(found - data) : Qnil;
+}
+
+static VALUE NIO_ByteBuffer_View_start_with(VALUE self, VALUE prefix)
+{
+    struct NIO_ByteBuffer_View *view = NIO_ByteBuffer_View_unwrap(self);
+
+    StringValue(prefix);
+    if (RSTRING_LEN(prefix) > view->length) {
+        return Qfalse;
+    }
+
+    return memcmp(NIO_ByteBuffer_View_data(view), RSTRING_PTR(prefix), RSTRING_LEN(prefix)) == 0 ? Qtrue : Qfalse;
+}
+
+/* Views are equal to Strings and other Views with the same bytes */
+static VALUE NIO_ByteBuffer_View_equal(VALUE self, VALUE other)
+{
+    struct NIO_ByteBuffer_View *view = NIO_ByteBuffer_View_unwrap(self), *other_view;
+    const char *data;
+    long length;
+
+    if (RB_TYPE_P(other, T_STRING)) {
+        data = RSTRING_PTR(other);
+        length = RSTRING_LEN(other);
+    } else if (rb_typeddata_is_kind_of(other, &NIO_ByteBuffer_View_type)) {
+        other_view = NIO_ByteBuffer_View_unwrap(other);
+        data = NIO_ByteBuffer_View_data(other_view);
+        length = other_view->length;
+    } else {
+        return Qfalse;
+    }
+
+    if (length != view->length) {
+        return Qfalse;
+    }
+
+    return memcmp(NIO_ByteBuffer_View_data(view), data, length) == 0 ? Qtrue : Qfalse;
+}
+
+static VALUE NIO_ByteBuffer_View_inspect(VALUE self)
+{
+    struct NIO_ByteBuffer_View *view = NIO_ByteBuffer_View_unwrap(self);
+
+    return rb_sprintf(
+        "#<%s:%p @size=%d>",
+        rb_class2name(CLASS_OF(self)),
+        (void *)self,
+        view->length);
+}
@@ -0,0 +1,588 @@
+/*
+ * Distributed under the MIT License. See LICENSE.txt for further details.
+ */
+
+#include "nio4r.h"
+#include "ruby/thread_native.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* Chunks are carved out of slabs of this many at a time */
+#define NIO_SLAB_CHUNKS 16
+
+/* Fresh chunks read_from reads into beyond the last one, at most */
+#define NIO_CHUNKED_READ_CHUNKS 16
+
+struct NIO_Slab;
+
+struct NIO_Chunk {
+    struct NIO_Chunk *next;
+    struct NIO_Slab *slab;
+    char data[NIO_CHUNK_SIZE];
+};
+
+struct NIO_Slab {
+    struct NIO_Slab *prev, *next; /* among the slabs with free chunks */
+    struct NIO_Chunk *free;
+    int used;
+    struct NIO_Chunk chunks[NIO_SLAB_CHUNKS];
+};
+
+/* Shared by every ChunkedBuffer in the process. Ractors may use it in
+   parallel, so it has a lock of its own. Slabs come from malloc rather than
+   xmalloc, which could run the GC (and free buffers) while it's held */
+static struct {
+    rb_nativethread_lock_t lock;
+    struct NIO_Slab *available;
+    int empty_slabs; /* kept around for the next buffer to grow, at most one */
+    size_t slabs, chunks_in_use;
+} NIO_Slab_pool;
+
+static VALUE mNIO = Qnil;
+static VALUE cNIO_ChunkedBuffer = Qnil;
+
+/* Allocator/deallocator */
+static VALUE NIO_ChunkedBuffer_allocate(VALUE klass);
+static void NIO_ChunkedBuffer_free(void *data);
+static size_t NIO_ChunkedBuffer_memsize(const void *data);
+
+/* Class methods */
+static VALUE NIO_ChunkedBuffer_pool(VALUE klass);
+
+/* Methods */
+static VALUE NIO_ChunkedBuffer_remaining(VALUE self);
+static VALUE NIO_ChunkedBuffer_capacity(VALUE self);
+static VALUE NIO_ChunkedBuffer_put(VALUE self, VALUE string);
+static VALUE NIO_ChunkedBuffer_get(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_ChunkedBuffer_read_from(VALUE self, VALUE io);
+static VALUE NIO_ChunkedBuffer_write_to(VALUE self, VALUE io);
+static VALUE NIO_ChunkedBuffer_clear(VALUE self);
+static VALUE NIO_ChunkedBuffer_compact(VALUE self);
+static VALUE NIO_ChunkedBuffer_inspect(VALUE self);
+
+/* Internal functions */
+static struct NIO_Chunk *NIO_Chunk_take(void);
+static void NIO_Chunk_release(struct NIO_Chunk *chunk);
+static void NIO_ChunkedBuffer_append(struct NIO_ChunkedBuffer *buffer, struct NIO_Chunk *chunk);
+static void NIO_ChunkedBuffer_clear_chunks(struct NIO_ChunkedBuffer *buffer);
+static void NIO_ChunkedBuffer_advance(struct NIO_ChunkedBuffer *buffer, size_t nbytes);
+
+/* Compatibility for Ruby <= 3.1 */
+#ifndef HAVE_RB_IO_DESCRIPTOR
+static int
+io_descriptor_fallback(VALUE io)
+{
+    rb_io_t *fptr;
+    GetOpenFile(io, fptr);
+    return fptr->fd;
+}
+#define rb_io_descriptor io_descriptor_fallback
+#endif
+
+static void
+io_set_nonblock(VALUE io)
+{
+    rb_io_t *fptr;
+    GetOpenFile(io, fptr);
+    rb_io_set_nonblock(fptr);
+}
+
+/* Byte buffers which grow a chunk at a time, rather than being sized for the
+   most they'll ever hold up front */
+void Init_NIO_ChunkedBuffer()
+{
+    rb_nativethread_lock_initialize(&NIO_Slab_pool.lock);
+
+    mNIO = rb_define_module("NIO");
+    cNIO_ChunkedBuffer = rb_define_class_under(mNIO, "ChunkedBuffer", rb_cObject);
+    rb_define_alloc_func(cNIO_ChunkedBuffer, NIO_ChunkedBuffer_allocate);
+
+    rb_define_const(cNIO_ChunkedBuffer, "CHUNK_SIZE", INT2NUM(NIO_CHUNK_SIZE));
+
+    rb_define_singleton_method(cNIO_ChunkedBuffer, "pool", NIO_ChunkedBuffer_pool, 0);
+
+    rb_define_method(cNIO_ChunkedBuffer, "remaining", NIO_ChunkedBuffer_remaining, 0);
+    rb_define_method(cNIO_ChunkedBuffer, "capacity", NIO_ChunkedBuffer_capacity, 0);
+    rb_define_method(cNIO_ChunkedBuffer, "<<", NIO_ChunkedBuffer_put, 1);
+    rb_define_method(cNIO_ChunkedBuffer, "get", NIO_ChunkedBuffer_get, -1);
+    rb_define_method(cNIO_ChunkedBuffer, "read_from", NIO_ChunkedBuffer_read_from, 1);
+    rb_define_method(cNIO_ChunkedBuffer, "write_to", NIO_ChunkedBuffer_write_to, 1);
+    rb_define_method(cNIO_ChunkedBuffer, "clear", NIO_ChunkedBuffer_clear, 0);
+    rb_define_method(cNIO_ChunkedBuffer, "compact", NIO_ChunkedBuffer_compact, 0);
+    rb_define_method(cNIO_ChunkedBuffer, "inspect", NIO_ChunkedBuffer_inspect, 0);
+}
+
+static const rb_data_type_t NIO_ChunkedBuffer_type = {
+    "NIO::ChunkedBuffer",
+    {
+        NULL, // Nothing to mark
+        NIO_ChunkedBuffer_free,
+        NIO_ChunkedBuffer_memsize,
+    },
+    0,
+    0,
+    RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+static VALUE NIO_ChunkedBuffer_allocate(VALUE klass)
+{
+    struct NIO_ChunkedBuffer *buffer;
+    return TypedData_Make_Struct(klass, struct NIO_ChunkedBuffer, &NIO_ChunkedBuffer_type, buffer);
+}
+
+static void NIO_ChunkedBuffer_free(void *data)
+{
+    struct NIO_ChunkedBuffer *buffer = (struct NIO_ChunkedBuffer *)data;
+    NIO_ChunkedBuffer_clear_chunks(buffer);
+    xfree(buffer);
+}
+
+static size_t NIO_ChunkedBuffer_memsize(const void *data)
+{
+    const struct NIO_ChunkedBuffer *buffer = (const struct NIO_ChunkedBuffer *)data;
+    return sizeof(*buffer) + buffer->chunks * sizeof(struct NIO_Chunk);
+}
+
+/* Statistics for the process-wide pool chunks are taken from */
+static VALUE NIO_ChunkedBuffer_pool(VALUE klass)
+{
+    VALUE stats = rb_hash_new();
+    size_t slabs, chunks_in_use;
+
+    rb_nativethread_lock_lock(&NIO_Slab_pool.lock);
+    slabs = NIO_Slab_pool.slabs;
+    chunks_in_use = NIO_Slab_pool.chunks_in_use;
+    rb_nativethread_lock_unlock(&NIO_Slab_pool.lock);
+
+    rb_hash_aset(stats, ID2SYM(rb_intern("chunk_size")), INT2NUM(NIO_CHUNK_SIZE));
+    rb_hash_aset(stats, ID2SYM(rb_intern("slabs")), SIZET2NUM(slabs));
+    rb_hash_aset(stats, ID2SYM(rb_intern("chunks_in_use")), SIZET2NUM(chunks_in_use));
+    rb_hash_aset(stats, ID2SYM(rb_intern("chunks_free")), SIZET2NUM(slabs * NIO_SLAB_CHUNKS - chunks_in_use));
+
+    return stats;
+}
+
+/* Number of bytes which haven't been read out of the buffer yet */
+static VALUE NIO_ChunkedBuffer_remaining(VALUE self)
+{
+    struct NIO_ChunkedBuffer *buffer;
+    TypedData_Get_Struct(self, struct NIO_ChunkedBuffer, &NIO_ChunkedBuffer_type, buffer);
+
+    return SIZET2NUM(buffer->remaining);
+}
+
+/* Size of the chunks the buffer holds */
+static VALUE NIO_ChunkedBuffer_capacity(VALUE self)
+{
+    struct NIO_ChunkedBuffer *buffer;
+    TypedData_Get_Struct(self, struct NIO_ChunkedBuffer, &NIO_ChunkedBuffer_type, buffer);
+
+    return SIZET2NUM((size_t)buffer->chunks * NIO_CHUNK_SIZE);
+}
+
+/* Append a String, growing the buffer as needed */
+static VALUE NIO_ChunkedBuffer_put(VALUE self, VALUE string)
+{
+    struct NIO_ChunkedBuffer *buffer;
+    const char *data;
+    long length, space;
+
+    TypedData_Get_Struct(self, struct NIO_ChunkedBuffer, &NIO_ChunkedBuffer_type, buffer);
+
+    StringValue(string);
+    data = RSTRING_PTR(string);
+    length = RSTRING_LEN(string);
+
+    while (length > 0) {
+        if (!buffer->tail || buffer->write_offset == NIO_CHUNK_SIZE) {
+            NIO_ChunkedBuffer_append(buffer, NIO_Chunk_take());
+        }
+
+        space = NIO_CHUNK_SIZE - buffer->write_offset;
+        if (space > length) {
+            space = length;
+        }
+
+        memcpy(buffer->tail->data + buffer->write_offset, data, space);
+        buffer->write_offset += (int)space;
+        buffer->remaining += space;
+        data += space;
+        length -= space;
+    }
+
+    RB_GC_GUARD(string);
+
+    return self;
+}
+
+/* Read the requested number of bytes out of the buffer, or all of them */
+static VALUE NIO_ChunkedBuffer_get(int argc, VALUE *argv, VALUE self)
+{
+    struct NIO_ChunkedBuffer *buffer;
+    struct NIO_Chunk *chunk;
+    VALUE length, result;
+    long len, copied = 0, offset, available;
+
+    TypedData_Get_Struct(self, struct NIO_ChunkedBuffer, &NIO_ChunkedBuffer_type, buffer);
+    rb_scan_args(argc, argv, "01", &length);
+
+    len = length == Qnil ? (long)buffer->remaining : NUM2LONG(length);
+
+    if (len < 0) {
+        rb_raise(rb_eArgError, "negative length given");
+    }
+
+    if ((size_t)len > buffer->remaining) {
+        rb_raise(rb_path2class("NIO::ByteBuffer::UnderflowError"), "not enough data in buffer");
+    }
+
+    result = rb_str_new(0, len);
+    chunk = buffer->read;
+    offset = buffer->read_offset;
+
+    while (copied < len) {
+        available = (chunk == buffer->tail ? buffer->write_offset : NIO_CHUNK_SIZE) - offset;
+        if (available > len - copied) {
+            available = len - copied;
+        }
+
+        memcpy(RSTRING_PTR(result) + copied, chunk->data + offset, available);
+        copied += available;
+        chunk = chunk->next;
+        offset = 0;
+    }
+
+    NIO_ChunkedBuffer_advance(buffer, len);
+
+    return result;
+}
+
+/* Perform a non-blocking read from the given IO object with a single readv,
+   into what's left of the last chunk and as many fresh ones as it takes.
+   Returns 0 if no data was available, or nil at end of file */
+static VALUE NIO_ChunkedBuffer_read_from(VALUE self, VALUE io)
+{
+    struct NIO_ChunkedBuffer *buffer;
+    struct NIO_Chunk *fresh[NIO_CHUNKED_READ_CHUNKS];
+    struct iovec iovecs[NIO_CHUNKED_READ_CHUNKS + 1];
+    ssize_t bytes_read, length, filled, space = 0;
+    int i, count = 0, saved_errno;
+
+    TypedData_Get_Struct(self, struct NIO_ChunkedBuffer, &NIO_ChunkedBuffer_type, buffer);
+
+    io = rb_convert_type(io, T_FILE, "IO", "to_io");
+    io_set_nonblock(io);
+
+    if (buffer->tail && buffer->write_offset < NIO_CHUNK_SIZE) {
+        space = NIO_CHUNK_SIZE - buffer->write_offset;
+        iovecs[count].iov_base = buffer->tail->data + buffer->write_offset;
+        iovecs[count++].iov_len = space;
+    }
+
+    for (i = 0; i < NIO_CHUNKED_READ_CHUNKS; i++) {
+        fresh[i] = NIO_Chunk_take();
+        iovecs[count].iov_base = fresh[i]->data;
+        iovecs[count++].iov_len = NIO_CHUNK_SIZE;
+    }
+
+    bytes_read = readv(rb_io_descriptor(io), iovecs, count);
+    saved_errno = errno;
+
+    /* Keep the chunks which were read into, and give the rest back */
+    length = bytes_read > 0 ? bytes_read : 0;
+    filled = length < space ? length : space;
+    buffer->write_offset += (int)filled;
+    length -= filled;
+
+    for (i = 0; i < NIO_CHUNKED_READ_CHUNKS; i++) {
+        if (length > 0) {
+            NIO_ChunkedBuffer_append(buffer, fresh[i]);
+            buffer->write_offset = length < NIO_CHUNK_SIZE ? (int)length : NIO_CHUNK_SIZE;
+            length -= buffer->write_offset;
+        } else {
+            NIO_Chunk_release(fresh[i]);
+        }
+    }
+
+    if (bytes_read < 0) {
+        if (saved_errno == EAGAIN) {
+            return INT2NUM(0);
+        } else {
+            errno = saved_errno;
+            rb_sys_fail("readv");
+        }
+    }
+
+    if (bytes_read == 0) {
+        return Qnil;
+    }
+
+    buffer->remaining += bytes_read;
+
+    return SSIZET2NUM(bytes_read);
+}
+
+/* Perform a non-blocking write of what remains in the buffer to the given IO
+   object, with a single writev across its chunks */
+static VALUE NIO_ChunkedBuffer_write_to(VALUE self, VALUE io)
+{
+    struct NIO_ChunkedBuffer *buffer;
+    struct NIO_Chunk *chunk;
+    struct iovec iovecs[IOV_MAX];
+    ssize_t bytes_written;
+    int count = 0, offset;
+
+    TypedData_Get_Struct(self, struct NIO_ChunkedBuffer, &NIO_ChunkedBuffer_type, buffer);
+
+    io = rb_convert_type(io, T_FILE, "IO", "to_io");
+    io_set_nonblock(io);
+
+    if (buffer->remaining == 0) {
+        rb_raise(rb_path2class("NIO::ByteBuffer::UnderflowError"), "no data remaining in buffer");
+    }
+
+    offset = buffer->read_offset;
+    for (chunk = buffer->read; chunk && count < IOV_MAX; chunk = chunk->next) {
+        iovecs[count].iov_base = chunk->data + offset;
+        iovecs[count].iov_len = (chunk == buffer->tail ? buffer->write_offset : NIO_CHUNK_SIZE) - offset;
+        offset = 0;
+
+        if (iovecs[count].iov_len > 0) {
+            count++;
+        }
+    }
+
+    bytes_written = writev(rb_io_descriptor(io), iovecs, count);
+
+    if (bytes_written < 0) {
+        if (errno == EAGAIN) {
+            return INT2NUM(0);
+        } else {
+            rb_sys_fail("writev");
+        }
+    }
+
+    NIO_ChunkedBuffer_advance(buffer, bytes_written);
+
+    return SSIZET2NUM(bytes_written);
+}
+
+/* Empty the buffer, returning all of its chunks to the pool */
+static VALUE NIO_ChunkedBuffer_clear(VALUE self)
+{
+    struct NIO_ChunkedBuffer *buffer;
+    TypedData_Get_Struct(self, struct NIO_ChunkedBuffer, &NIO_ChunkedBuffer_type, buffer);
+
+    NIO_ChunkedBuffer_clear_chunks(buffer);
+
+    return self;
+}
+
+/* Return the chunks which have been read out of to the pool */
+static VALUE NIO_ChunkedBuffer_compact(VALUE self)
+{
+    struct NIO_ChunkedBuffer *buffer;
+    struct NIO_Chunk *chunk;
+
+    TypedData_Get_Struct(self, struct NIO_ChunkedBuffer, &NIO_ChunkedBuffer_type, buffer);
+
+    if (buffer->remaining == 0) {
+        NIO_ChunkedBuffer_clear_chunks(buffer);
+        return self;
+    }
+
+    /* The chunk being read may have been read to the end */
+    if (buffer->read_offset == NIO_CHUNK_SIZE) {
+        buffer->read = buffer->read->next;
+        buffer->read_offset = 0;
+    }
+
+    while (buffer->head != buffer->read) {
+        chunk = buffer->head;
+        buffer->head = chunk->next;
+        buffer->chunks--;
+        NIO_Chunk_release(chunk);
+    }
+
+    return self;
+}
+
+static VALUE NIO_ChunkedBuffer_inspect(VALUE self)
+{
+    struct NIO_ChunkedBuffer *buffer;
+    TypedData_Get_Struct(self, struct NIO_ChunkedBuffer, &NIO_ChunkedBuffer_type, buffer);
+
+    return rb_sprintf(
+        "#<%s:%p @remaining=%lu @chunks=%d>",
+        rb_class2name(CLASS_OF(self)),
+        (void *)self,
+        (unsigned long)buffer->remaining,
+        buffer->chunks);
+}
+
+/* Return every chunk to the pool */
+static void NIO_ChunkedBuffer_clear_chunks(struct NIO_ChunkedBuffer *buffer)
+{
+    struct NIO_Chunk *chunk;
+
+    while ((chunk = buffer->head)) {
+        buffer->head = chunk->next;
+        NIO_Chunk_release(chunk);
+    }
+
+    buffer->read = buffer->tail = 0;
+    buffer->read_offset = buffer->write_offset = 0;
+    buffer->remaining = 0;
+    buffer->chunks = 0;
+}
+
+/* Add an empty chunk to the end of the buffer */
+static void NIO_ChunkedBuffer_append(struct NIO_ChunkedBuffer *buffer, struct NIO_Chunk *chunk)
+{
+    chunk->next = 0;
+
+    if (buffer->tail) {
+        buffer->tail->next = chunk;
+    } else {
+        buffer->head = buffer->read = chunk;
+        buffer->read_offset = 0;
+    }
+
+    buffer->tail = chunk;
+    buffer->write_offset = 0;
+    buffer->chunks++;
+}
+
+/* Move past bytes which have been read out of the buffer */
+static void NIO_ChunkedBuffer_advance(struct NIO_ChunkedBuffer *buffer, size_t nbytes)
+{
+    size_t available;
+
+    buffer->remaining -= nbytes;
+
+    while (nbytes > 0) {
+        available = (buffer->read == buffer->tail ? buffer->write_offset : NIO_CHUNK_SIZE) - buffer->read_offset;
+
+        if (available == 0) {
+            buffer->read = buffer->read->next;
+            buffer->read_offset = 0;
+            continue;
+        }
+
+        if (available > nbytes) {
+            available = nbytes;
+        }
+
+        buffer->read_offset += (int)available;
+        nbytes -= available;
+    }
+}
+
+/* Take a chunk from a slab with some to spare, or a new slab */
+static struct NIO_Chunk *NIO_Chunk_take(void)
+{
+    struct NIO_Slab *slab;
+    struct NIO_Chunk *chunk;
+    int i;
+
+    rb_nativethread_lock_lock(&NIO_Slab_pool.lock);
+
+    slab = NIO_Slab_pool.available;
+    if (!slab) {
+        slab = (struct NIO_Slab *)malloc(sizeof(struct NIO_Slab));
+        if (!slab) {
+            rb_nativethread_lock_unlock(&NIO_Slab_pool.lock);
+            rb_memerror();
+        }
+
+        slab->prev = slab->next = 0;
+        slab->free = 0;
+        slab->used = 0;
+        for (i = NIO_SLAB_CHUNKS - 1; i >= 0; i--) {
+            slab->chunks[i].slab = slab;
+            slab->chunks[i].next = slab->free;
+            slab->free = &slab->chunks[i];
+        }
+
+        NIO_Slab_pool.available = slab;
+        NIO_Slab_pool.slabs++;
+        NIO_Slab_pool.empty_slabs++;
+    }
+
+    if (slab->used++ == 0) {
+        NIO_Slab_pool.empty_slabs--;
+    }
+
+    chunk = slab->free;
+    slab->free = chunk->next;
+
+    /* Full slabs aren't available any more */
+    if (!slab->free) {
+        NIO_Slab_pool.available = slab->next;
+        if (slab->next) {
+            slab->next->prev = 0;
+        }
+        slab->next = 0;
+    }
+
+    NIO_Slab_pool.chunks_in_use++;
+    rb_nativethread_lock_unlock(&NIO_Slab_pool.lock);
+
+    return chunk;
+}
+
+/* Give a chunk back to its slab, freeing the slab once it's empty unless
+   it's the only empty one left */
+static void NIO_Chunk_release(struct NIO_Chunk *chunk)
+{
+    struct NIO_Slab *slab = chunk->slab;
+
+    rb_nativethread_lock_lock(&NIO_Slab_pool.lock);
+
+    /* Full slabs become available again */
+    if (!slab->free) {
+        slab->prev = 0;
+        slab->next = NIO_Slab_pool.available;
+        if (slab->next) {
+            slab->next->prev = slab;
+        }
+        NIO_Slab_pool.available = slab;
+    }
+
+    chunk->next = slab->free;
+    slab->free = chunk;
+    NIO_Slab_pool.chunks_in_use--;
+
+    if (--slab->used == 0) {
+        if (NIO_Slab_pool.empty_slabs > 0) {
+            if (slab->prev) {
+                slab->prev->next = slab->next;
+            } else {
+                NIO_Slab_pool.available = slab->next;
+            }
+            if (slab->next) {
+                slab->next->prev = slab->prev;
+            }
+
+            NIO_Slab_pool.slabs--;
+            free(slab);
+        } else {
+            NIO_Slab_pool.empty_slabs++;
+        }
+    }
+
+    rb_nativethread_lock_unlock(&NIO_Slab_pool.lock);
+}
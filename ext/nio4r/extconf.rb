@@ -30,7 +30,19 @@ end
 require "mkmf"
 
 have_header("unistd.h")
+have_header("sys/eventfd.h")
 have_func("rb_io_descriptor")
+have_func("rb_io_closed_p")
+have_func("rb_io_blocking_region", "ruby/io.h")
+have_func("rb_thread_io_blocking_region")
+have_func("rb_fiber_scheduler_current", "ruby/fiber/scheduler.h")
+have_type("struct io_uring_buf_reg", "linux/io_uring.h")
+have_func("accept4", "sys/socket.h")
+have_header("sys/sendfile.h")
+have_func("sendfile", "sys/sendfile.h")
+have_func("splice", "fcntl.h")
+have_header("linux/errqueue.h")
+have_header("sys/mman.h")
 
 $defs << "-DEV_USE_LINUXAIO"     if have_header("linux/aio_abi.h")
 $defs << "-DEV_USE_IOURING"      if have_header("linux/io_uring.h")
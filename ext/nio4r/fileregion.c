@@ -0,0 +1,292 @@
+/*
+ * Distributed under the MIT License. See LICENSE.txt for further details.
+ */
+
+/* For splice */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+
+#include "nio4r.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+
+/* How much write_to copies at a time when the kernel can't transfer the
+   region itself */
+#define NIO_FILEREGION_COPY_SIZE 16384
+
+static VALUE mNIO = Qnil;
+static VALUE cNIO_FileRegion = Qnil;
+
+/* Allocator/deallocator */
+static VALUE NIO_FileRegion_allocate(VALUE klass);
+static void NIO_FileRegion_mark(void *data);
+static size_t NIO_FileRegion_memsize(const void *data);
+
+/* Methods */
+static VALUE NIO_FileRegion_initialize(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_FileRegion_io(VALUE self);
+static VALUE NIO_FileRegion_offset(VALUE self);
+static VALUE NIO_FileRegion_remaining(VALUE self);
+static VALUE NIO_FileRegion_write_to(VALUE self, VALUE io);
+static VALUE NIO_FileRegion_close(VALUE self);
+static VALUE NIO_FileRegion_inspect(VALUE self);
+
+/* Internal functions */
+static ssize_t NIO_FileRegion_transfer(int in_fd, int out_fd, off_t offset, size_t count);
+static ssize_t NIO_FileRegion_copy(int in_fd, int out_fd, off_t offset, size_t count);
+
+/* Compatibility for Ruby <= 3.1 */
+#ifndef HAVE_RB_IO_DESCRIPTOR
+static int
+io_descriptor_fallback(VALUE io)
+{
+    rb_io_t *fptr;
+    GetOpenFile(io, fptr);
+    return fptr->fd;
+}
+#define rb_io_descriptor io_descriptor_fallback
+#endif
+
+static void
+io_set_nonblock(VALUE io)
+{
+    rb_io_t *fptr;
+    GetOpenFile(io, fptr);
+    rb_io_set_nonblock(fptr);
+}
+
+/* Regions of files, written to sockets and pipes by the kernel without
+   copying them through a ByteBuffer */
+void Init_NIO_FileRegion()
+{
+    mNIO = rb_define_module("NIO");
+    cNIO_FileRegion = rb_define_class_under(mNIO, "FileRegion", rb_cObject);
+    rb_define_alloc_func(cNIO_FileRegion, NIO_FileRegion_allocate);
+
+    rb_define_method(cNIO_FileRegion, "initialize", NIO_FileRegion_initialize, -1);
+    rb_define_method(cNIO_FileRegion, "io", NIO_FileRegion_io, 0);
+    rb_define_method(cNIO_FileRegion, "offset", NIO_FileRegion_offset, 0);
+    rb_define_method(cNIO_FileRegion, "remaining", NIO_FileRegion_remaining, 0);
+    rb_define_method(cNIO_FileRegion, "write_to", NIO_FileRegion_write_to, 1);
+    rb_define_method(cNIO_FileRegion, "close", NIO_FileRegion_close, 0);
+    rb_define_method(cNIO_FileRegion, "inspect", NIO_FileRegion_inspect, 0);
+}
+
+static const rb_data_type_t NIO_FileRegion_type = {
+    "NIO::FileRegion",
+    {
+        NIO_FileRegion_mark,
+        RUBY_TYPED_DEFAULT_FREE,
+        NIO_FileRegion_memsize,
+    },
+    0,
+    0,
+    RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+static VALUE NIO_FileRegion_allocate(VALUE klass)
+{
+    struct NIO_FileRegion *region;
+    VALUE obj = TypedData_Make_Struct(klass, struct NIO_FileRegion, &NIO_FileRegion_type, region);
+    RB_OBJ_WRITE(obj, &region->io, Qnil);
+    return obj;
+}
+
+static void NIO_FileRegion_mark(void *data)
+{
+    struct NIO_FileRegion *region = (struct NIO_FileRegion *)data;
+    rb_gc_mark(region->io);
+}
+
+static size_t NIO_FileRegion_memsize(const void *data)
+{
+    return sizeof(struct NIO_FileRegion);
+}
+
+/* Create a region of a file, given either an open File or a path to open.
+   The region extends to the end of the file unless a length is given */
+static VALUE NIO_FileRegion_initialize(int argc, VALUE *argv, VALUE self)
+{
+    struct NIO_FileRegion *region;
+    VALUE file, offset, length;
+    struct stat st;
+
+    TypedData_Get_Struct(self, struct NIO_FileRegion, &NIO_FileRegion_type, region);
+    rb_scan_args(argc, argv, "12", &file, &offset, &length);
+
+    if (RB_TYPE_P(file, T_STRING) || rb_respond_to(file, rb_intern("to_path"))) {
+        file = rb_funcall(rb_cFile, rb_intern("open"), 2, rb_get_path(file), rb_str_new_cstr("rb"));
+        region->owned = 1;
+    } else {
+        file = rb_convert_type(file, T_FILE, "IO", "to_io");
+        region->owned = 0;
+    }
+
+    RB_OBJ_WRITE(self, &region->io, file);
+
+    if (fstat(rb_io_descriptor(file), &st) < 0) {
+        rb_sys_fail("fstat");
+    }
+
+    region->offset = offset == Qnil ? 0 : NUM2OFFT(offset);
+    if (region->offset < 0 || region->offset > st.st_size) {
+        rb_raise(rb_eArgError, "offset is outside the file");
+    }
+
+    region->remaining = length == Qnil ? st.st_size - region->offset : NUM2OFFT(length);
+    if (region->remaining < 0) {
+        rb_raise(rb_eArgError, "negative length");
+    }
+
+    if (region->remaining > st.st_size - region->offset) {
+        rb_raise(rb_eArgError, "length is past the end of the file");
+    }
+
+    return self;
+}
+
+static VALUE NIO_FileRegion_io(VALUE self)
+{
+    struct NIO_FileRegion *region;
+    TypedData_Get_Struct(self, struct NIO_FileRegion, &NIO_FileRegion_type, region);
+
+    return region->io;
+}
+
+static VALUE NIO_FileRegion_offset(VALUE self)
+{
+    struct NIO_FileRegion *region;
+    TypedData_Get_Struct(self, struct NIO_FileRegion, &NIO_FileRegion_type, region);
+
+    return OFFT2NUM(region->offset);
+}
+
+static VALUE NIO_FileRegion_remaining(VALUE self)
+{
+    struct NIO_FileRegion *region;
+    TypedData_Get_Struct(self, struct NIO_FileRegion, &NIO_FileRegion_type, region);
+
+    return OFFT2NUM(region->remaining);
+}
+
+/* Perform a non-blocking write of the region to the given IO object, advancing
+   the offset past what was written. Returns 0 if the write would block, so the
+   rest can be written once the IO is writable again */
+static VALUE NIO_FileRegion_write_to(VALUE self, VALUE io)
+{
+    struct NIO_FileRegion *region;
+    ssize_t bytes_written;
+    size_t count;
+
+    TypedData_Get_Struct(self, struct NIO_FileRegion, &NIO_FileRegion_type, region);
+
+    if (region->remaining == 0) {
+        rb_raise(rb_path2class("NIO::ByteBuffer::UnderflowError"), "no data remaining in region");
+    }
+
+    io = rb_convert_type(io, T_FILE, "IO", "to_io");
+    io_set_nonblock(io);
+
+    count = region->remaining > SSIZE_MAX ? SSIZE_MAX : (size_t)region->remaining;
+    bytes_written = NIO_FileRegion_transfer(rb_io_descriptor(region->io), rb_io_descriptor(io), region->offset, count);
+
+    if (bytes_written < 0) {
+        if (errno == EAGAIN) {
+            return INT2NUM(0);
+        } else {
+            rb_sys_fail("write");
+        }
+    }
+
+    /* The file was truncated after the region was created */
+    if (bytes_written == 0) {
+        rb_raise(rb_eEOFError, "end of file reached");
+    }
+
+    region->offset += bytes_written;
+    region->remaining -= bytes_written;
+
+    return SSIZET2NUM(bytes_written);
+}
+
+/* Close the file if the region opened it */
+static VALUE NIO_FileRegion_close(VALUE self)
+{
+    struct NIO_FileRegion *region;
+    TypedData_Get_Struct(self, struct NIO_FileRegion, &NIO_FileRegion_type, region);
+
+    if (region->owned) {
+        rb_io_close(region->io);
+    }
+
+    return Qnil;
+}
+
+static VALUE NIO_FileRegion_inspect(VALUE self)
+{
+    struct NIO_FileRegion *region;
+    TypedData_Get_Struct(self, struct NIO_FileRegion, &NIO_FileRegion_type, region);
+
+    return rb_sprintf(
+        "#<%s:%p @offset=%lld @remaining=%lld>",
+        rb_class2name(CLASS_OF(self)),
+        (void *)self,
+        (long long)region->offset,
+        (long long)region->remaining);
+}
+
+/* Splice into pipes and sendfile into everything else, copying through a
+   buffer where the kernel can't transfer between the descriptors itself */
+static ssize_t NIO_FileRegion_transfer(int in_fd, int out_fd, off_t offset, size_t count)
+{
+    ssize_t nbytes = -1;
+    struct stat st;
+
+    if (fstat(out_fd, &st) < 0) {
+        return -1;
+    }
+
+#ifdef HAVE_SPLICE
+    if (S_ISFIFO(st.st_mode)) {
+        nbytes = splice(in_fd, &offset, out_fd, NULL, count, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    } else
+#endif
+    {
+#ifdef HAVE_SENDFILE
+        nbytes = sendfile(out_fd, in_fd, &offset, count);
+#else
+        errno = ENOSYS;
+#endif
+    }
+
+    if (nbytes < 0 && (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+        return NIO_FileRegion_copy(in_fd, out_fd, offset, count);
+    }
+
+    return nbytes;
+}
+
+static ssize_t NIO_FileRegion_copy(int in_fd, int out_fd, off_t offset, size_t count)
+{
+    char buffer[NIO_FILEREGION_COPY_SIZE];
+    ssize_t nbytes;
+
+    nbytes = pread(in_fd, buffer, count > sizeof(buffer) ? sizeof(buffer) : count, offset);
+    if (nbytes <= 0) {
+        return nbytes;
+    }
+
+    return write(out_fd, buffer, nbytes);
+}
@@ -5,6 +5,13 @@
 
 #include "nio4r.h"
 #include <assert.h>
+#include <errno.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
 
 static VALUE mNIO = Qnil;
 static VALUE cNIO_Monitor = Qnil;
@@ -28,11 +35,27 @@ static VALUE NIO_Monitor_is_readable(VALUE self);
 static VALUE NIO_Monitor_is_writable(VALUE self);
 static VALUE NIO_Monitor_value(VALUE self);
 static VALUE NIO_Monitor_set_value(VALUE self, VALUE obj);
+static VALUE NIO_Monitor_buffer(VALUE self);
+static VALUE NIO_Monitor_set_buffer(VALUE self, VALUE buffer);
+static VALUE NIO_Monitor_read_into(int argc, VALUE *argv, VALUE self);
 static VALUE NIO_Monitor_readiness(VALUE self);
+static VALUE NIO_Monitor_mode(VALUE self);
+static VALUE NIO_Monitor_set_mode(VALUE self, VALUE mode);
+static VALUE NIO_Monitor_rearm(VALUE self);
+static VALUE NIO_Monitor_idle_timeout(VALUE self);
+static VALUE NIO_Monitor_set_idle_timeout(VALUE self, VALUE timeout);
+static VALUE NIO_Monitor_submit_read(VALUE self, VALUE buffer);
+static VALUE NIO_Monitor_submit_write(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_Monitor_submit_receive(VALUE self);
+static VALUE NIO_Monitor_submit_accept(int argc, VALUE *argv, VALUE self);
 
 /* Internal C functions */
 static int NIO_Monitor_symbol2interest(VALUE interests);
 static void NIO_Monitor_update_interests(VALUE self, int interests);
+static int NIO_Monitor_events(struct NIO_Monitor *monitor);
+static VALUE NIO_Monitor_submit(VALUE self, VALUE buffer, enum NIO_Operation_type type, int batch, int zerocopy);
+static VALUE NIO_Monitor_read_nonblock_into(VALUE self, VALUE io, struct NIO_ByteBuffer *buffer);
+static VALUE NIO_Monitor_read_nonblock(VALUE args);
 
 /* Compatibility for Ruby <= 3.1 */
 #ifndef HAVE_RB_IO_DESCRIPTOR
@@ -64,7 +87,19 @@ void Init_NIO_Monitor()
     rb_define_method(cNIO_Monitor, "selector", NIO_Monitor_selector, 0);
     rb_define_method(cNIO_Monitor, "value", NIO_Monitor_value, 0);
     rb_define_method(cNIO_Monitor, "value=", NIO_Monitor_set_value, 1);
+    rb_define_method(cNIO_Monitor, "buffer", NIO_Monitor_buffer, 0);
+    rb_define_method(cNIO_Monitor, "buffer=", NIO_Monitor_set_buffer, 1);
+    rb_define_method(cNIO_Monitor, "read_into", NIO_Monitor_read_into, -1);
     rb_define_method(cNIO_Monitor, "readiness", NIO_Monitor_readiness, 0);
+    rb_define_method(cNIO_Monitor, "mode", NIO_Monitor_mode, 0);
+    rb_define_method(cNIO_Monitor, "mode=", NIO_Monitor_set_mode, 1);
+    rb_define_method(cNIO_Monitor, "rearm", NIO_Monitor_rearm, 0);
+    rb_define_method(cNIO_Monitor, "idle_timeout", NIO_Monitor_idle_timeout, 0);
+    rb_define_method(cNIO_Monitor, "idle_timeout=", NIO_Monitor_set_idle_timeout, 1);
+    rb_define_method(cNIO_Monitor, "submit_read", NIO_Monitor_submit_read, 1);
+    rb_define_method(cNIO_Monitor, "submit_write", NIO_Monitor_submit_write, -1);
+    rb_define_method(cNIO_Monitor, "submit_receive", NIO_Monitor_submit_receive, 0);
+    rb_define_method(cNIO_Monitor, "submit_accept", NIO_Monitor_submit_accept, -1);
     rb_define_method(cNIO_Monitor, "readable?", NIO_Monitor_is_readable, 0);
     rb_define_method(cNIO_Monitor, "writable?", NIO_Monitor_is_writable, 0);
     rb_define_method(cNIO_Monitor, "writeable?", NIO_Monitor_is_writable, 0);
@@ -90,6 +125,13 @@ static VALUE NIO_Monitor_allocate(VALUE klass)
     return TypedData_Wrap_Struct(klass, &NIO_Monitor_type, monitor);
 }
 
+struct NIO_Monitor *NIO_Monitor_unwrap(VALUE self)
+{
+    struct NIO_Monitor *monitor;
+    TypedData_Get_Struct(self, struct NIO_Monitor, &NIO_Monitor_type, monitor);
+    return monitor;
+}
+
 static void NIO_Monitor_mark(void *data)
 {
     struct NIO_Monitor *monitor = (struct NIO_Monitor *)data;
@@ -134,6 +176,9 @@ static VALUE NIO_Monitor_initialize(VALUE self, VALUE io, VALUE interests, VALUE
     RB_OBJ_WRITE(self, &monitor->self, self);
     monitor->ev_io.data = (void *)monitor;
 
+    ev_init(&monitor->idle_timer, NIO_Selector_idle_callback);
+    monitor->idle_timer.data = (void *)monitor;
+
     /* We can safely hang onto this as we also hang onto a reference to the
        object where it originally came from */
     monitor->selector = selector;
@@ -160,12 +205,16 @@ static VALUE NIO_Monitor_close(int argc, VALUE *argv, VALUE self)
             ev_io_stop(monitor->selector->ev_loop, &monitor->ev_io);
         }
 
+        if (monitor->selector->ev_loop) {
+            ev_timer_stop(monitor->selector->ev_loop, &monitor->idle_timer);
+        }
+
         monitor->selector = 0;
         rb_ivar_set(self, rb_intern("selector"), Qnil);
 
         /* Default value is true */
         if (deregister == Qtrue || deregister == Qnil) {
-            rb_funcall(selector, rb_intern("deregister"), 1, rb_ivar_get(self, rb_intern("io")));
+            NIO_Selector_deregister_monitor(selector, self);
         }
     }
 
@@ -238,6 +287,168 @@ static VALUE NIO_Monitor_set_value(VALUE self, VALUE obj)
     return rb_ivar_set(self, rb_intern("value"), obj);
 }
 
+/* The ByteBuffer read_into reads into by default */
+static VALUE NIO_Monitor_buffer(VALUE self)
+{
+    return rb_ivar_get(self, rb_intern("buffer"));
+}
+
+static VALUE NIO_Monitor_set_buffer(VALUE self, VALUE buffer)
+{
+    if (buffer != Qnil) {
+        NIO_ByteBuffer_unwrap(buffer);
+    }
+
+    return rb_ivar_set(self, rb_intern("buffer"), buffer);
+}
+
+/* Read from the IO into the buffer (the monitor's own by default) until it
+   would block or the buffer is full, without any exceptions for the former.
+   Returns the number of bytes read, or nil at end of file. If the end of
+   file comes after some data, that's returned first and the next call
+   returns nil */
+static VALUE NIO_Monitor_read_into(int argc, VALUE *argv, VALUE self)
+{
+    VALUE buffer, result;
+
+    rb_scan_args(argc, argv, "01", &buffer);
+
+    if (argc == 0) {
+        buffer = NIO_Monitor_buffer(self);
+        if (buffer == Qnil) {
+            rb_raise(rb_eArgError, "no buffer to read into");
+        }
+    }
+
+    result = NIO_Monitor_read_into_buffer(self, buffer);
+    if (rb_obj_is_kind_of(result, rb_eException)) {
+        rb_exc_raise(result);
+    }
+
+    return result;
+}
+
+/* The work of read_into, returning exceptions rather than raising them */
+VALUE NIO_Monitor_read_into_buffer(VALUE self, VALUE buffer_obj)
+{
+    struct NIO_Monitor *monitor;
+    struct NIO_ByteBuffer *buffer = NIO_ByteBuffer_unwrap(buffer_obj);
+    VALUE io, file;
+    rb_io_t *fptr;
+    ssize_t bytes_read, total = 0;
+
+    TypedData_Get_Struct(self, struct NIO_Monitor, &NIO_Monitor_type, monitor);
+
+    if (!monitor->selector) {
+        return rb_exc_new_cstr(rb_eEOFError, "monitor is closed");
+    }
+
+    if (monitor->eof) {
+        return Qnil;
+    }
+
+    if (buffer->position == buffer->limit) {
+        return rb_exc_new_cstr(rb_path2class("NIO::ByteBuffer::OverflowError"), "buffer is full");
+    }
+
+    /* Reading the descriptor directly would skip past whatever an IO has
+       buffered already, and the plaintext of an SSLSocket and the like */
+    io = rb_ivar_get(self, rb_intern("io"));
+    file = rb_convert_type(io, T_FILE, "IO", "to_io");
+    GetOpenFile(file, fptr);
+
+    if (io != file || rb_io_read_pending(fptr)) {
+        return NIO_Monitor_read_nonblock_into(self, io, buffer);
+    }
+
+    /* Like read_nonblock, but once per monitor */
+    if (!monitor->nonblock) {
+        rb_io_set_nonblock(fptr);
+        monitor->nonblock = 1;
+    }
+
+    NIO_ByteBuffer_modify(buffer, 1);
+    while (buffer->position < buffer->limit) {
+        bytes_read = read(monitor->ev_io.fd, buffer->buffer + buffer->position, buffer->limit - buffer->position);
+
+        if (bytes_read > 0) {
+            buffer->position += bytes_read;
+            total += bytes_read;
+        } else if (bytes_read == 0) {
+            monitor->eof = 1;
+            return total > 0 ? SSIZET2NUM(total) : Qnil;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK || total > 0) {
+            break;
+        } else {
+            return rb_syserr_new(errno, "read");
+        }
+    }
+
+    return SSIZET2NUM(total);
+}
+
+/* read_into for IO objects which have to be read with read_nonblock, as the
+   pure Ruby backend does */
+static VALUE NIO_Monitor_read_nonblock_into(VALUE self, VALUE io, struct NIO_ByteBuffer *buffer)
+{
+    struct NIO_Monitor *monitor = NIO_Monitor_unwrap(self);
+    VALUE args[2], data, error;
+    long total = 0, length;
+    int state = 0;
+
+    args[0] = io;
+
+    NIO_ByteBuffer_modify(buffer, 1);
+    while (buffer->position < buffer->limit) {
+        args[1] = INT2NUM(buffer->limit - buffer->position);
+        data = rb_protect(NIO_Monitor_read_nonblock, (VALUE)args, &state);
+
+        if (state) {
+            error = rb_errinfo();
+            if (!rb_obj_is_kind_of(error, rb_eIOError) && !rb_obj_is_kind_of(error, rb_eSystemCallError)) {
+                rb_jump_tag(state);
+            }
+
+            rb_set_errinfo(Qnil);
+            return total > 0 ? LONG2NUM(total) : error;
+        }
+
+        if (data == ID2SYM(rb_intern("wait_readable"))) {
+            break;
+        }
+
+        if (data == Qnil) {
+            monitor->eof = 1;
+            return total > 0 ? LONG2NUM(total) : Qnil;
+        }
+
+        length = RSTRING_LEN(data);
+        memcpy(buffer->buffer + buffer->position, RSTRING_PTR(data), length);
+        buffer->position += (int)length;
+        total += length;
+    }
+
+    return LONG2NUM(total);
+}
+
+static VALUE NIO_Monitor_read_nonblock(VALUE _args)
+{
+    VALUE *args = (VALUE *)_args;
+    VALUE argv[2];
+
+    argv[0] = args[1];
+    argv[1] = rb_hash_new();
+    rb_hash_aset(argv[1], ID2SYM(rb_intern("exception")), Qfalse);
+
+#ifdef RB_PASS_KEYWORDS
+    return rb_funcallv_kw(args[0], rb_intern("read_nonblock"), 2, argv, RB_PASS_KEYWORDS);
+#else
+    return rb_funcallv(args[0], rb_intern("read_nonblock"), 2, argv);
+#endif
+}
+
 static VALUE NIO_Monitor_readiness(VALUE self)
 {
     struct NIO_Monitor *monitor;
@@ -249,11 +460,191 @@ static VALUE NIO_Monitor_readiness(VALUE self)
         return ID2SYM(rb_intern("r"));
     } else if (monitor->revents & EV_WRITE) {
         return ID2SYM(rb_intern("w"));
+    } else if (monitor->revents & EV_TIMER) {
+        return ID2SYM(rb_intern("timeout"));
     } else {
         return Qnil;
     }
 }
 
+static VALUE NIO_Monitor_mode(VALUE self)
+{
+    struct NIO_Monitor *monitor;
+    TypedData_Get_Struct(self, struct NIO_Monitor, &NIO_Monitor_type, monitor);
+
+    switch (monitor->mode) {
+        case NIO_MONITOR_EDGE:
+            return ID2SYM(rb_intern("edge"));
+        case NIO_MONITOR_ONESHOT:
+            return ID2SYM(rb_intern("oneshot"));
+        default:
+            return ID2SYM(rb_intern("level"));
+    }
+}
+
+static VALUE NIO_Monitor_set_mode(VALUE self, VALUE mode)
+{
+    ID mode_id;
+    enum NIO_Monitor_mode new_mode;
+    struct NIO_Monitor *monitor;
+    TypedData_Get_Struct(self, struct NIO_Monitor, &NIO_Monitor_type, monitor);
+
+    if (NIO_Monitor_is_closed(self) == Qtrue) {
+        rb_raise(rb_eEOFError, "monitor is closed");
+    }
+
+    mode_id = SYM2ID(mode);
+
+    if (mode_id == rb_intern("level")) {
+        new_mode = NIO_MONITOR_LEVEL;
+    } else if (mode_id == rb_intern("edge")) {
+        new_mode = NIO_MONITOR_EDGE;
+    } else if (mode_id == rb_intern("oneshot")) {
+        new_mode = NIO_MONITOR_ONESHOT;
+    } else {
+        rb_raise(rb_eArgError, "invalid mode %s (must be :level, :edge, or :oneshot)", RSTRING_PTR(rb_funcall(mode, rb_intern("inspect"), 0)));
+    }
+
+    if (monitor->interests) {
+        ev_io_stop(monitor->selector->ev_loop, &monitor->ev_io);
+    }
+
+    /* Changing the mode (re)arms the monitor */
+    monitor->mode = new_mode;
+    ev_io_set(&monitor->ev_io, monitor->ev_io.fd, NIO_Monitor_events(monitor));
+
+    if (monitor->interests) {
+        ev_io_start(monitor->selector->ev_loop, &monitor->ev_io);
+    }
+
+    return mode;
+}
+
+static VALUE NIO_Monitor_rearm(VALUE self)
+{
+    struct NIO_Monitor *monitor;
+    TypedData_Get_Struct(self, struct NIO_Monitor, &NIO_Monitor_type, monitor);
+
+    if (NIO_Monitor_is_closed(self) == Qtrue) {
+        rb_raise(rb_eEOFError, "monitor is closed");
+    }
+
+    if (monitor->interests && !ev_is_active(&monitor->ev_io)) {
+        ev_io_start(monitor->selector->ev_loop, &monitor->ev_io);
+    }
+
+    return self;
+}
+
+/* Seconds the monitor can go without being selected before it's selected
+   with a readiness of :timeout, or nil */
+static VALUE NIO_Monitor_idle_timeout(VALUE self)
+{
+    struct NIO_Monitor *monitor;
+    TypedData_Get_Struct(self, struct NIO_Monitor, &NIO_Monitor_type, monitor);
+
+    return monitor->idle_timeout > 0 ? DBL2NUM(monitor->idle_timeout) : Qnil;
+}
+
+/* Setting the idle timeout starts counting from now, whether or not it has
+   already run out. Once it has, it starts again when the monitor is next
+   selected. Nil turns it off */
+static VALUE NIO_Monitor_set_idle_timeout(VALUE self, VALUE timeout)
+{
+    struct NIO_Monitor *monitor;
+    struct ev_loop *ev_loop;
+    ev_tstamp seconds = 0;
+
+    TypedData_Get_Struct(self, struct NIO_Monitor, &NIO_Monitor_type, monitor);
+
+    if (NIO_Monitor_is_closed(self) == Qtrue) {
+        rb_raise(rb_eEOFError, "monitor is closed");
+    }
+
+    if (timeout != Qnil) {
+        seconds = NUM2DBL(timeout);
+        if (seconds <= 0) {
+            rb_raise(rb_eArgError, "idle timeout must be positive");
+        }
+    }
+
+    ev_loop = monitor->selector->ev_loop;
+    if (!ev_loop) {
+        rb_raise(rb_eIOError, "selector is closed");
+    }
+
+    ev_timer_stop(ev_loop, &monitor->idle_timer);
+    monitor->idle_timeout = seconds;
+
+    if (seconds > 0) {
+        /* The loop's time is from its last iteration, unless it's running */
+        if (!monitor->selector->selecting) {
+            ev_now_update(ev_loop);
+        }
+
+        monitor->last_active = ev_now(ev_loop);
+        ev_timer_set(&monitor->idle_timer, seconds, 0.);
+        ev_timer_start(ev_loop, &monitor->idle_timer);
+    }
+
+    return timeout;
+}
+
+static VALUE NIO_Monitor_submit_read(VALUE self, VALUE buffer)
+{
+    return NIO_Monitor_submit(self, buffer, NIO_OPERATION_READ, 0, 0);
+}
+
+/* With zerocopy: true, sockets send straight from the buffer with
+   MSG_ZEROCOPY, and the operation completes once the kernel has let go of
+   it: for TCP, once the data has been acknowledged. Other IO objects, and
+   kernels without it, write as usual */
+static VALUE NIO_Monitor_submit_write(int argc, VALUE *argv, VALUE self)
+{
+    VALUE buffer, options, zerocopy = Qundef;
+    ID zerocopy_id = rb_intern("zerocopy");
+
+    rb_scan_args(argc, argv, "1:", &buffer, &options);
+    if (options != Qnil) {
+        rb_get_kwargs(options, &zerocopy_id, 0, 1, &zerocopy);
+    }
+
+    return NIO_Monitor_submit(self, buffer, NIO_OPERATION_WRITE, 0, zerocopy != Qundef && RTEST(zerocopy));
+}
+
+static VALUE NIO_Monitor_submit_receive(VALUE self)
+{
+    return NIO_Monitor_submit(self, Qnil, NIO_OPERATION_RECEIVE, 0, 0);
+}
+
+static VALUE NIO_Monitor_submit_accept(int argc, VALUE *argv, VALUE self)
+{
+    VALUE options;
+
+    rb_scan_args(argc, argv, "0:", &options);
+    return NIO_Monitor_accept(self, options);
+}
+
+VALUE NIO_Monitor_accept(VALUE self, VALUE options)
+{
+    VALUE batch = Qundef;
+    ID batch_id = rb_intern("batch");
+    int batch_size = NIO_ACCEPT_BATCH;
+
+    if (options != Qnil) {
+        rb_get_kwargs(options, &batch_id, 0, 1, &batch);
+    }
+
+    if (batch != Qundef) {
+        batch_size = NUM2INT(batch);
+        if (batch_size < 1) {
+            rb_raise(rb_eArgError, "batch must be positive");
+        }
+    }
+
+    return NIO_Monitor_submit(self, Qnil, NIO_OPERATION_ACCEPT, batch_size, 0);
+}
+
 static VALUE NIO_Monitor_is_readable(VALUE self)
 {
     struct NIO_Monitor *monitor;
@@ -334,7 +725,7 @@ static void NIO_Monitor_update_interests(VALUE self, int interests)
 
         // Assign the interests we are now monitoring for:
         monitor->interests = interests;
-        ev_io_set(&monitor->ev_io, monitor->ev_io.fd, monitor->interests);
+        ev_io_set(&monitor->ev_io, monitor->ev_io.fd, NIO_Monitor_events(monitor));
 
         // If we are interested in events, schedule the monitor back into the event loop:
         if (monitor->interests) {
@@ -342,3 +733,34 @@ static void NIO_Monitor_update_interests(VALUE self, int interests)
         }
     }
 }
+
+/* Submit an operation to the monitor's selector */
+static VALUE NIO_Monitor_submit(VALUE self, VALUE buffer, enum NIO_Operation_type type, int batch, int zerocopy)
+{
+    VALUE operation;
+    struct NIO_Operation *operation_data;
+
+    if (NIO_Monitor_is_closed(self) == Qtrue) {
+        rb_raise(rb_eEOFError, "monitor is closed");
+    }
+
+    operation = NIO_Operation_new(self, buffer, type);
+    operation_data = NIO_Operation_unwrap(operation);
+    operation_data->batch = batch;
+    operation_data->zerocopy = zerocopy ? NIO_ZEROCOPY_REQUESTED : NIO_ZEROCOPY_OFF;
+    NIO_Selector_submit(rb_ivar_get(self, rb_intern("selector")), operation);
+
+    return operation;
+}
+
+/* The libev event mask for the monitor's interests and mode. libev combines
+   the masks of every watcher on a descriptor, so an :edge monitor makes the
+   operations and fibers waiting on its IO edge-triggered too */
+static int NIO_Monitor_events(struct NIO_Monitor *monitor)
+{
+    if (monitor->mode == NIO_MONITOR_EDGE) {
+        return monitor->interests | EV__IOEDGE;
+    } else {
+        return monitor->interests;
+    }
+}
@@ -10,17 +10,88 @@
 #include "ruby.h"
 #include "ruby/io.h"
 
+/* Buffers lent to multishot receives with io_uring. Data only occupies one
+   while it waits to be selected, instead of every idle connection pinning a
+   buffer of its own */
+struct NIO_BufferPool {
+    int count, size;          /* number of buffers (a power of 2) and their size */
+    int unavailable;          /* the kernel doesn't support provided buffer rings */
+    void *ring;               /* struct io_uring_buf_ring shared with the kernel */
+    char *buffers;
+    char *scratch;            /* for receives we perform once the IO is ready */
+    int *lengths, *next;      /* received data, chained per operation by buffer id */
+    unsigned int tail;        /* buffers handed to the kernel */
+    int in_use;               /* buffers holding data which hasn't been selected */
+    unsigned long exhausted;  /* times receives ran out of buffers */
+};
+
+/* How ready monitors, timers and operations are handed to select's caller */
+enum NIO_Selector_dispatch {
+    NIO_DISPATCH_INLINE,   /* as libev calls back for each one (the default) */
+    NIO_DISPATCH_DEFERRED, /* collected, and yielded once the loop has run */
+    NIO_DISPATCH_CALL      /* the same, calling monitors' Proc or Method values */
+};
+
+/* Something found to be ready while the loop ran, waiting to be dispatched */
+struct NIO_Ready {
+    VALUE object;         /* a monitor, timer or operation */
+    int fd, revents;      /* for monitors, or -1 and 0 */
+};
+
 struct NIO_Selector {
+    VALUE self;
     struct ev_loop *ev_loop;
     struct ev_timer timer; /* for timeouts */
     struct ev_io wakeup;
 
     int ready_count;
+    int last_ready_count; /* to size the next array select returns */
     int closed, selecting;
-    int wakeup_reader, wakeup_writer;
-    volatile int wakeup_fired;
+    ev_tstamp wait_deadline; /* when the select in progress gives up, or 0 */
+    int wakeup_reader, wakeup_writer; /* the same descriptor when using eventfd */
+    volatile int wakeup_fired, wakeup_pending;
 
     VALUE ready_array;
+
+    /* Reentrant lock: the Mutex and the thread currently holding it */
+    VALUE lock, lock_holder;
+    int scheduling; /* threads waiting for it to schedule timers */
+
+    /* Registered monitors, indexed by file descriptor */
+    struct NIO_Monitor **monitors;
+    int monitors_capacity, monitors_count;
+
+    /* Submitted operations still in flight, and ones waiting to be selected */
+    struct NIO_Operation *operations;
+    struct NIO_Operation *completed, *completed_tail;
+
+    /* ByteBuffers registered with the kernel for fixed reads and writes */
+    VALUE fixed_buffers;
+
+    struct NIO_BufferPool buffer_pool;
+
+    /* Sockets waiting for MSG_ZEROCOPY completions on their error queues */
+    int zerocopy_epoll;
+    struct ev_io zerocopy_watcher;
+
+    /* Timers which haven't fired yet */
+    struct NIO_Timer *timers;
+
+    /* Fibers waiting in #io_wait, #kernel_sleep and #block, the ones to resume
+       once the loop has run, and finished waiters kept for reuse */
+    struct NIO_Waiter *waiters;
+    struct NIO_Waiter *resumable, *resumable_tail;
+    struct NIO_Waiter *spare_waiters;
+    VALUE unblocked; /* fibers passed to #unblock, possibly by other threads */
+
+    /* Readiness collected by deferred dispatch during the current select */
+    enum NIO_Selector_dispatch dispatch;
+    int deferring;
+    struct NIO_Ready *ready_events;
+    int ready_events_count, ready_events_capacity;
+
+    /* The String select_raw packs ready descriptors into as it runs */
+    VALUE raw_events;
 };
 
 struct NIO_callback_data {
@@ -28,21 +99,226 @@ struct NIO_callback_data {
     struct NIO_Selector *selector;
 };
 
+/* How a monitor is notified of readiness */
+enum NIO_Monitor_mode {
+    NIO_MONITOR_LEVEL,  /* whenever the IO is ready (the default) */
+    NIO_MONITOR_EDGE,   /* when the IO becomes ready, if the backend supports it */
+    NIO_MONITOR_ONESHOT /* once, until the monitor is rearmed */
+};
+
 struct NIO_Monitor {
     VALUE self;
     int interests, revents;
+    int nonblock, eof;    /* read_into has made the IO non-blocking, or seen its end */
+    int zerocopy;         /* SO_ZEROCOPY is enabled (1), unsupported (-1) or untried (0) */
+    unsigned int zerocopy_id; /* the kernel numbers MSG_ZEROCOPY sends per socket */
+    int zerocopy_pending; /* sends the kernel hasn't let go of yet */
+    enum NIO_Monitor_mode mode;
+    struct ev_io ev_io;
+    struct NIO_Selector *selector;
+
+    /* Selected as :timeout after this many seconds without being selected.
+       The timer is started again for whatever's left when it runs out early */
+    ev_tstamp idle_timeout, last_active;
+    struct ev_timer idle_timer;
+};
+
+/* A timer added to a selector, which is selected once its deadline passes.
+   Deadlines pushed back by NIO::Timer#reschedule only take effect when the
+   earlier one is reached, so keeping a timer from firing is O(1) */
+struct NIO_Timer {
+    VALUE self, selector_obj, value;
+    ev_tstamp interval, deadline;
+    struct ev_timer ev_timer;
+    struct NIO_Selector *selector; /* while it's pending */
+    struct NIO_Timer *prev, *next;
+};
+
+/* A fiber waiting on a selector for an IO to become ready, a timeout, or
+   to be unblocked. Waiters are reused, so waiting doesn't allocate */
+struct NIO_Waiter {
+    VALUE fiber;          /* or Qnil once it's stopped waiting */
+    VALUE result;         /* what the fiber is resumed with */
+    int events;           /* IO::READABLE, IO::PRIORITY and IO::WRITABLE waited for */
+    int resumable;        /* queued to be resumed */
     struct ev_io ev_io;
+    struct ev_timer ev_timer;
     struct NIO_Selector *selector;
+    struct NIO_Waiter *prev, *next;
+    struct NIO_Waiter *queue_next; /* among the resumable or spare waiters */
+};
+
+/* ByteBuffer memory shared with the Views taken from it. Writing to a buffer
+   while Views share its memory gives the buffer a copy of its own */
+struct NIO_ByteBuffer_memory {
+    char *data;
+    int size_class;       /* as for the buffer it came from */
+    int refs;             /* the buffer, until it's written to, and each View */
 };
 
 struct NIO_ByteBuffer {
     char *buffer;
     int position, limit, capacity, mark;
+    int size_class;       /* of memory checked out of NIO::ByteBuffer::Pool, or -1 */
+    int pins;             /* operations and registrations the kernel may use it for */
+    struct NIO_ByteBuffer_memory *shared; /* with Views, or NULL */
+    void *mapping;        /* from NIO::ByteBuffer.map, which buffer points into */
+    size_t mapping_length;
+    int readonly;         /* mapped without PROT_WRITE */
+};
+
+/* A ByteBuffer's mark when it hasn't been set */
+#define MARK_UNSET -1
+
+/* Size classes of NIO::ByteBuffer::Pool: powers of 2 from 64 bytes to 1 MiB */
+#define NIO_POOL_MIN_SHIFT 6
+#define NIO_POOL_MAX_SHIFT 20
+#define NIO_POOL_CLASSES (NIO_POOL_MAX_SHIFT - NIO_POOL_MIN_SHIFT + 1)
+
+/* Size of the chunks ChunkedBuffers grow by */
+#define NIO_CHUNK_SIZE 4096
+
+struct NIO_ChunkedBuffer {
+    struct NIO_Chunk *head, *read, *tail; /* first chunk, the one being read, the one being written */
+    int read_offset, write_offset;
+    size_t remaining;                     /* bytes written which haven't been read */
+    int chunks;
+};
+
+struct NIO_FileRegion {
+    VALUE io;
+    off_t offset, remaining;
+    int owned; /* opened from a path, so closed along with the region */
+};
+
+/* What an operation submitted through a monitor does */
+enum NIO_Operation_type {
+    NIO_OPERATION_READ,    /* into a ByteBuffer */
+    NIO_OPERATION_WRITE,   /* from a ByteBuffer */
+    NIO_OPERATION_RECEIVE, /* into the selector's buffer pool, until the end of the stream */
+    NIO_OPERATION_ACCEPT   /* connections, until cancelled */
+};
+
+/* Progress of a write submitted with zerocopy: true */
+enum NIO_Zerocopy_state {
+    NIO_ZEROCOPY_OFF,       /* written by copying, like any other write */
+    NIO_ZEROCOPY_REQUESTED, /* sent with MSG_ZEROCOPY once the socket is writable */
+    NIO_ZEROCOPY_SENT,      /* waiting for the kernel to let go of the buffer */
+    NIO_ZEROCOPY_DONE,      /* the kernel transmitted straight from the buffer */
+    NIO_ZEROCOPY_COPIED     /* the kernel copied the buffer after all */
+};
+
+/* Receives and accepts are selected again and again, whenever there's new
+   data or connections */
+#define NIO_OPERATION_MULTISHOT(operation) ((operation)->type >= NIO_OPERATION_RECEIVE)
+
+/* Connections accepted per readiness event by default, without io_uring */
+#define NIO_ACCEPT_BATCH 64
+
+/* An operation and its progress, performed by the kernel or by the selector */
+struct NIO_Operation {
+    VALUE self, monitor, buffer;
+    VALUE data, received; /* receives: data selected last, and data since */
+    VALUE socket_class;   /* accepts: what to wrap connections in */
+    enum NIO_Operation_type type;
+    int events;           /* EV_READ or EV_WRITE */
+    int offset, length;   /* the part of the buffer being transferred */
+    int result, completed; /* bytes transferred, or a negated errno */
+    int resubmit;         /* the kernel stopped receiving when the pool ran dry */
+    int chunks, chunks_tail; /* pooled buffers received into, or -1 */
+    int batch;            /* connections accepted at a time without io_uring */
+    enum NIO_Zerocopy_state zerocopy;
+    unsigned int zerocopy_id; /* of the send, once the kernel has the buffer */
+    int *sockets, sockets_count, sockets_capacity; /* connections not yet selected */
+    struct ev_iouring_op iouring; /* performed by the kernel with io_uring... */
+    struct ev_io ev_io;           /* ...or by us once the IO is ready */
+    struct NIO_ByteBuffer *pinned; /* the buffer, while the kernel may use it */
+    struct NIO_Selector *selector;
+    struct NIO_Operation *prev, *next; /* in flight */
+    struct NIO_Operation *queue_next;  /* waiting to be selected */
+    int queued;
 };
 
 struct NIO_Selector *NIO_Selector_unwrap(VALUE selector);
+struct NIO_Monitor *NIO_Monitor_unwrap(VALUE monitor);
+struct NIO_ByteBuffer *NIO_ByteBuffer_unwrap(VALUE buffer);
+struct NIO_Operation *NIO_Operation_unwrap(VALUE operation);
+
+/* Keep a buffer's memory from being checked back into the pool while the
+   kernel may still use it. These are safe to call without the GVL */
+void NIO_ByteBuffer_pin(struct NIO_ByteBuffer *buffer);
+void NIO_ByteBuffer_unpin(struct NIO_ByteBuffer *buffer);
+
+/* Call before writing to a buffer's memory, to make sure no Views share it.
+   Unless preserve is set, the buffer's contents are about to be overwritten.
+   Raises IOError if the buffer is read-only */
+void NIO_ByteBuffer_modify(struct NIO_ByteBuffer *buffer, int preserve);
+
+/* Let go of a buffer's memory, leaving it to any Views which share it */
+void NIO_ByteBuffer_release(struct NIO_ByteBuffer *buffer);
+void NIO_ByteBuffer_memory_release(struct NIO_ByteBuffer_memory *memory);
+
+/* An NIO::ByteBuffer::View of part of a buffer's memory, shared unless the
+   kernel may be using it */
+VALUE NIO_ByteBuffer_View_new(struct NIO_ByteBuffer *buffer, int offset, int length);
+
+/* The first occurrence of a needle in the data, or NULL */
+const char *NIO_ByteBuffer_search(const char *data, size_t length, const char *needle, size_t needle_length);
+
+/* Check memory out of NIO::ByteBuffer::Pool, and give it back */
+char *NIO_ByteBuffer_Pool_take(int size_class);
+void NIO_ByteBuffer_Pool_release(char *memory, int size_class);
+
+/* Create an NIO::Operation, transferring the remaining part of the buffer
+   for reads and writes */
+VALUE NIO_Operation_new(VALUE monitor, VALUE buffer, enum NIO_Operation_type type);
+
+/* The class accepted connections are wrapped in. Raises TypeError for IO
+   objects which aren't sockets */
+VALUE NIO_Operation_socket_class(VALUE io);
+
+/* Submit an accept on the monitor's server, as NIO::Monitor#submit_accept
+   does with the given keyword arguments (a Hash, or nil) */
+VALUE NIO_Monitor_accept(VALUE monitor, VALUE options);
+
+/* Read into the buffer until the IO would block or the buffer is full,
+   raising only if nothing could be read: see NIO::Monitor#read_into */
+VALUE NIO_Monitor_read_into_buffer(VALUE monitor, VALUE buffer);
+
+/* Deregister a monitor which is being closed, without looking up its IO */
+void NIO_Selector_deregister_monitor(VALUE selector, VALUE monitor);
 
 /* Thunk between libev callbacks in NIO::Monitors and NIO::Selectors */
 void NIO_Selector_monitor_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents);
 
+/* The same for NIO::Timers, which are selected once they've expired */
+void NIO_Selector_timer_callback(struct ev_loop *ev_loop, struct ev_timer *timer, int revents);
+
+/* ...and for monitors which have been idle for their idle_timeout */
+void NIO_Selector_idle_callback(struct ev_loop *ev_loop, struct ev_timer *timer, int revents);
+
+/* Run func with the selector's reentrant lock held */
+VALUE NIO_Selector_synchronize(VALUE self, VALUE (*func)(VALUE arg), VALUE arg);
+
+/* The same for changes to its timers, first waking up another thread which
+   is selecting if it would otherwise wait past the given deadline */
+VALUE NIO_Selector_synchronize_timer(VALUE self, ev_tstamp deadline, VALUE (*func)(VALUE arg), VALUE arg);
+
+/* Add a timer to a selector, which is selected after the given interval */
+VALUE NIO_Timer_new(VALUE selector, ev_tstamp interval, VALUE value);
+
+/* Stop a pending timer. Returns whether it was still pending */
+int NIO_Timer_stop(struct NIO_Timer *timer);
+
+/* Resume fibers whose waits are over, once the selector's loop has run.
+   Returns how many were resumed */
+int NIO_Selector_resume_waiters(struct NIO_Selector *selector);
+
+/* Stop waiters when their selector is closed, and free them with it */
+void NIO_Selector_stop_waiters(struct NIO_Selector *selector);
+void NIO_Selector_free_waiters(struct NIO_Selector *selector);
+
+/* Start performing an operation with the given selector */
+void NIO_Selector_submit(VALUE selector, VALUE operation);
+
 #endif /* NIO4R_H */
@@ -9,6 +9,15 @@
 void Init_NIO_Selector();
 void Init_NIO_Monitor();
 void Init_NIO_ByteBuffer();
+void Init_NIO_Operation();
+void Init_NIO_FileRegion();
+void Init_NIO_ChunkedBuffer();
+void Init_NIO_ByteBuffer_Pool();
+void Init_NIO_ByteBuffer_View();
+void Init_NIO_ByteBuffer_Search();
+void Init_NIO_ByteBuffer_Map();
+void Init_NIO_Timer();
+void Init_NIO_Selector_Scheduler();
 
 void Init_nio4r_ext()
 {
@@ -21,4 +30,13 @@ void Init_nio4r_ext()
     Init_NIO_Selector();
     Init_NIO_Monitor();
     Init_NIO_ByteBuffer();
+    Init_NIO_Operation();
+    Init_NIO_FileRegion();
+    Init_NIO_ChunkedBuffer();
+    Init_NIO_ByteBuffer_Pool();
+    Init_NIO_ByteBuffer_View();
+    Init_NIO_ByteBuffer_Search();
+    Init_NIO_ByteBuffer_Map();
+    Init_NIO_Timer();
+    Init_NIO_Selector_Scheduler();
 }
@@ -0,0 +1,230 @@
+/*
+ * Distributed under the MIT License. See LICENSE.txt for further details.
+ */
+
+#include "nio4r.h"
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+static VALUE mNIO = Qnil;
+static VALUE cNIO_Operation = Qnil;
+
+/* Allocator/deallocator */
+static void NIO_Operation_mark(void *data);
+static void NIO_Operation_free(void *data);
+static size_t NIO_Operation_memsize(const void *data);
+
+/* Methods */
+static VALUE NIO_Operation_monitor(VALUE self);
+static VALUE NIO_Operation_io(VALUE self);
+static VALUE NIO_Operation_buffer(VALUE self);
+static VALUE NIO_Operation_get_type(VALUE self);
+static VALUE NIO_Operation_is_completed(VALUE self);
+static VALUE NIO_Operation_result(VALUE self);
+static VALUE NIO_Operation_data(VALUE self);
+static VALUE NIO_Operation_is_zerocopy(VALUE self);
+
+
+/* Operations are reads and writes of ByteBuffers, submitted through monitors
+   and returned by the selector once they've completed. Receives and accepts
+   are returned whenever data or connections have arrived */
+void Init_NIO_Operation()
+{
+    mNIO = rb_define_module("NIO");
+    cNIO_Operation = rb_define_class_under(mNIO, "Operation", rb_cObject);
+    rb_undef_alloc_func(cNIO_Operation);
+
+    rb_define_method(cNIO_Operation, "monitor", NIO_Operation_monitor, 0);
+    rb_define_method(cNIO_Operation, "io", NIO_Operation_io, 0);
+    rb_define_method(cNIO_Operation, "buffer", NIO_Operation_buffer, 0);
+    rb_define_method(cNIO_Operation, "type", NIO_Operation_get_type, 0);
+    rb_define_method(cNIO_Operation, "completed?", NIO_Operation_is_completed, 0);
+    rb_define_method(cNIO_Operation, "result", NIO_Operation_result, 0);
+    rb_define_method(cNIO_Operation, "data", NIO_Operation_data, 0);
+    rb_define_method(cNIO_Operation, "zerocopy?", NIO_Operation_is_zerocopy, 0);
+}
+
+static const rb_data_type_t NIO_Operation_type = {
+    "NIO::Operation",
+    {
+        NIO_Operation_mark,
+        NIO_Operation_free,
+        NIO_Operation_memsize,
+    },
+    0,
+    0,
+    RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+VALUE NIO_Operation_new(VALUE monitor, VALUE buffer, enum NIO_Operation_type type)
+{
+    VALUE self, socket_class = Qnil;
+    struct NIO_Operation *operation;
+    struct NIO_ByteBuffer *bytebuffer = buffer == Qnil ? 0 : NIO_ByteBuffer_unwrap(buffer);
+    int length = bytebuffer ? bytebuffer->limit - bytebuffer->position : -1;
+
+    if (type == NIO_OPERATION_ACCEPT) {
+        socket_class = NIO_Operation_socket_class(rb_ivar_get(monitor, rb_intern("io")));
+    }
+
+    if (length == 0) {
+        if (type == NIO_OPERATION_READ) {
+            rb_raise(rb_path2class("NIO::ByteBuffer::OverflowError"), "buffer is full");
+        } else {
+            rb_raise(rb_path2class("NIO::ByteBuffer::UnderflowError"), "no data remaining in buffer");
+        }
+    }
+
+    /* Views mustn't see the kernel read into the buffer */
+    if (type == NIO_OPERATION_READ) {
+        NIO_ByteBuffer_modify(bytebuffer, 1);
+    }
+
+    self = TypedData_Make_Struct(cNIO_Operation, struct NIO_Operation, &NIO_Operation_type, operation);
+
+    RB_OBJ_WRITE(self, &operation->self, self);
+    RB_OBJ_WRITE(self, &operation->monitor, monitor);
+    RB_OBJ_WRITE(self, &operation->buffer, buffer);
+    RB_OBJ_WRITE(self, &operation->data, Qnil);
+    RB_OBJ_WRITE(self, &operation->received, Qnil);
+    RB_OBJ_WRITE(self, &operation->socket_class, socket_class);
+    operation->type = type;
+    operation->events = type == NIO_OPERATION_WRITE ? EV_WRITE : EV_READ;
+    operation->offset = bytebuffer ? bytebuffer->position : 0;
+    operation->length = length;
+    operation->chunks = operation->chunks_tail = -1;
+
+    return self;
+}
+
+struct NIO_Operation *NIO_Operation_unwrap(VALUE self)
+{
+    struct NIO_Operation *operation;
+    TypedData_Get_Struct(self, struct NIO_Operation, &NIO_Operation_type, operation);
+    return operation;
+}
+
+static void NIO_Operation_mark(void *data)
+{
+    struct NIO_Operation *operation = (struct NIO_Operation *)data;
+    rb_gc_mark(operation->self);
+    rb_gc_mark(operation->monitor);
+    rb_gc_mark(operation->buffer);
+    rb_gc_mark(operation->data);
+    rb_gc_mark(operation->received);
+    rb_gc_mark(operation->socket_class);
+}
+
+static void NIO_Operation_free(void *data)
+{
+    struct NIO_Operation *operation = (struct NIO_Operation *)data;
+
+    /* Connections which were never selected */
+    while (operation->sockets_count > 0) {
+        close(operation->sockets[--operation->sockets_count]);
+    }
+
+    /* Grown without the GVL */
+    free(operation->sockets);
+    xfree(operation);
+}
+
+static size_t NIO_Operation_memsize(const void *data)
+{
+    const struct NIO_Operation *operation = (const struct NIO_Operation *)data;
+    return sizeof(*operation) + operation->sockets_capacity * sizeof(int);
+}
+
+static VALUE NIO_Operation_monitor(VALUE self)
+{
+    return NIO_Operation_unwrap(self)->monitor;
+}
+
+static VALUE NIO_Operation_io(VALUE self)
+{
+    return rb_ivar_get(NIO_Operation_unwrap(self)->monitor, rb_intern("io"));
+}
+
+static VALUE NIO_Operation_buffer(VALUE self)
+{
+    return NIO_Operation_unwrap(self)->buffer;
+}
+
+static VALUE NIO_Operation_get_type(VALUE self)
+{
+    switch (NIO_Operation_unwrap(self)->type) {
+        case NIO_OPERATION_READ:
+            return ID2SYM(rb_intern("read"));
+        case NIO_OPERATION_WRITE:
+            return ID2SYM(rb_intern("write"));
+        case NIO_OPERATION_RECEIVE:
+            return ID2SYM(rb_intern("receive"));
+        case NIO_OPERATION_ACCEPT:
+            return ID2SYM(rb_intern("accept"));
+    }
+
+    return Qnil;
+}
+
+static VALUE NIO_Operation_is_completed(VALUE self)
+{
+    return NIO_Operation_unwrap(self)->completed ? Qtrue : Qfalse;
+}
+
+/* Number of bytes transferred (0 for a read at end of file), or nil if the
+   operation hasn't completed yet. Raises the error if it failed.
+
+   For receives and accepts, the number of bytes or connections in data, or
+   nil if nothing has been selected yet */
+static VALUE NIO_Operation_result(VALUE self)
+{
+    struct NIO_Operation *operation = NIO_Operation_unwrap(self);
+
+    static const char *calls[] = {"read", "write", "recv", "accept"};
+
+    if (NIO_OPERATION_MULTISHOT(operation) ? operation->data == Qnil && !operation->completed : !operation->completed) {
+        return Qnil;
+    }
+
+    if (operation->result < 0) {
+        rb_syserr_fail(-operation->result, calls[operation->type]);
+    }
+
+    return INT2NUM(operation->result);
+}
+
+/* Data received, or an array of sockets accepted, since the operation was
+   last selected. Nil for reads and writes, which transfer their buffer */
+static VALUE NIO_Operation_data(VALUE self)
+{
+    return NIO_Operation_unwrap(self)->data;
+}
+
+/* Did the kernel transmit a zero-copy write straight from the buffer? It
+   copies it anyway where the device can't, including over loopback */
+static VALUE NIO_Operation_is_zerocopy(VALUE self)
+{
+    return NIO_Operation_unwrap(self)->zerocopy == NIO_ZEROCOPY_DONE ? Qtrue : Qfalse;
+}
+
+/* The class accept would return connections as */
+VALUE NIO_Operation_socket_class(VALUE io)
+{
+    if (!rb_const_defined(rb_cObject, rb_intern("BasicSocket")) || !rb_obj_is_kind_of(io, rb_path2class("BasicSocket"))) {
+        rb_raise(rb_eTypeError, "can't accept connections from %" PRIsVALUE, rb_obj_class(io));
+    }
+
+    if (rb_const_defined(rb_cObject, rb_intern("TCPServer")) && rb_obj_is_kind_of(io, rb_path2class("TCPServer"))) {
+        return rb_path2class("TCPSocket");
+    }
+
+    if (rb_const_defined(rb_cObject, rb_intern("UNIXServer")) && rb_obj_is_kind_of(io, rb_path2class("UNIXServer"))) {
+        return rb_path2class("UNIXSocket");
+    }
+
+    return rb_path2class("Socket");
+}
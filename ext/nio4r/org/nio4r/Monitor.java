@@ -16,7 +16,7 @@ public class Monitor extends RubyObject {
     private static final long serialVersionUID = -3733782997115074794L;
     private transient SelectionKey key;
     private RubyIO io;
-    private transient IRubyObject interests, selector, value, closed;
+    private transient IRubyObject interests, selector, value, closed, mode;
 
     public Monitor(final Ruby ruby, RubyClass rubyClass) {
         super(ruby, rubyClass);
@@ -30,6 +30,7 @@ public class Monitor extends RubyObject {
 
         this.value  = context.nil;
         this.closed = context.getRuntime().getFalse();
+        this.mode   = context.getRuntime().newSymbol("level");
 
         return context.nil;
     }
@@ -106,6 +107,53 @@ public class Monitor extends RubyObject {
         return this.interests;
     }
 
+    /* Java NIO is level-triggered, so :edge monitors behave as :level ones do */
+    @JRubyMethod(name = "mode")
+    public IRubyObject getMode(ThreadContext context) {
+        return this.mode;
+    }
+
+    @JRubyMethod(name = "mode=")
+    public IRubyObject setMode(ThreadContext context, IRubyObject mode) {
+        Ruby ruby = context.getRuntime();
+
+        if(this.closed == ruby.getTrue()) {
+            throw ruby.newEOFError("monitor is closed");
+        }
+
+        if(mode != ruby.newSymbol("level") && mode != ruby.newSymbol("edge") && mode != ruby.newSymbol("oneshot")) {
+            throw ruby.newArgumentError("invalid mode " + mode.inspect() + " (must be :level, :edge, or :oneshot)");
+        }
+
+        this.mode = mode;
+        rearm(context);
+
+        return this.mode;
+    }
+
+    @JRubyMethod
+    public IRubyObject rearm(ThreadContext context) {
+        Ruby ruby = context.getRuntime();
+
+        if(this.closed == ruby.getTrue()) {
+            throw ruby.newEOFError("monitor is closed");
+        }
+
+        if(this.interests != context.nil) {
+            SelectableChannel channel = (SelectableChannel)io.getChannel();
+            key.interestOps(Nio4r.symbolToInterestOps(ruby, channel, this.interests));
+        }
+
+        return this;
+    }
+
+    /* Called by the selector whenever this monitor is selected */
+    public void disarmIfOneShot(ThreadContext context) {
+        if(this.mode == context.getRuntime().newSymbol("oneshot") && key.isValid()) {
+            key.interestOps(0);
+        }
+    }
+
     @JRubyMethod
     public IRubyObject readiness(ThreadContext context) {
         if(!key.isValid())
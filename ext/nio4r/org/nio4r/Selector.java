@@ -157,6 +157,30 @@ public class Selector extends RubyObject {
         return monitor;
     }
 
+    @JRubyMethod(name = "register_all")
+    public IRubyObject registerAll(ThreadContext context, IRubyObject ios, IRubyObject interests) {
+        RubyArray<?> array = ios.convertToArray();
+        RubyArray<?> monitors = context.runtime.newArray(array.size());
+
+        for(int i = 0; i < array.size(); i++) {
+            monitors.add(register(context, array.eltInternal(i), interests));
+        }
+
+        return monitors;
+    }
+
+    @JRubyMethod(name = "deregister_all")
+    public IRubyObject deregisterAll(ThreadContext context, IRubyObject ios) {
+        RubyArray<?> array = ios.convertToArray();
+        RubyArray<?> monitors = context.runtime.newArray(array.size());
+
+        for(int i = 0; i < array.size(); i++) {
+            monitors.add(deregister(context, array.eltInternal(i)));
+        }
+
+        return monitors;
+    }
+
     @JRubyMethod(name = "registered?")
     public IRubyObject isRegistered(ThreadContext context, IRubyObject io) {
         Ruby runtime = context.getRuntime();
@@ -211,6 +235,7 @@ public class Selector extends RubyObject {
         while(selectedKeys.hasNext()) {
             SelectionKey key = selectedKeys.next();
             processKey(key);
+            ((Monitor)key.attachment()).disarmIfOneShot(context);
 
             selectedKeys.remove();
 
@@ -228,6 +253,47 @@ public class Selector extends RubyObject {
         }
     }
 
+    @JRubyMethod(name = "select_into")
+    public synchronized IRubyObject selectInto(ThreadContext context, IRubyObject readyArray) {
+        return selectInto(context, readyArray, context.nil);
+    }
+
+    @JRubyMethod(name = "select_into")
+    public synchronized IRubyObject selectInto(ThreadContext context, IRubyObject readyArray, IRubyObject timeout) {
+        Ruby runtime = context.getRuntime();
+
+        if(!(readyArray instanceof RubyArray)) {
+            throw runtime.newTypeError(readyArray, runtime.getArray());
+        }
+
+        if(!this.selector.isOpen()) {
+            throw context.getRuntime().newIOError("selector is closed");
+        }
+
+        RubyArray<?> array = (RubyArray<?>)readyArray;
+        array.clear();
+
+        this.wakeupFired = false;
+        int ready = doSelect(runtime, context, timeout);
+
+        /* Timeout */
+        if(ready <= 0 && !this.wakeupFired) {
+            return context.nil;
+        }
+
+        Iterator<SelectionKey> selectedKeys = this.selector.selectedKeys().iterator();
+        while(selectedKeys.hasNext()) {
+            SelectionKey key = selectedKeys.next();
+            processKey(key);
+            ((Monitor)key.attachment()).disarmIfOneShot(context);
+
+            selectedKeys.remove();
+            array.add(key.attachment());
+        }
+
+        return array;
+    }
+
     /* Run the selector */
     private int doSelect(Ruby runtime, ThreadContext context, IRubyObject timeout) {
         int result;
@@ -0,0 +1,390 @@
+/*
+ * Distributed under the MIT License. See LICENSE.txt for further details.
+ */
+
+#include "nio4r.h"
+
+static VALUE mNIO = Qnil;
+static VALUE cNIO_Selector = Qnil;
+
+#ifdef HAVE_RB_FIBER_SCHEDULER_CURRENT
+/* Methods */
+static VALUE NIO_Selector_io_wait(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_Selector_kernel_sleep(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_Selector_block(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_Selector_unblock(VALUE self, VALUE blocker, VALUE fiber);
+
+/* Internal functions */
+static struct NIO_Selector *NIO_Selector_waitable(VALUE self);
+static ev_tstamp NIO_Selector_wait_timeout(VALUE timeout);
+static VALUE NIO_Selector_wait(VALUE self, struct NIO_Waiter *waiter, VALUE timeout);
+static struct NIO_Waiter *NIO_Waiter_take(struct NIO_Selector *selector);
+static VALUE NIO_Waiter_yield(VALUE arg);
+static VALUE NIO_Waiter_release(VALUE arg);
+static void NIO_Waiter_io_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents);
+static void NIO_Waiter_timer_callback(struct ev_loop *ev_loop, struct ev_timer *timer, int revents);
+#endif
+
+static void NIO_Waiter_ready(struct NIO_Waiter *waiter, VALUE result);
+static void NIO_Waiter_dequeue(struct NIO_Waiter *waiter);
+
+/* What a Fiber::Scheduler needs from a selector: fibers wait for IO, time and
+   each other without registering monitors, and are resumed by #select */
+void Init_NIO_Selector_Scheduler()
+{
+    mNIO = rb_define_module("NIO");
+    cNIO_Selector = rb_define_class_under(mNIO, "Selector", rb_cObject);
+
+#ifdef HAVE_RB_FIBER_SCHEDULER_CURRENT
+    rb_define_method(cNIO_Selector, "io_wait", NIO_Selector_io_wait, -1);
+    rb_define_method(cNIO_Selector, "kernel_sleep", NIO_Selector_kernel_sleep, -1);
+    rb_define_method(cNIO_Selector, "block", NIO_Selector_block, -1);
+    rb_define_method(cNIO_Selector, "unblock", NIO_Selector_unblock, 2);
+#endif
+}
+
+#ifdef HAVE_RB_FIBER_SCHEDULER_CURRENT
+/* Suspend the current fiber until the IO is ready for any of the given events
+   (IO::READABLE, IO::PRIORITY and IO::WRITABLE) or the timeout passes. Called
+   from a fiber which was resumed, this yields to the fiber which resumed it,
+   and returns the events which are ready, or false after the timeout, when the
+   fiber is resumed by #select */
+static VALUE NIO_Selector_io_wait(int argc, VALUE *argv, VALUE self)
+{
+    struct NIO_Selector *selector = NIO_Selector_waitable(self);
+    struct NIO_Waiter *waiter;
+    VALUE io, events, timeout;
+    int fd, interests, ev_events = 0;
+
+    rb_scan_args(argc, argv, "21", &io, &events, &timeout);
+
+    io = rb_convert_type(io, T_FILE, "IO", "to_io");
+    fd = rb_io_descriptor(io);
+    interests = NUM2INT(events);
+
+    if (interests & (RUBY_IO_READABLE | RUBY_IO_PRIORITY)) {
+        ev_events |= EV_READ;
+    }
+
+    if (interests & RUBY_IO_WRITABLE) {
+        ev_events |= EV_WRITE;
+    }
+
+    if (!ev_events) {
+        rb_raise(rb_eArgError, "no events to wait for");
+    }
+
+    NIO_Selector_wait_timeout(timeout);
+
+    waiter = NIO_Waiter_take(selector);
+    waiter->events = interests;
+    ev_io_set(&waiter->ev_io, fd, ev_events);
+    ev_io_start(selector->ev_loop, &waiter->ev_io);
+
+    return NIO_Selector_wait(self, waiter, timeout);
+}
+
+/* Suspend the current fiber for the given number of seconds, or until it's
+   unblocked if that's nil. Returns false if the time ran out */
+static VALUE NIO_Selector_kernel_sleep(int argc, VALUE *argv, VALUE self)
+{
+    struct NIO_Selector *selector = NIO_Selector_waitable(self);
+    VALUE duration;
+
+    rb_scan_args(argc, argv, "01", &duration);
+    NIO_Selector_wait_timeout(duration);
+
+    return NIO_Selector_wait(self, NIO_Waiter_take(selector), duration);
+}
+
+/* Suspend the current fiber until it's unblocked, returning true, or until
+   the timeout passes, returning false */
+static VALUE NIO_Selector_block(int argc, VALUE *argv, VALUE self)
+{
+    struct NIO_Selector *selector = NIO_Selector_waitable(self);
+    VALUE blocker, timeout;
+
+    rb_scan_args(argc, argv, "11", &blocker, &timeout);
+    NIO_Selector_wait_timeout(timeout);
+
+    return NIO_Selector_wait(self, NIO_Waiter_take(selector), timeout);
+}
+
+/* Resume a fiber waiting on this selector with true the next time it's
+   selected. Safe to call from other threads, and wakes the selector up */
+static VALUE NIO_Selector_unblock(VALUE self, VALUE blocker, VALUE fiber)
+{
+    struct NIO_Selector *selector = NIO_Selector_unwrap(self);
+
+    if (selector->closed) {
+        return Qnil;
+    }
+
+    if (selector->unblocked == Qnil) {
+        RB_OBJ_WRITE(self, &selector->unblocked, rb_ary_new());
+    }
+
+    rb_ary_push(selector->unblocked, fiber);
+    return rb_funcall(self, rb_intern("wakeup"), 0);
+}
+
+static struct NIO_Selector *NIO_Selector_waitable(VALUE self)
+{
+    struct NIO_Selector *selector = NIO_Selector_unwrap(self);
+
+    if (selector->closed) {
+        rb_raise(rb_eIOError, "selector is closed");
+    }
+
+    return selector;
+}
+
+static ev_tstamp NIO_Selector_wait_timeout(VALUE timeout)
+{
+    ev_tstamp value;
+
+    if (timeout == Qnil) {
+        return 0;
+    }
+
+    value = NUM2DBL(timeout);
+    if (value < 0) {
+        rb_raise(rb_eArgError, "time interval must be positive");
+    }
+
+    return value;
+}
+
+/* Start the waiter's timer, if it has a timeout, and yield until #select
+   resumes the fiber. However the fiber is resumed, the waiter is stopped and
+   kept for the next wait */
+static VALUE NIO_Selector_wait(VALUE self, struct NIO_Waiter *waiter, VALUE timeout)
+{
+    struct NIO_Selector *selector = waiter->selector;
+
+    if (timeout != Qnil) {
+        /* The loop's time is from when it last ran, which may be a while ago */
+        if (!selector->selecting) {
+            ev_now_update(selector->ev_loop);
+        }
+
+        ev_timer_set(&waiter->ev_timer, NIO_Selector_wait_timeout(timeout), 0.);
+        ev_timer_start(selector->ev_loop, &waiter->ev_timer);
+    }
+
+    RB_OBJ_WRITE(self, &waiter->fiber, rb_fiber_current());
+
+    waiter->prev = 0;
+    waiter->next = selector->waiters;
+    if (selector->waiters) {
+        selector->waiters->prev = waiter;
+    }
+    selector->waiters = waiter;
+
+    return rb_ensure(NIO_Waiter_yield, (VALUE)waiter, NIO_Waiter_release, (VALUE)waiter);
+}
+
+static struct NIO_Waiter *NIO_Waiter_take(struct NIO_Selector *selector)
+{
+    struct NIO_Waiter *waiter = selector->spare_waiters;
+
+    if (waiter) {
+        selector->spare_waiters = waiter->queue_next;
+    } else {
+        waiter = ALLOC(struct NIO_Waiter);
+        ev_init(&waiter->ev_io, NIO_Waiter_io_callback);
+        ev_init(&waiter->ev_timer, NIO_Waiter_timer_callback);
+        waiter->ev_io.data = waiter->ev_timer.data = (void *)waiter;
+    }
+
+    waiter->fiber = Qnil;
+    waiter->result = Qfalse;
+    waiter->events = 0;
+    waiter->resumable = 0;
+    waiter->selector = selector;
+    waiter->prev = waiter->next = waiter->queue_next = 0;
+
+    return waiter;
+}
+
+static VALUE NIO_Waiter_yield(VALUE arg)
+{
+    return rb_fiber_yield(0, NULL);
+}
+
+static VALUE NIO_Waiter_release(VALUE arg)
+{
+    struct NIO_Waiter *waiter = (struct NIO_Waiter *)arg;
+    struct NIO_Selector *selector = waiter->selector;
+
+    if (selector->ev_loop) {
+        ev_io_stop(selector->ev_loop, &waiter->ev_io);
+        ev_timer_stop(selector->ev_loop, &waiter->ev_timer);
+    }
+
+    if (waiter->prev) {
+        waiter->prev->next = waiter->next;
+    } else {
+        selector->waiters = waiter->next;
+    }
+
+    if (waiter->next) {
+        waiter->next->prev = waiter->prev;
+    }
+
+    waiter->prev = waiter->next = 0;
+    waiter->fiber = Qnil;
+
+    /* The fiber was resumed by something else while it was queued */
+    if (waiter->resumable) {
+        NIO_Waiter_dequeue(waiter);
+    }
+
+    waiter->queue_next = selector->spare_waiters;
+    selector->spare_waiters = waiter;
+
+    return Qnil;
+}
+
+static void NIO_Waiter_io_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents)
+{
+    struct NIO_Waiter *waiter = (struct NIO_Waiter *)io->data;
+    int events = 0;
+
+    if (revents & EV_READ) {
+        events |= waiter->events & (RUBY_IO_READABLE | RUBY_IO_PRIORITY);
+    }
+
+    if (revents & EV_WRITE) {
+        events |= waiter->events & RUBY_IO_WRITABLE;
+    }
+
+    waiter->selector->ready_count++;
+    NIO_Waiter_ready(waiter, INT2FIX(events));
+}
+
+static void NIO_Waiter_timer_callback(struct ev_loop *ev_loop, struct ev_timer *timer, int revents)
+{
+    struct NIO_Waiter *waiter = (struct NIO_Waiter *)timer->data;
+
+    waiter->selector->ready_count++;
+    NIO_Waiter_ready(waiter, Qfalse);
+}
+#endif
+
+/* Stop waiting and queue the fiber to be resumed with the result. Fibers
+   aren't resumed from inside libev callbacks, where they could reenter the
+   loop, but as soon as it returns */
+static void NIO_Waiter_ready(struct NIO_Waiter *waiter, VALUE result)
+{
+    struct NIO_Selector *selector = waiter->selector;
+
+    ev_io_stop(selector->ev_loop, &waiter->ev_io);
+    ev_timer_stop(selector->ev_loop, &waiter->ev_timer);
+
+    waiter->result = result;
+    waiter->resumable = 1;
+    waiter->queue_next = 0;
+
+    if (selector->resumable_tail) {
+        selector->resumable_tail->queue_next = waiter;
+    } else {
+        selector->resumable = waiter;
+    }
+    selector->resumable_tail = waiter;
+}
+
+/* Take a waiter off the queue of those to be resumed */
+static void NIO_Waiter_dequeue(struct NIO_Waiter *waiter)
+{
+    struct NIO_Selector *selector = waiter->selector;
+    struct NIO_Waiter **link = &selector->resumable, *previous = 0;
+
+    while (*link != waiter) {
+        previous = *link;
+        link = &previous->queue_next;
+    }
+
+    *link = waiter->queue_next;
+    if (selector->resumable_tail == waiter) {
+        selector->resumable_tail = previous;
+    }
+
+    waiter->resumable = 0;
+    waiter->queue_next = 0;
+}
+
+int NIO_Selector_resume_waiters(struct NIO_Selector *selector)
+{
+    struct NIO_Waiter *waiter;
+    VALUE fiber, result;
+    long i;
+    int resumed = 0;
+
+    /* Unblocked fibers are matched up with what they're waiting on here, on
+       the selector's thread */
+    if (selector->unblocked != Qnil && RARRAY_LEN(selector->unblocked) > 0) {
+        for (i = 0; i < RARRAY_LEN(selector->unblocked); i++) {
+            fiber = RARRAY_AREF(selector->unblocked, i);
+
+            for (waiter = selector->waiters; waiter; waiter = waiter->next) {
+                if (waiter->fiber == fiber && !waiter->resumable) {
+                    NIO_Waiter_ready(waiter, Qtrue);
+                    break;
+                }
+            }
+        }
+
+        rb_ary_clear(selector->unblocked);
+    }
+
+    /* Each waiter leaves the queue before its fiber runs, so if the fiber
+       raises, the rest are still queued for the next select */
+    while ((waiter = selector->resumable)) {
+        NIO_Waiter_dequeue(waiter);
+
+        result = waiter->result;
+        resumed++;
+        rb_fiber_resume(waiter->fiber, 1, &result);
+    }
+
+    return resumed;
+}
+
+/* Fibers still waiting when their selector is closed are never resumed by it */
+void NIO_Selector_stop_waiters(struct NIO_Selector *selector)
+{
+    struct NIO_Waiter *waiter;
+
+    if (!selector->ev_loop) {
+        return;
+    }
+
+    for (waiter = selector->waiters; waiter; waiter = waiter->next) {
+        ev_io_stop(selector->ev_loop, &waiter->ev_io);
+        ev_timer_stop(selector->ev_loop, &waiter->ev_timer);
+    }
+
+    if (selector->unblocked != Qnil) {
+        rb_ary_clear(selector->unblocked);
+    }
+}
+
+void NIO_Selector_free_waiters(struct NIO_Selector *selector)
+{
+    struct NIO_Waiter *waiter;
+
+    /* Every waiter is either still waiting or spare. The queue of those to
+       be resumed only ever holds waiting ones */
+    selector->resumable = selector->resumable_tail = 0;
+
+    while ((waiter = selector->waiters)) {
+        selector->waiters = waiter->next;
+        xfree(waiter);
+    }
+
+    while ((waiter = selector->spare_waiters)) {
+        selector->spare_waiters = waiter->queue_next;
+        xfree(waiter);
+    }
+}
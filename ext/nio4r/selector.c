@@ -3,7 +3,13 @@
  * LICENSE.txt for further details.
  */
 
+/* For accept4 */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+
 #include "nio4r.h"
+#include "ruby/encoding.h"
 #ifdef HAVE_RUBYSIG_H
 #include "rubysig.h"
 #endif
@@ -15,7 +21,55 @@
 #endif
 
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <stdint.h>
+#include <sys/eventfd.h>
+#endif
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#ifdef HAVE_TYPE_STRUCT_IO_URING_BUF_REG
+#include <linux/io_uring.h>
+#endif
+
+/* MSG_ZEROCOPY completions arrive on the socket's error queue, which we wait
+   for with an epoll instance of our own, whatever the backend */
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_LINUX_ERRQUEUE_H) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <sys/epoll.h>
+#define NIO_ZEROCOPY
+#endif
+
+/* Compatibility for Ruby <= 3.1 */
+#ifndef HAVE_RB_IO_DESCRIPTOR
+static int
+io_descriptor_fallback(VALUE io)
+{
+    rb_io_t *fptr;
+    GetOpenFile(io, fptr);
+    return fptr->fd;
+}
+#define rb_io_descriptor io_descriptor_fallback
+#endif
+
+/* Compatibility for Ruby <= 3.2 */
+#ifndef HAVE_RB_IO_CLOSED_P
+static VALUE
+io_closed_p_fallback(VALUE io)
+{
+    return rb_funcall(io, rb_intern("closed?"), 0);
+}
+#define rb_io_closed_p io_closed_p_fallback
+#endif
 
 static VALUE mNIO = Qnil;
 static VALUE cNIO_Monitor = Qnil;
@@ -36,29 +90,93 @@ static VALUE NIO_Selector_initialize(int argc, VALUE *argv, VALUE self);
 static VALUE NIO_Selector_backend(VALUE self);
 static VALUE NIO_Selector_register(VALUE self, VALUE selectable, VALUE interest);
 static VALUE NIO_Selector_deregister(VALUE self, VALUE io);
+static VALUE NIO_Selector_register_all(VALUE self, VALUE ios, VALUE interests);
+static VALUE NIO_Selector_deregister_all(VALUE self, VALUE ios);
 static VALUE NIO_Selector_is_registered(VALUE self, VALUE io);
 static VALUE NIO_Selector_select(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_Selector_select_into(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_Selector_select_raw(int argc, VALUE *argv, VALUE self);
 static VALUE NIO_Selector_wakeup(VALUE self);
 static VALUE NIO_Selector_close(VALUE self);
 static VALUE NIO_Selector_closed(VALUE self);
 static VALUE NIO_Selector_is_empty(VALUE self);
+static VALUE NIO_Selector_register_buffers(VALUE self, VALUE buffers);
+static VALUE NIO_Selector_buffer_pool(VALUE self);
+static VALUE NIO_Selector_accept_loop(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_Selector_read_ready(VALUE self, VALUE monitors);
+static VALUE NIO_Selector_add_timer(int argc, VALUE *argv, VALUE self);
+static VALUE NIO_Selector_get_dispatch(VALUE self);
+static VALUE NIO_Selector_set_dispatch(VALUE self, VALUE dispatch);
 
 /* Internal functions */
-static VALUE NIO_Selector_synchronize(VALUE self, VALUE (*func)(VALUE arg), VALUE arg);
+static VALUE NIO_Selector_lock(VALUE self);
+static VALUE NIO_Selector_scheduled(VALUE self);
 static VALUE NIO_Selector_unlock(VALUE lock);
 static VALUE NIO_Selector_register_synchronized(VALUE arg);
 static VALUE NIO_Selector_deregister_synchronized(VALUE arg);
+static VALUE NIO_Selector_deregister_monitor_synchronized(VALUE arg);
+static VALUE NIO_Selector_register_all_synchronized(VALUE arg);
+static VALUE NIO_Selector_register_each(VALUE arg);
+static VALUE NIO_Selector_deregister_all_synchronized(VALUE arg);
 static VALUE NIO_Selector_select_synchronized(VALUE arg);
+static VALUE NIO_Selector_select_raw_synchronized(VALUE arg);
 static VALUE NIO_Selector_close_synchronized(VALUE arg);
 static VALUE NIO_Selector_closed_synchronized(VALUE arg);
+static VALUE NIO_Selector_register_buffers_synchronized(VALUE arg);
+static struct NIO_Monitor *NIO_Selector_slot(struct NIO_Selector *selector, VALUE io);
+static struct NIO_Monitor *NIO_Selector_lookup(struct NIO_Selector *selector, VALUE io);
+static void NIO_Selector_insert(VALUE self, struct NIO_Selector *selector, struct NIO_Monitor *monitor);
+static void NIO_Selector_remove(struct NIO_Selector *selector, struct NIO_Monitor *monitor);
+static VALUE NIO_Selector_submit_synchronized(VALUE arg);
+static void NIO_Selector_start(struct NIO_Selector *selector, struct NIO_Operation *operation);
+static void NIO_Selector_unlink(struct NIO_Operation *operation);
+static void NIO_Selector_enqueue(struct NIO_Operation *operation);
+static void NIO_Selector_complete(struct NIO_Operation *operation, int result);
+static void NIO_Selector_cancel(struct NIO_Selector *selector, struct NIO_Operation *operation);
+static void NIO_Selector_unpin(struct NIO_Operation *operation);
+static void NIO_Selector_deliver(struct NIO_Selector *selector);
+static void NIO_Selector_report(struct NIO_Selector *selector, VALUE object, int fd, int revents);
+static void NIO_Selector_dispatch_ready(struct NIO_Selector *selector);
+static enum NIO_Selector_dispatch NIO_Selector_dispatch_mode(VALUE dispatch);
+static int NIO_Selector_fixed_index(struct NIO_Selector *selector, VALUE buffer);
+static void NIO_Selector_pin_fixed_buffers(struct NIO_Selector *selector, int pin);
+static int NIO_BufferPool_open(struct NIO_Selector *selector);
+static void NIO_BufferPool_close(struct NIO_BufferPool *pool);
+static void NIO_BufferPool_recycle(struct NIO_BufferPool *pool, int id);
+static VALUE NIO_BufferPool_collect(struct NIO_BufferPool *pool, struct NIO_Operation *operation, VALUE data);
+static int NIO_Selector_accepted(struct NIO_Operation *operation, int fd);
+static VALUE NIO_Selector_collect_sockets(struct NIO_Operation *operation);
+static int NIO_Selector_zerocopy_enable(struct NIO_Selector *selector, struct NIO_Monitor *monitor);
+static ssize_t NIO_Selector_zerocopy_send(struct NIO_Operation *operation, int fd, char *data);
+static void NIO_Selector_zerocopy_release(struct NIO_Selector *selector, struct NIO_Monitor *monitor, unsigned int lo, unsigned int hi, enum NIO_Zerocopy_state state);
 
 static int NIO_Selector_run(struct NIO_Selector *selector, VALUE timeout);
 static void NIO_Selector_timeout_callback(struct ev_loop *ev_loop, struct ev_timer *timer, int revents);
 static void NIO_Selector_wakeup_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents);
+static void NIO_Selector_wakeup_open(int fds[2]);
+static void NIO_Selector_operation_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents);
+static void NIO_Selector_receive_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents);
+static void NIO_Selector_accept_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents);
+static void NIO_Selector_iouring_callback(struct ev_loop *ev_loop, struct ev_iouring_op *iouring, int result, unsigned int flags);
+static void NIO_Selector_iouring_receive_callback(struct ev_loop *ev_loop, struct ev_iouring_op *iouring, int result, unsigned int flags);
+static void NIO_Selector_iouring_accept_callback(struct ev_loop *ev_loop, struct ev_iouring_op *iouring, int result, unsigned int flags);
+#ifdef NIO_ZEROCOPY
+static void NIO_Selector_zerocopy_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents);
+#endif
 
 /* Default number of slots in the buffer for selected monitors */
 #define INITIAL_READY_BUFFER 32
 
+/* Minimum number of slots in the descriptor-indexed monitor table */
+#define INITIAL_MONITORS_CAPACITY 64
+
+/* Default size of the pool multishot receives borrow buffers from */
+#define DEFAULT_BUFFER_COUNT 128
+#define DEFAULT_BUFFER_SIZE 16384
+
+/* Provided buffer rings can't be larger than this */
+#define MAX_BUFFER_COUNT 32768
+
 /* Ruby 1.8 needs us to busy wait and run the green threads scheduler every 10ms */
 #define BUSYWAIT_INTERVAL 0.01
 
@@ -75,11 +193,22 @@ void Init_NIO_Selector(void)
     rb_define_method(cNIO_Selector, "register", NIO_Selector_register, 2);
     rb_define_method(cNIO_Selector, "deregister", NIO_Selector_deregister, 1);
     rb_define_method(cNIO_Selector, "registered?", NIO_Selector_is_registered, 1);
+    rb_define_method(cNIO_Selector, "register_all", NIO_Selector_register_all, 2);
+    rb_define_method(cNIO_Selector, "deregister_all", NIO_Selector_deregister_all, 1);
     rb_define_method(cNIO_Selector, "select", NIO_Selector_select, -1);
+    rb_define_method(cNIO_Selector, "select_into", NIO_Selector_select_into, -1);
+    rb_define_method(cNIO_Selector, "select_raw", NIO_Selector_select_raw, -1);
     rb_define_method(cNIO_Selector, "wakeup", NIO_Selector_wakeup, 0);
     rb_define_method(cNIO_Selector, "close", NIO_Selector_close, 0);
     rb_define_method(cNIO_Selector, "closed?", NIO_Selector_closed, 0);
     rb_define_method(cNIO_Selector, "empty?", NIO_Selector_is_empty, 0);
+    rb_define_method(cNIO_Selector, "register_buffers", NIO_Selector_register_buffers, 1);
+    rb_define_method(cNIO_Selector, "buffer_pool", NIO_Selector_buffer_pool, 0);
+    rb_define_method(cNIO_Selector, "accept_loop", NIO_Selector_accept_loop, -1);
+    rb_define_method(cNIO_Selector, "read_ready", NIO_Selector_read_ready, 1);
+    rb_define_method(cNIO_Selector, "add_timer", NIO_Selector_add_timer, -1);
+    rb_define_method(cNIO_Selector, "dispatch", NIO_Selector_get_dispatch, 0);
+    rb_define_method(cNIO_Selector, "dispatch=", NIO_Selector_set_dispatch, 1);
 
     cNIO_Monitor = rb_define_class_under(mNIO, "Monitor", rb_cObject);
 }
@@ -102,22 +231,11 @@ static VALUE NIO_Selector_allocate(VALUE klass)
     struct NIO_Selector *selector;
     int fds[2];
 
-    /* Use a pipe to implement the wakeup mechanism. I know libev provides
-       async watchers that implement this same behavior, but I'm getting
-       segvs trying to use that between threads, despite claims of thread
-       safety. Pipes are nice and safe to use between threads.
-
-       Note that Java NIO uses this same mechanism */
-    if (pipe(fds) < 0) {
-        rb_sys_fail("pipe");
-    }
-
-    /* Use non-blocking reads/writes during wakeup, in case the buffer is full */
-    if (fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0 || fcntl(fds[1], F_SETFL, O_NONBLOCK) < 0) {
-        rb_sys_fail("fcntl");
-    }
+    NIO_Selector_wakeup_open(fds);
 
     VALUE obj = TypedData_Make_Struct(klass, struct NIO_Selector, &NIO_Selector_type, selector);
+    selector->self = obj;
+
     /* Defer initializing the loop to #initialize */
     selector->ev_loop = 0;
 
@@ -129,11 +247,59 @@ static VALUE NIO_Selector_allocate(VALUE klass)
     ev_io_init(&selector->wakeup, NIO_Selector_wakeup_callback, selector->wakeup_reader, EV_READ);
     selector->wakeup.data = (void *)selector;
 
-    selector->closed = selector->selecting = selector->wakeup_fired = selector->ready_count = 0;
+    selector->closed = selector->selecting = selector->wakeup_fired = selector->wakeup_pending = selector->ready_count = 0;
+    selector->last_ready_count = 0;
     RB_OBJ_WRITE(obj, &selector->ready_array, Qnil);
+    RB_OBJ_WRITE(obj, &selector->lock, rb_mutex_new());
+    RB_OBJ_WRITE(obj, &selector->lock_holder, Qnil);
+    RB_OBJ_WRITE(obj, &selector->fixed_buffers, Qnil);
+
+    selector->buffer_pool.count = DEFAULT_BUFFER_COUNT;
+    selector->buffer_pool.size = DEFAULT_BUFFER_SIZE;
+    selector->zerocopy_epoll = -1;
+    selector->timers = 0;
+    selector->waiters = selector->resumable = selector->resumable_tail = selector->spare_waiters = 0;
+    RB_OBJ_WRITE(obj, &selector->unblocked, Qnil);
+    RB_OBJ_WRITE(obj, &selector->raw_events, Qnil);
+
+    selector->dispatch = NIO_DISPATCH_INLINE;
+    selector->deferring = 0;
+    selector->ready_events = 0;
+    selector->ready_events_count = selector->ready_events_capacity = 0;
     return obj;
 }
 
+/* Open the descriptors used to wake the selector up from other threads */
+static void NIO_Selector_wakeup_open(int fds[2])
+{
+#ifdef HAVE_SYS_EVENTFD_H
+    /* On Linux an eventfd gives us the same behavior as the pipe below with
+       a single descriptor: writes increment a counter and one 8-byte read
+       resets it, so there's no need to drain anything */
+    fds[0] = fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fds[0] >= 0) {
+        return;
+    }
+#endif
+
+    /* Use a pipe to implement the wakeup mechanism. I know libev provides
+       async watchers that implement this same behavior, but I'm getting
+       segvs trying to use that between threads, despite claims of thread
+       safety. Pipes are nice and safe to use between threads.
+
+       Note that Java NIO uses this same mechanism */
+    if (pipe(fds) < 0) {
+        rb_sys_fail("pipe");
+    }
+
+    /* Use non-blocking reads/writes during wakeup, in case the buffer is full */
+    if (fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0 || fcntl(fds[1], F_SETFL, O_NONBLOCK) < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        rb_sys_fail("fcntl");
+    }
+}
+
 struct NIO_Selector *NIO_Selector_unwrap(VALUE self)
 {
     struct NIO_Selector *selector;
@@ -141,13 +307,49 @@ struct NIO_Selector *NIO_Selector_unwrap(VALUE self)
     return selector;
 }
 
-/* NIO selectors store all Ruby objects in instance variables so mark is a stub */
 static void NIO_Selector_mark(void *data)
 {
+    struct NIO_Operation *operation;
+    struct NIO_Timer *timer;
+    struct NIO_Waiter *waiter;
     struct NIO_Selector *selector = (struct NIO_Selector *)data;
     if (selector->ready_array != Qnil) {
         rb_gc_mark(selector->ready_array);
     }
+
+    rb_gc_mark(selector->lock);
+    rb_gc_mark(selector->lock_holder);
+    rb_gc_mark(selector->fixed_buffers);
+
+    for (int fd = 0; fd < selector->monitors_capacity; fd++) {
+        if (selector->monitors[fd]) {
+            rb_gc_mark(selector->monitors[fd]->self);
+        }
+    }
+
+    /* Operations keep their buffers alive while the kernel may write to them */
+    for (operation = selector->operations; operation; operation = operation->next) {
+        rb_gc_mark(operation->self);
+    }
+
+    for (operation = selector->completed; operation; operation = operation->queue_next) {
+        rb_gc_mark(operation->self);
+    }
+
+    for (timer = selector->timers; timer; timer = timer->next) {
+        rb_gc_mark(timer->self);
+    }
+
+    for (waiter = selector->waiters; waiter; waiter = waiter->next) {
+        rb_gc_mark(waiter->fiber);
+    }
+
+    rb_gc_mark(selector->unblocked);
+    rb_gc_mark(selector->raw_events);
+
+    for (int i = 0; i < selector->ready_events_count; i++) {
+        rb_gc_mark(selector->ready_events[i].object);
+    }
 }
 
 /* Free a Selector's system resources.
@@ -159,13 +361,23 @@ static void NIO_Selector_shutdown(struct NIO_Selector *selector)
     }
 
     close(selector->wakeup_reader);
-    close(selector->wakeup_writer);
+    if (selector->wakeup_writer != selector->wakeup_reader) {
+        close(selector->wakeup_writer);
+    }
 
     if (selector->ev_loop) {
         ev_loop_destroy(selector->ev_loop);
         selector->ev_loop = 0;
     }
 
+    /* Only once the kernel is done with them */
+    NIO_BufferPool_close(&selector->buffer_pool);
+
+    if (selector->zerocopy_epoll >= 0) {
+        close(selector->zerocopy_epoll);
+        selector->zerocopy_epoll = -1;
+    }
+
     selector->closed = 1;
 }
 
@@ -174,12 +386,36 @@ static void NIO_Selector_free(void *data)
 {
     struct NIO_Selector *selector = (struct NIO_Selector *)data;
     NIO_Selector_shutdown(selector);
+
+    if (selector->monitors) {
+        xfree(selector->monitors);
+    }
+
+    if (selector->ready_events) {
+        xfree(selector->ready_events);
+    }
+
+    NIO_Selector_free_waiters(selector);
     xfree(selector);
 }
 
 static size_t NIO_Selector_memsize(const void *data)
 {
-    return sizeof(struct NIO_Selector);
+    const struct NIO_Selector *selector = (const struct NIO_Selector *)data;
+    const struct NIO_BufferPool *pool = &selector->buffer_pool;
+    size_t size = sizeof(struct NIO_Selector) + selector->monitors_capacity * sizeof(struct NIO_Monitor *);
+
+    size += selector->ready_events_capacity * sizeof(struct NIO_Ready);
+
+    if (pool->ring) {
+        size += (size_t)pool->count * (pool->size + 2 * sizeof(int));
+    }
+
+    if (pool->scratch) {
+        size += pool->size;
+    }
+
+    return size;
 }
 
 /* Return an array of symbols for supported backends */
@@ -224,15 +460,45 @@ static VALUE NIO_Selector_supported_backends(VALUE klass)
 static VALUE NIO_Selector_initialize(int argc, VALUE *argv, VALUE self)
 {
     ID backend_id;
-    VALUE backend;
-    VALUE lock;
+    VALUE backend, options;
+    ID option_ids[3];
+    VALUE option_values[3];
 
     struct NIO_Selector *selector;
     unsigned int flags = 0;
 
     TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
 
-    rb_scan_args(argc, argv, "01", &backend);
+    rb_scan_args(argc, argv, "01:", &backend, &options);
+
+    if (options != Qnil) {
+        option_ids[0] = rb_intern("buffer_count");
+        option_ids[1] = rb_intern("buffer_size");
+        option_ids[2] = rb_intern("dispatch");
+        rb_get_kwargs(options, option_ids, 0, 3, option_values);
+
+        if (option_values[0] != Qundef) {
+            int count = NUM2INT(option_values[0]);
+            if (count < 1 || count > MAX_BUFFER_COUNT || (count & (count - 1))) {
+                rb_raise(rb_eArgError, "buffer_count must be a power of 2 no greater than %d", MAX_BUFFER_COUNT);
+            }
+
+            selector->buffer_pool.count = count;
+        }
+
+        if (option_values[1] != Qundef) {
+            int size = NUM2INT(option_values[1]);
+            if (size < 1) {
+                rb_raise(rb_eArgError, "buffer_size must be positive");
+            }
+
+            selector->buffer_pool.size = size;
+        }
+
+        if (option_values[2] != Qundef) {
+            selector->dispatch = NIO_Selector_dispatch_mode(option_values[2]);
+        }
+    }
 
     if (backend != Qnil) {
         if (!rb_ary_includes(NIO_Selector_supported_backends(CLASS_OF(self)), backend)) {
@@ -270,13 +536,6 @@ static VALUE NIO_Selector_initialize(int argc, VALUE *argv, VALUE self)
 
     ev_io_start(selector->ev_loop, &selector->wakeup);
 
-    rb_ivar_set(self, rb_intern("selectables"), rb_hash_new());
-    rb_ivar_set(self, rb_intern("lock_holder"), Qnil);
-
-    lock = rb_class_new_instance(0, 0, rb_const_get(rb_cObject, rb_intern("Mutex")));
-    rb_ivar_set(self, rb_intern("lock"), lock);
-    rb_ivar_set(self, rb_intern("lock_holder"), Qnil);
-
     return Qnil;
 }
 
@@ -310,17 +569,20 @@ static VALUE NIO_Selector_backend(VALUE self)
 }
 
 /* Synchronize around a reentrant selector lock */
-static VALUE NIO_Selector_synchronize(VALUE self, VALUE (*func)(VALUE arg), VALUE arg)
+VALUE NIO_Selector_synchronize(VALUE self, VALUE (*func)(VALUE arg), VALUE arg)
 {
-    VALUE current_thread, lock_holder, lock;
+    struct NIO_Selector *selector;
 
-    current_thread = rb_thread_current();
-    lock_holder = rb_ivar_get(self, rb_intern("lock_holder"));
+    TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
+
+    if (selector->lock_holder != rb_thread_current()) {
+        /* Let threads scheduling timers have the lock first, or selecting in
+           a loop would take it straight back from them */
+        while (selector->scheduling && rb_mutex_locked_p(selector->lock) == Qfalse) {
+            rb_thread_schedule();
+        }
 
-    if (lock_holder != current_thread) {
-        lock = rb_ivar_get(self, rb_intern("lock"));
-        rb_funcall(lock, rb_intern("lock"), 0);
-        rb_ivar_set(self, rb_intern("lock_holder"), current_thread);
+        NIO_Selector_lock(self);
 
         /* We've acquired the lock, so ensure we unlock it */
         return rb_ensure(func, (VALUE)arg, NIO_Selector_unlock, self);
@@ -330,15 +592,68 @@ static VALUE NIO_Selector_synchronize(VALUE self, VALUE (*func)(VALUE arg), VALU
     }
 }
 
+/* Another thread holding the lock may be blocked in select, which only takes
+   a timer into account once it's been woken up and let go of the lock. Unless
+   it's already due back before the deadline, wake it up first, rather than
+   waiting for it */
+VALUE NIO_Selector_synchronize_timer(VALUE self, ev_tstamp deadline, VALUE (*func)(VALUE arg), VALUE arg)
+{
+    struct NIO_Selector *selector;
+    VALUE lock_holder;
+
+    TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
+    lock_holder = selector->lock_holder;
+
+    if (lock_holder == rb_thread_current()) {
+        return func(arg);
+    }
+
+    if (!selector->closed && lock_holder != Qnil) {
+        if (!selector->selecting || !selector->wait_deadline || deadline < selector->wait_deadline) {
+            NIO_Selector_wakeup(self);
+        }
+    }
+
+    selector->scheduling++;
+    rb_ensure(NIO_Selector_lock, self, NIO_Selector_scheduled, self);
+
+    return rb_ensure(func, (VALUE)arg, NIO_Selector_unlock, self);
+}
+
+/* Lock the selector mutex. Uncontended locking doesn't block. Otherwise this
+   waits without the GVL and remains interruptible, like Mutex#lock */
+static VALUE NIO_Selector_lock(VALUE self)
+{
+    struct NIO_Selector *selector;
+
+    TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
+
+    rb_mutex_lock(selector->lock);
+    RB_OBJ_WRITE(self, &selector->lock_holder, rb_thread_current());
+
+    return Qnil;
+}
+
+/* A thread scheduling a timer is done waiting for the lock */
+static VALUE NIO_Selector_scheduled(VALUE self)
+{
+    struct NIO_Selector *selector;
+
+    TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
+    selector->scheduling--;
+
+    return Qnil;
+}
+
 /* Unlock the selector mutex */
 static VALUE NIO_Selector_unlock(VALUE self)
 {
-    VALUE lock;
+    struct NIO_Selector *selector;
 
-    rb_ivar_set(self, rb_intern("lock_holder"), Qnil);
+    TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
 
-    lock = rb_ivar_get(self, rb_intern("lock"));
-    rb_funcall(lock, rb_intern("unlock"), 0);
+    RB_OBJ_WRITE(self, &selector->lock_holder, Qnil);
+    rb_mutex_unlock(selector->lock);
 
     return Qnil;
 }
@@ -353,9 +668,10 @@ static VALUE NIO_Selector_register(VALUE self, VALUE io, VALUE interests)
 /* Internal implementation of register after acquiring mutex */
 static VALUE NIO_Selector_register_synchronized(VALUE _args)
 {
-    VALUE self, io, interests, selectables, monitor;
+    VALUE self, io, interests, monitor;
     VALUE monitor_args[3];
     struct NIO_Selector *selector;
+    struct NIO_Monitor *existing;
 
     VALUE *args = (VALUE *)_args;
     self = args[0];
@@ -367,11 +683,21 @@ static VALUE NIO_Selector_register_synchronized(VALUE _args)
         rb_raise(rb_eIOError, "selector is closed");
     }
 
-    selectables = rb_ivar_get(self, rb_intern("selectables"));
-    monitor = rb_hash_lookup(selectables, io);
+    existing = NIO_Selector_slot(selector, io);
 
-    if (monitor != Qnil)
-        rb_raise(rb_eArgError, "this IO is already registered with selector");
+    if (existing) {
+        monitor = rb_ivar_get(existing->self, rb_intern("io"));
+
+        /* The descriptor may belong to an IO which was closed without being
+           deregistered and has since been reused, in which case the stale
+           monitor is discarded */
+        if (monitor == io || !RTEST(rb_io_closed_p(rb_convert_type(monitor, T_FILE, "IO", "to_io")))) {
+            rb_raise(rb_eArgError, "this IO is already registered with selector");
+        }
+
+        NIO_Selector_remove(selector, existing);
+        rb_funcall(existing->self, rb_intern("close"), 1, Qfalse);
+    }
 
     /* Create a new NIO::Monitor */
     monitor_args[0] = io;
@@ -379,7 +705,7 @@ static VALUE NIO_Selector_register_synchronized(VALUE _args)
     monitor_args[2] = self;
 
     monitor = rb_class_new_instance(3, monitor_args, cNIO_Monitor);
-    rb_hash_aset(selectables, rb_funcall(monitor, rb_intern("io"), 0), monitor);
+    NIO_Selector_insert(self, selector, NIO_Monitor_unwrap(monitor));
 
     return monitor;
 }
@@ -394,29 +720,141 @@ static VALUE NIO_Selector_deregister(VALUE self, VALUE io)
 /* Internal implementation of register after acquiring mutex */
 static VALUE NIO_Selector_deregister_synchronized(VALUE _args)
 {
-    VALUE self, io, selectables, monitor;
+    VALUE self, io;
+    struct NIO_Selector *selector;
+    struct NIO_Monitor *monitor;
 
     VALUE *args = (VALUE *)_args;
     self = args[0];
     io = args[1];
 
-    selectables = rb_ivar_get(self, rb_intern("selectables"));
-    monitor = rb_hash_delete(selectables, io);
+    TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
+    monitor = NIO_Selector_lookup(selector, io);
 
-    if (monitor != Qnil) {
-        rb_funcall(monitor, rb_intern("close"), 1, Qfalse);
+    if (!monitor) {
+        return Qnil;
     }
 
-    return monitor;
+    NIO_Selector_remove(selector, monitor);
+    rb_funcall(monitor->self, rb_intern("close"), 1, Qfalse);
+
+    return monitor->self;
+}
+
+/* Deregister a monitor which is being closed. Its IO may be closed already,
+   so the monitor's own descriptor is used to find it */
+void NIO_Selector_deregister_monitor(VALUE self, VALUE monitor)
+{
+    VALUE args[2] = {self, monitor};
+    NIO_Selector_synchronize(self, NIO_Selector_deregister_monitor_synchronized, (VALUE)args);
+}
+
+/* Internal implementation of deregister_monitor after acquiring mutex */
+static VALUE NIO_Selector_deregister_monitor_synchronized(VALUE _args)
+{
+    VALUE *args = (VALUE *)_args;
+    struct NIO_Selector *selector = NIO_Selector_unwrap(args[0]);
+    struct NIO_Monitor *monitor = NIO_Monitor_unwrap(args[1]);
+    int fd = monitor->ev_io.fd;
+
+    if (fd >= 0 && fd < selector->monitors_capacity && selector->monitors[fd] == monitor) {
+        NIO_Selector_remove(selector, monitor);
+    }
+
+    return Qnil;
+}
+
+/* Register many IO objects with the selector for the same interests, taking
+   the selector lock only once. Since libev defers descriptor changes until
+   the loop next runs, the backend applies them together on the next select */
+static VALUE NIO_Selector_register_all(VALUE self, VALUE ios, VALUE interests)
+{
+    VALUE args[3] = {self, rb_convert_type(ios, T_ARRAY, "Array", "to_ary"), interests};
+    return NIO_Selector_synchronize(self, NIO_Selector_register_all_synchronized, (VALUE)args);
+}
+
+/* Internal implementation of register_all after acquiring mutex. If any of
+   the IO objects can't be registered, the ones before it are deregistered
+   again before the error is raised */
+static VALUE NIO_Selector_register_all_synchronized(VALUE _args)
+{
+    long i;
+    int state = 0;
+    VALUE monitors, monitor;
+    struct NIO_Selector *selector;
+
+    VALUE *args = (VALUE *)_args;
+    VALUE register_args[5] = {args[0], Qnil, args[2], Qnil, args[1]};
+
+    monitors = rb_ary_new_capa(RARRAY_LEN(args[1]));
+    register_args[3] = monitors;
+
+    rb_protect(NIO_Selector_register_each, (VALUE)register_args, &state);
+
+    if (state) {
+        selector = NIO_Selector_unwrap(args[0]);
+
+        for (i = 0; i < RARRAY_LEN(monitors); i++) {
+            monitor = RARRAY_AREF(monitors, i);
+            NIO_Selector_remove(selector, NIO_Monitor_unwrap(monitor));
+            rb_funcall(monitor, rb_intern("close"), 1, Qfalse);
+        }
+
+        rb_jump_tag(state);
+    }
+
+    return monitors;
+}
+
+/* Register each IO object in turn, collecting their monitors */
+static VALUE NIO_Selector_register_each(VALUE _args)
+{
+    long i;
+    VALUE *args = (VALUE *)_args;
+    VALUE monitors = args[3], ios = args[4];
+
+    for (i = 0; i < RARRAY_LEN(ios); i++) {
+        args[1] = RARRAY_AREF(ios, i);
+        rb_ary_push(monitors, NIO_Selector_register_synchronized(_args));
+    }
+
+    return monitors;
+}
+
+/* Deregister many IO objects from the selector, taking the selector lock only once */
+static VALUE NIO_Selector_deregister_all(VALUE self, VALUE ios)
+{
+    VALUE args[2] = {self, rb_convert_type(ios, T_ARRAY, "Array", "to_ary")};
+    return NIO_Selector_synchronize(self, NIO_Selector_deregister_all_synchronized, (VALUE)args);
+}
+
+/* Internal implementation of deregister_all after acquiring mutex */
+static VALUE NIO_Selector_deregister_all_synchronized(VALUE _args)
+{
+    long i;
+    VALUE monitors;
+
+    VALUE *args = (VALUE *)_args;
+    VALUE deregister_args[2] = {args[0], Qnil};
+
+    monitors = rb_ary_new_capa(RARRAY_LEN(args[1]));
+
+    for (i = 0; i < RARRAY_LEN(args[1]); i++) {
+        deregister_args[1] = RARRAY_AREF(args[1], i);
+        rb_ary_push(monitors, NIO_Selector_deregister_synchronized((VALUE)deregister_args));
+    }
+
+    return monitors;
 }
 
 /* Is the given IO object registered with the selector */
 static VALUE NIO_Selector_is_registered(VALUE self, VALUE io)
 {
-    VALUE selectables = rb_ivar_get(self, rb_intern("selectables"));
+    struct NIO_Selector *selector;
+    TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
 
     /* Perhaps this should be holding the mutex? */
-    return rb_funcall(selectables, rb_intern("has_key?"), 1, io);
+    return NIO_Selector_lookup(selector, io) ? Qtrue : Qfalse;
 }
 
 /* Select from all registered IO objects */
@@ -430,14 +868,34 @@ static VALUE NIO_Selector_select(int argc, VALUE *argv, VALUE self)
         rb_raise(rb_eArgError, "time interval must be positive");
     }
 
-    VALUE args[2] = {self, timeout};
+    VALUE args[3] = {self, timeout, Qnil};
+    return NIO_Selector_synchronize(self, NIO_Selector_select_synchronized, (VALUE)args);
+}
+
+/* Select from all registered IO objects, reusing the given array for the
+   ready monitors instead of allocating a new one on every call */
+static VALUE NIO_Selector_select_into(int argc, VALUE *argv, VALUE self)
+{
+    VALUE ready_array, timeout;
+
+    rb_scan_args(argc, argv, "11", &ready_array, &timeout);
+
+    Check_Type(ready_array, T_ARRAY);
+    rb_check_frozen(ready_array);
+
+    if (timeout != Qnil && NUM2DBL(timeout) < 0) {
+        rb_raise(rb_eArgError, "time interval must be positive");
+    }
+
+    VALUE args[3] = {self, timeout, ready_array};
     return NIO_Selector_synchronize(self, NIO_Selector_select_synchronized, (VALUE)args);
 }
 
 /* Internal implementation of select with the selector lock held */
 static VALUE NIO_Selector_select_synchronized(VALUE _args)
 {
-    int ready;
+    long i;
+    int ready, yield;
     VALUE ready_array;
     struct NIO_Selector *selector;
 
@@ -449,35 +907,130 @@ static VALUE NIO_Selector_select_synchronized(VALUE _args)
         rb_raise(rb_eIOError, "selector is closed");
     }
 
-    if (!rb_block_given_p()) {
-        RB_OBJ_WRITE(args[0], &selector->ready_array, rb_ary_new());
+    /* Monitors are yielded only if a block is given and no array was supplied */
+    yield = args[2] == Qnil && rb_block_given_p();
+
+    if (args[2] != Qnil) {
+        /* rb_ary_clear frees the storage of arrays which have grown, but
+           deleting from the end never shrinks it, so a loop selecting into
+           the same array doesn't allocate */
+        for (i = RARRAY_LEN(args[2]); i > 0; i--) {
+            rb_ary_delete_at(args[2], i - 1);
+        }
+
+        RB_OBJ_WRITE(args[0], &selector->ready_array, args[2]);
+    } else if (!yield) {
+        RB_OBJ_WRITE(args[0], &selector->ready_array, rb_ary_new_capa(selector->last_ready_count > INITIAL_READY_BUFFER ? selector->last_ready_count : INITIAL_READY_BUFFER));
+    } else {
+        RB_OBJ_WRITE(args[0], &selector->ready_array, Qnil);
     }
 
+    RB_OBJ_WRITE(args[0], &selector->raw_events, Qnil);
+
+    /* Procs and Methods are called whether or not there's a block */
+    selector->deferring = selector->dispatch == NIO_DISPATCH_CALL || (selector->dispatch == NIO_DISPATCH_DEFERRED && yield);
+    selector->ready_events_count = 0;
+
     ready = NIO_Selector_run(selector, args[1]);
 
+    if (selector->deferring) {
+        NIO_Selector_dispatch_ready(selector);
+    }
+
+    ready_array = selector->ready_array;
+    RB_OBJ_WRITE(args[0], &selector->ready_array, Qnil);
+
+    /* Fibers run until they wait again, so only once the loop is done with */
+    if (NIO_Selector_resume_waiters(selector) > 0 && ready < 0) {
+        ready = 0;
+    }
+
     /* Timeout */
     if (ready < 0) {
-        if (!rb_block_given_p()) {
-            RB_OBJ_WRITE(args[0], &selector->ready_array, Qnil);
-        }
-
         return Qnil;
     }
 
-    if (rb_block_given_p()) {
+    if (yield) {
         return INT2NUM(ready);
     } else {
-        ready_array = selector->ready_array;
-        RB_OBJ_WRITE(args[0], &selector->ready_array, Qnil);
         return ready_array;
     }
 }
 
+/* Select from all registered IO objects, packing the file descriptor and
+   readiness of each ready monitor into a binary String as a pair of native
+   32-bit integers (String#unpack("l*")) rather than returning monitors. The
+   readiness is 1 when readable, 2 when writable (3 for both) and 4 when the
+   monitor's idle timeout has passed. Timers and operations are yielded to the
+   block, which is required while any are pending. The dispatch mode is
+   ignored.
+
+   Returns the given string, which is cleared first, or a new one, or nil if
+   the timeout elapsed */
+static VALUE NIO_Selector_select_raw(int argc, VALUE *argv, VALUE self)
+{
+    VALUE timeout, buffer;
+
+    rb_scan_args(argc, argv, "02", &timeout, &buffer);
+
+    if (timeout != Qnil && NUM2DBL(timeout) < 0) {
+        rb_raise(rb_eArgError, "time interval must be positive");
+    }
+
+    if (buffer == Qnil) {
+        buffer = rb_str_buf_new(INITIAL_READY_BUFFER * 2 * sizeof(int32_t));
+    } else {
+        StringValue(buffer);
+        rb_str_modify(buffer);
+        rb_str_set_len(buffer, 0);
+    }
+
+    rb_enc_associate(buffer, rb_ascii8bit_encoding());
+
+    VALUE args[3] = {self, timeout, buffer};
+    return NIO_Selector_synchronize(self, NIO_Selector_select_raw_synchronized, (VALUE)args);
+}
+
+static VALUE NIO_Selector_select_raw_synchronized(VALUE _args)
+{
+    int ready;
+    struct NIO_Selector *selector;
+
+    VALUE *args = (VALUE *)_args;
+
+    TypedData_Get_Struct(args[0], struct NIO_Selector, &NIO_Selector_type, selector);
+
+    if (selector->closed) {
+        rb_raise(rb_eIOError, "selector is closed");
+    }
+
+    /* Timers are stopped and operations dequeued as they're reported, so
+       there has to be somewhere to report them to */
+    if (!rb_block_given_p() && (selector->timers || selector->operations || selector->completed)) {
+        rb_raise(rb_eArgError, "select_raw needs a block while timers or operations are pending");
+    }
+
+    RB_OBJ_WRITE(args[0], &selector->ready_array, Qnil);
+    RB_OBJ_WRITE(args[0], &selector->raw_events, args[2]);
+    selector->deferring = 0;
+
+    ready = NIO_Selector_run(selector, args[1]);
+
+    RB_OBJ_WRITE(args[0], &selector->raw_events, Qnil);
+
+    if (NIO_Selector_resume_waiters(selector) > 0 && ready < 0) {
+        ready = 0;
+    }
+
+    return ready < 0 ? Qnil : args[2];
+}
+
 static int NIO_Selector_run(struct NIO_Selector *selector, VALUE timeout)
 {
     int ev_run_flags = EVRUN_ONCE;
     int result;
-    double timeout_val;
+    double timeout_val = 0;
+    ev_tstamp deadline = 0;
 
     selector->selecting = 1;
     selector->wakeup_fired = 0;
@@ -492,15 +1045,48 @@ static int NIO_Selector_run(struct NIO_Selector *selector, VALUE timeout)
                select operation */
             ev_run_flags = EVRUN_NOWAIT;
         } else {
+            /* The loop's time is from its last iteration, which may have been
+               a while ago */
+            ev_now_update(selector->ev_loop);
             selector->timer.repeat = timeout_val;
             ev_timer_again(selector->ev_loop, &selector->timer);
+            deadline = ev_now(selector->ev_loop) + timeout_val;
         }
     }
 
-    /* libev is patched to release the GIL when it makes its system call */
-    ev_run(selector->ev_loop, ev_run_flags);
+    /* Don't wait if operations have completed since the last select */
+    if (selector->completed) {
+        ev_run_flags = EVRUN_NOWAIT;
+    }
+
+    selector->wait_deadline = ev_run_flags == EVRUN_NOWAIT ? ev_now(selector->ev_loop) : deadline;
+
+    for (;;) {
+        /* libev is patched to release the GIL when it makes its system call */
+        ev_run(selector->ev_loop, ev_run_flags);
+
+        /* Timers whose deadlines were pushed back wake the loop up early, as
+           does the kernel reporting a one-shot monitor's descriptor libev
+           hasn't removed yet, so carry on waiting if that's all that happened.
+           Consuming a wakeup, even one sent before we started, clears
+           selecting */
+        if (ev_run_flags != EVRUN_ONCE || !selector->selecting || selector->ready_count || selector->wakeup_fired || selector->completed || selector->resumable) {
+            break;
+        }
+
+        if (timeout != Qnil) {
+            if (deadline <= ev_now(selector->ev_loop)) {
+                break;
+            }
+
+            selector->timer.repeat = deadline - ev_now(selector->ev_loop);
+            ev_timer_again(selector->ev_loop, &selector->timer);
+        }
+    }
 
-    result = selector->ready_count;
+    NIO_Selector_deliver(selector);
+
+    result = selector->last_ready_count = selector->ready_count;
     selector->selecting = selector->ready_count = 0;
 
     if (result > 0 || selector->wakeup_fired) {
@@ -522,6 +1108,24 @@ static VALUE NIO_Selector_wakeup(VALUE self)
     }
 
     selector->wakeup_fired = 1;
+
+    /* A wakeup which hasn't been consumed yet leaves the descriptor readable,
+       so whether or not the selector is currently polling it will return
+       promptly without us issuing another write */
+    if (selector->wakeup_pending) {
+        return Qnil;
+    }
+
+    selector->wakeup_pending = 1;
+
+#ifdef HAVE_SYS_EVENTFD_H
+    if (selector->wakeup_writer == selector->wakeup_reader) {
+        uint64_t increment = 1;
+        write(selector->wakeup_writer, &increment, sizeof(increment));
+        return Qnil;
+    }
+#endif
+
     write(selector->wakeup_writer, "\0", 1);
 
     return Qnil;
@@ -536,9 +1140,49 @@ static VALUE NIO_Selector_close(VALUE self)
 static VALUE NIO_Selector_close_synchronized(VALUE self)
 {
     struct NIO_Selector *selector;
+    struct NIO_Operation *operation;
 
     TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
 
+    /* Operations still in flight are abandoned along with the event loop.
+       This can't happen in the finalizer, where they may already be freed */
+    while (selector->operations) {
+        NIO_Selector_cancel(selector, selector->operations);
+    }
+
+    while ((operation = selector->completed)) {
+        selector->completed = operation->queue_next;
+        operation->selector = 0;
+        operation->queue_next = 0;
+        operation->queued = 0;
+
+        /* Pooled buffers go away with the selector, and so do connections
+           which were never selected */
+        operation->chunks = operation->chunks_tail = -1;
+        while (operation->sockets_count > 0) {
+            close(operation->sockets[--operation->sockets_count]);
+        }
+
+        if (!NIO_OPERATION_MULTISHOT(operation) && operation->result > 0) {
+            NIO_ByteBuffer_unwrap(operation->buffer)->position = operation->offset + operation->result;
+        }
+    }
+
+    selector->completed_tail = 0;
+
+    /* Timers which haven't fired never will */
+    while (selector->timers) {
+        NIO_Timer_stop(selector->timers);
+    }
+
+    NIO_Selector_stop_waiters(selector);
+
+    /* Registered buffers are let go of along with the ring */
+    if (selector->fixed_buffers != Qnil) {
+        NIO_Selector_pin_fixed_buffers(selector, 0);
+        RB_OBJ_WRITE(self, &selector->fixed_buffers, Qnil);
+    }
+
     NIO_Selector_shutdown(selector);
 
     return Qnil;
@@ -562,9 +1206,454 @@ static VALUE NIO_Selector_closed_synchronized(VALUE self)
 /* True if there are monitors on the loop */
 static VALUE NIO_Selector_is_empty(VALUE self)
 {
-    VALUE selectables = rb_ivar_get(self, rb_intern("selectables"));
+    struct NIO_Selector *selector;
+    TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
+
+    return selector->monitors_count == 0 ? Qtrue : Qfalse;
+}
+
+/* The monitor in the slot for an open IO object's descriptor, or 0. It may
+   be for another IO object with the same descriptor */
+static struct NIO_Monitor *NIO_Selector_slot(struct NIO_Selector *selector, VALUE io)
+{
+    VALUE file = rb_check_convert_type(io, T_FILE, "IO", "to_io");
+    int fd;
+
+    if (NIL_P(file) || RTEST(rb_io_closed_p(file))) {
+        return 0;
+    }
+
+    fd = rb_io_descriptor(file);
+    return fd < selector->monitors_capacity ? selector->monitors[fd] : 0;
+}
+
+/* The monitor for an IO object, or 0. One left behind by another IO object
+   which was closed without being deregistered, and whose descriptor has
+   since been reused, doesn't match */
+static struct NIO_Monitor *NIO_Selector_lookup(struct NIO_Selector *selector, VALUE io)
+{
+    VALUE file = rb_check_convert_type(io, T_FILE, "IO", "to_io");
+    struct NIO_Monitor *monitor;
+    int fd;
+
+    if (NIL_P(file)) {
+        return 0;
+    }
+
+    if (!RTEST(rb_io_closed_p(file))) {
+        monitor = NIO_Selector_slot(selector, io);
+        return monitor && rb_ivar_get(monitor->self, rb_intern("io")) == io ? monitor : 0;
+    }
+
+    /* A closed IO no longer knows its descriptor, so search for its monitor */
+    for (fd = 0; fd < selector->monitors_capacity; fd++) {
+        if (selector->monitors[fd] && rb_ivar_get(selector->monitors[fd]->self, rb_intern("io")) == io) {
+            return selector->monitors[fd];
+        }
+    }
+
+    return 0;
+}
+
+/* Add a monitor to the table, growing it to fit the monitor's descriptor */
+static void NIO_Selector_insert(VALUE self, struct NIO_Selector *selector, struct NIO_Monitor *monitor)
+{
+    int fd = monitor->ev_io.fd;
+    int capacity = selector->monitors_capacity;
+
+    if (fd >= capacity) {
+        if (capacity < INITIAL_MONITORS_CAPACITY) {
+            capacity = INITIAL_MONITORS_CAPACITY;
+        }
+
+        while (fd >= capacity) {
+            capacity *= 2;
+        }
+
+        REALLOC_N(selector->monitors, struct NIO_Monitor *, capacity);
+        MEMZERO(selector->monitors + selector->monitors_capacity, struct NIO_Monitor *, capacity - selector->monitors_capacity);
+        selector->monitors_capacity = capacity;
+    }
+
+    assert(!selector->monitors[fd]);
+    selector->monitors[fd] = monitor;
+    selector->monitors_count++;
+
+    RB_OBJ_WRITTEN(self, Qundef, monitor->self);
+}
+
+/* Remove a monitor from the table, cancelling its operations */
+static void NIO_Selector_remove(struct NIO_Selector *selector, struct NIO_Monitor *monitor)
+{
+    int fd = monitor->ev_io.fd;
+    struct NIO_Operation *operation, *next;
+
+    assert(fd < selector->monitors_capacity && selector->monitors[fd] == monitor);
+    selector->monitors[fd] = 0;
+    selector->monitors_count--;
+
+    for (operation = selector->operations; operation; operation = next) {
+        next = operation->next;
+
+        /* Zero-copy sends have been written, but the kernel may still be
+           reading their buffers, so they stay in flight until it says it's
+           done with them, the connection hangs up, or the selector is closed */
+        if (operation->monitor != monitor->self || operation->zerocopy == NIO_ZEROCOPY_SENT) {
+            continue;
+        }
+
+        if (ev_is_active(&operation->ev_io) || operation->resubmit) {
+            ev_io_stop(selector->ev_loop, &operation->ev_io);
+            operation->resubmit = 0;
+            NIO_Selector_complete(operation, -ECANCELED);
+        } else {
+            /* The kernel completes the operation, either way */
+            ev_iouring_cancel(selector->ev_loop, &operation->iouring);
+        }
+    }
+}
+
+/* Start performing an operation: with io_uring, the kernel does the transfer
+   itself, otherwise it's done once the IO is ready */
+void NIO_Selector_submit(VALUE self, VALUE operation)
+{
+    VALUE args[2] = {self, operation};
+    NIO_Selector_synchronize(self, NIO_Selector_submit_synchronized, (VALUE)args);
+}
+
+static VALUE NIO_Selector_submit_synchronized(VALUE _args)
+{
+    struct NIO_Selector *selector;
+    struct NIO_Operation *operation;
+
+    VALUE *args = (VALUE *)_args;
+
+    TypedData_Get_Struct(args[0], struct NIO_Selector, &NIO_Selector_type, selector);
+    if (selector->closed) {
+        rb_raise(rb_eIOError, "selector is closed");
+    }
+
+    operation = NIO_Operation_unwrap(args[1]);
+
+    if (!NIO_OPERATION_MULTISHOT(operation)) {
+        operation->pinned = NIO_ByteBuffer_unwrap(operation->buffer);
+        NIO_ByteBuffer_pin(operation->pinned);
+    }
+
+    operation->selector = selector;
+    operation->prev = 0;
+    operation->next = selector->operations;
+    if (selector->operations) {
+        selector->operations->prev = operation;
+    }
+    selector->operations = operation;
+    RB_OBJ_WRITTEN(args[0], Qundef, args[1]);
+
+    NIO_Selector_start(selector, operation);
+
+    return Qnil;
+}
+
+/* Hand an in-flight operation to the kernel, or wait for its IO to be ready */
+static void NIO_Selector_start(struct NIO_Selector *selector, struct NIO_Operation *operation)
+{
+    int fd, index, kind;
+    char *data = 0;
+    rb_io_t *fptr;
+    struct stat st;
+
+    fd = NIO_Monitor_unwrap(operation->monitor)->ev_io.fd;
+
+    if (operation->type == NIO_OPERATION_ACCEPT) {
+        operation->iouring.cb = NIO_Selector_iouring_accept_callback;
+        if (ev_iouring_submit(selector->ev_loop, &operation->iouring, EV_IOURING_ACCEPT_MULTISHOT, fd, 0, 0, SOCK_CLOEXEC) == 0) {
+            return;
+        }
+    } else if (operation->type == NIO_OPERATION_RECEIVE) {
+        /* The kernel only receives into provided buffers from sockets */
+        operation->iouring.cb = NIO_Selector_iouring_receive_callback;
+        if (fstat(fd, &st) == 0 && S_ISSOCK(st.st_mode) && NIO_BufferPool_open(selector) &&
+            ev_iouring_submit(selector->ev_loop, &operation->iouring, EV_IOURING_RECV_MULTISHOT, fd, 0, 0, 0) == 0) {
+            return;
+        }
+
+        if (!selector->buffer_pool.scratch) {
+            selector->buffer_pool.scratch = xmalloc(selector->buffer_pool.size);
+        }
+    } else {
+        /* Zero-copy sends are made once the socket is writable */
+        if (operation->zerocopy && !NIO_Selector_zerocopy_enable(selector, NIO_Monitor_unwrap(operation->monitor))) {
+            operation->zerocopy = NIO_ZEROCOPY_OFF;
+        }
+
+        data = NIO_ByteBuffer_unwrap(operation->buffer)->buffer + operation->offset;
+        index = NIO_Selector_fixed_index(selector, operation->buffer);
+        if (index < 0) {
+            kind = operation->events == EV_WRITE ? EV_IOURING_WRITE : EV_IOURING_READ;
+        } else {
+            kind = operation->events == EV_WRITE ? EV_IOURING_WRITE_FIXED : EV_IOURING_READ_FIXED;
+        }
+
+        operation->iouring.cb = NIO_Selector_iouring_callback;
+        if (!operation->zerocopy && ev_iouring_submit(selector->ev_loop, &operation->iouring, kind, fd, data, operation->length, index) == 0) {
+            return;
+        }
+    }
+
+    /* Like read_from and write_to, the transfer mustn't block once the IO is ready */
+    GetOpenFile(rb_convert_type(rb_ivar_get(operation->monitor, rb_intern("io")), T_FILE, "IO", "to_io"), fptr);
+    rb_io_set_nonblock(fptr);
+
+    if (operation->type == NIO_OPERATION_ACCEPT) {
+        ev_io_init(&operation->ev_io, NIO_Selector_accept_callback, fd, EV_READ);
+    } else if (operation->type == NIO_OPERATION_RECEIVE) {
+        ev_io_init(&operation->ev_io, NIO_Selector_receive_callback, fd, EV_READ);
+    } else {
+        ev_io_init(&operation->ev_io, NIO_Selector_operation_callback, fd, operation->events);
+    }
+
+    operation->ev_io.data = (void *)operation;
+    ev_io_start(selector->ev_loop, &operation->ev_io);
+}
+
+/* Remove an operation from the in-flight list */
+static void NIO_Selector_unlink(struct NIO_Operation *operation)
+{
+    struct NIO_Selector *selector = operation->selector;
 
-    return rb_funcall(selectables, rb_intern("empty?"), 0) == Qtrue ? Qtrue : Qfalse;
+    if (operation->prev) {
+        operation->prev->next = operation->next;
+    } else {
+        selector->operations = operation->next;
+    }
+
+    if (operation->next) {
+        operation->next->prev = operation->prev;
+    }
+
+    operation->prev = operation->next = 0;
+}
+
+/* Queue an operation to be selected, if it isn't already. Receives are queued
+   while still in flight. This may run without the GVL, so it mustn't touch
+   any Ruby objects */
+static void NIO_Selector_enqueue(struct NIO_Operation *operation)
+{
+    struct NIO_Selector *selector = operation->selector;
+
+    if (operation->queued) {
+        return;
+    }
+
+    operation->queued = 1;
+    operation->queue_next = 0;
+
+    if (selector->completed_tail) {
+        selector->completed_tail->queue_next = operation;
+    } else {
+        selector->completed = operation;
+    }
+
+    selector->completed_tail = operation;
+}
+
+/* Move an operation from the in-flight list to the end of the completed
+   queue. This may run without the GVL, so it mustn't touch any Ruby objects */
+static void NIO_Selector_complete(struct NIO_Operation *operation, int result)
+{
+    operation->result = result;
+    operation->completed = 1;
+    NIO_Selector_unpin(operation);
+
+    NIO_Selector_unlink(operation);
+    NIO_Selector_enqueue(operation);
+}
+
+/* The kernel is done with the operation's buffer */
+static void NIO_Selector_unpin(struct NIO_Operation *operation)
+{
+    if (operation->pinned) {
+        NIO_ByteBuffer_unpin(operation->pinned);
+        operation->pinned = 0;
+    }
+}
+
+/* Abandon an in-flight operation when the selector is closed */
+static void NIO_Selector_cancel(struct NIO_Selector *selector, struct NIO_Operation *operation)
+{
+    if (ev_is_active(&operation->ev_io)) {
+        ev_io_stop(selector->ev_loop, &operation->ev_io);
+    }
+
+    selector->operations = operation->next;
+    if (operation->next) {
+        operation->next->prev = 0;
+    }
+
+    operation->result = -ECANCELED;
+    operation->completed = 1;
+    operation->resubmit = 0;
+    NIO_Selector_unpin(operation);
+    operation->prev = operation->next = 0;
+
+    /* Still queued operations are let go of along with the queue */
+    if (!operation->queued) {
+        operation->selector = 0;
+    }
+}
+
+/* Index of a buffer registered for fixed reads and writes, or -1 */
+static int NIO_Selector_fixed_index(struct NIO_Selector *selector, VALUE buffer)
+{
+    long i;
+
+    if (selector->fixed_buffers == Qnil) {
+        return -1;
+    }
+
+    for (i = 0; i < RARRAY_LEN(selector->fixed_buffers); i++) {
+        if (RARRAY_AREF(selector->fixed_buffers, i) == buffer) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+/* Hand completed operations over along with the ready monitors */
+static void NIO_Selector_deliver(struct NIO_Selector *selector)
+{
+    VALUE self, data;
+    long count;
+    struct NIO_Operation *operation;
+
+    while ((operation = selector->completed)) {
+        selector->completed = operation->queue_next;
+        if (!selector->completed) {
+            selector->completed_tail = 0;
+        }
+
+        operation->queue_next = 0;
+        operation->queued = 0;
+        self = operation->self;
+
+        if (NIO_OPERATION_MULTISHOT(operation)) {
+            if (operation->type == NIO_OPERATION_ACCEPT) {
+                data = NIO_Selector_collect_sockets(operation);
+                count = RARRAY_LEN(data);
+            } else {
+                /* Copy received data out of the pool, so its buffers are free again */
+                data = operation->received != Qnil ? operation->received : rb_str_new(0, 0);
+                data = NIO_BufferPool_collect(&selector->buffer_pool, operation, data);
+                RB_OBJ_WRITE(self, &operation->received, Qnil);
+                count = RSTRING_LEN(data);
+            }
+
+            if (operation->resubmit && !operation->completed) {
+                operation->resubmit = 0;
+                NIO_Selector_start(selector, operation);
+            }
+
+            if (count == 0 && !operation->completed) {
+                continue;
+            }
+
+            RB_OBJ_WRITE(self, &operation->data, data);
+            if (!operation->completed || operation->result >= 0) {
+                operation->result = (int)count;
+            }
+        } else if (operation->result > 0) {
+            /* Like read_from and write_to, advance the buffer past the transfer */
+            NIO_ByteBuffer_unwrap(operation->buffer)->position = operation->offset + operation->result;
+        }
+
+        if (operation->completed) {
+            operation->selector = 0;
+        }
+
+        NIO_Selector_report(selector, self, -1, 0);
+        RB_GC_GUARD(self);
+    }
+}
+
+/* Hand something which is ready to whoever's selecting: into the array
+   select returns, to its block, into the ready events to be dispatched once
+   the loop has run, or packed into select_raw's string */
+static void NIO_Selector_report(struct NIO_Selector *selector, VALUE object, int fd, int revents)
+{
+    struct NIO_Ready *ready;
+    int32_t raw[2];
+
+    if (selector->raw_events != Qnil) {
+        /* Only what select_raw hands over counts towards its result */
+        if (fd >= 0) {
+            selector->ready_count++;
+            raw[0] = fd;
+            raw[1] = (revents & EV_READ ? 1 : 0) | (revents & EV_WRITE ? 2 : 0) | (revents & EV_TIMER ? 4 : 0);
+            rb_str_cat(selector->raw_events, (const char *)raw, sizeof(raw));
+        } else if (rb_block_given_p()) {
+            selector->ready_count++;
+            rb_yield(object);
+        }
+
+        return;
+    }
+
+    selector->ready_count++;
+
+    if (selector->deferring) {
+        if (selector->ready_events_count == selector->ready_events_capacity) {
+            selector->ready_events_capacity = selector->ready_events_capacity ? selector->ready_events_capacity * 2 : INITIAL_READY_BUFFER;
+            REALLOC_N(selector->ready_events, struct NIO_Ready, selector->ready_events_capacity);
+        }
+
+        ready = &selector->ready_events[selector->ready_events_count++];
+        RB_OBJ_WRITE(selector->self, &ready->object, object);
+        ready->fd = fd;
+        ready->revents = revents;
+    } else if (selector->ready_array != Qnil) {
+        rb_ary_push(selector->ready_array, object);
+    } else {
+        rb_yield(object);
+    }
+}
+
+/* Dispatch the ready events in one go, calling the values of monitors which
+   are Procs or Methods if asked to. Anything the block does to the selector,
+   like selecting again, ends the dispatch early */
+static void NIO_Selector_dispatch_ready(struct NIO_Selector *selector)
+{
+    struct NIO_Ready *ready;
+    VALUE object, value;
+
+    selector->deferring = 0;
+
+    for (int i = 0; i < selector->ready_events_count; i++) {
+        ready = &selector->ready_events[i];
+        object = ready->object;
+
+        if (selector->dispatch == NIO_DISPATCH_CALL && ready->fd >= 0) {
+            value = rb_ivar_get(object, rb_intern("value"));
+
+            if (rb_obj_is_proc(value)) {
+                rb_proc_call_with_block(value, 1, &object, Qnil);
+                continue;
+            }
+
+            if (rb_obj_is_method(value)) {
+                rb_method_call(1, &object, value);
+                continue;
+            }
+        }
+
+        if (selector->ready_array != Qnil) {
+            rb_ary_push(selector->ready_array, object);
+        } else {
+            rb_yield(object);
+        }
+    }
+
+    selector->ready_events_count = 0;
 }
 
 /* Called whenever a timeout fires on the event loop */
@@ -579,9 +1668,420 @@ static void NIO_Selector_wakeup_callback(struct ev_loop *ev_loop, struct ev_io *
     struct NIO_Selector *selector = (struct NIO_Selector *)io->data;
     selector->selecting = 0;
 
+#ifdef HAVE_SYS_EVENTFD_H
+    if (selector->wakeup_reader == selector->wakeup_writer) {
+        /* Reading an eventfd resets its counter in a single call */
+        uint64_t counter;
+        read(selector->wakeup_reader, &counter, sizeof(counter));
+        selector->wakeup_pending = 0;
+        return;
+    }
+#endif
+
     /* Drain the wakeup pipe, giving us level-triggered behavior */
     while (read(selector->wakeup_reader, buffer, 128) > 0)
         ;
+
+    selector->wakeup_pending = 0;
+}
+
+/* libev callback fired when the IO of an operation which isn't performed by
+   io_uring is ready */
+static void NIO_Selector_operation_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents)
+{
+    ssize_t result;
+    struct NIO_Operation *operation = (struct NIO_Operation *)io->data;
+    char *data = NIO_ByteBuffer_unwrap(operation->buffer)->buffer + operation->offset;
+
+    if (revents & EV_ERROR) {
+        result = -EBADF;
+    } else {
+        if (operation->events == EV_READ) {
+            result = read(io->fd, data, operation->length);
+        } else if (operation->zerocopy) {
+            result = NIO_Selector_zerocopy_send(operation, io->fd, data);
+
+            /* Completed once the kernel has let go of the buffer */
+            if (operation->zerocopy == NIO_ZEROCOPY_SENT) {
+                ev_io_stop(ev_loop, io);
+                return;
+            }
+        } else {
+            result = write(io->fd, data, operation->length);
+        }
+
+        if (result < 0) {
+            /* Spurious readiness, so wait for the next */
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return;
+            }
+
+            result = -errno;
+        }
+    }
+
+    ev_io_stop(ev_loop, io);
+    NIO_Selector_complete(operation, (int)result);
+}
+
+/* libev callback fired when the IO of a receive which isn't performed by
+   io_uring is ready. Data is read through the scratch buffer until the IO
+   is drained, and collected until the operation is selected */
+static void NIO_Selector_receive_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents)
+{
+    ssize_t result;
+    struct NIO_Operation *operation = (struct NIO_Operation *)io->data;
+    struct NIO_BufferPool *pool = &operation->selector->buffer_pool;
+
+    if (revents & EV_ERROR) {
+        result = -EBADF;
+    } else {
+        while ((result = read(io->fd, pool->scratch, pool->size)) > 0) {
+            if (operation->received == Qnil) {
+                RB_OBJ_WRITE(operation->self, &operation->received, rb_str_new(pool->scratch, result));
+            } else {
+                rb_str_cat(operation->received, pool->scratch, result);
+            }
+
+            NIO_Selector_enqueue(operation);
+
+            if (result < pool->size) {
+                return;
+            }
+        }
+
+        if (result < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return;
+            }
+
+            result = -errno;
+        }
+    }
+
+    ev_io_stop(ev_loop, io);
+    NIO_Selector_complete(operation, (int)result);
+}
+
+/* Called by the io_uring backend when the kernel has completed an operation */
+static void NIO_Selector_iouring_callback(struct ev_loop *ev_loop, struct ev_iouring_op *iouring, int result, unsigned int flags)
+{
+    NIO_Selector_complete((struct NIO_Operation *)((char *)iouring - offsetof(struct NIO_Operation, iouring)), result);
+}
+
+/* libev callback fired when a listening socket which isn't accepted from by
+   io_uring is ready. Up to a batch of connections are accepted at a time */
+static void NIO_Selector_accept_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents)
+{
+    int fd, accepted = 0;
+    struct NIO_Operation *operation = (struct NIO_Operation *)io->data;
+
+    if (revents & EV_ERROR) {
+        ev_io_stop(ev_loop, io);
+        NIO_Selector_complete(operation, -EBADF);
+        return;
+    }
+
+    while (accepted < operation->batch) {
+#ifdef HAVE_ACCEPT4
+        fd = accept4(io->fd, 0, 0, SOCK_CLOEXEC);
+#else
+        fd = accept(io->fd, 0, 0);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+#endif
+
+        if (fd < 0) {
+            /* Connections may be gone before we get to them */
+            if (errno == ECONNABORTED || errno == EPROTO || errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+
+            ev_io_stop(ev_loop, io);
+            NIO_Selector_complete(operation, -errno);
+            return;
+        }
+
+        if (!NIO_Selector_accepted(operation, fd)) {
+            break;
+        }
+
+        accepted++;
+    }
+}
+
+/* Called by the io_uring backend for every connection a multishot accept
+   takes, and once more if it has stopped. This runs without the GVL */
+static void NIO_Selector_iouring_accept_callback(struct ev_loop *ev_loop, struct ev_iouring_op *iouring, int result, unsigned int flags)
+{
+#ifdef HAVE_TYPE_STRUCT_IO_URING_BUF_REG
+    struct NIO_Operation *operation = (struct NIO_Operation *)((char *)iouring - offsetof(struct NIO_Operation, iouring));
+
+    if (result >= 0) {
+        NIO_Selector_accepted(operation, result);
+    }
+
+    if (flags & IORING_CQE_F_MORE) {
+        return;
+    }
+
+    if (result >= 0) {
+        operation->resubmit = 1;
+        NIO_Selector_enqueue(operation);
+        return;
+    }
+
+    NIO_Selector_complete(operation, result);
+#endif
+}
+
+/* Hold on to an accepted connection until the operation is selected. This
+   may run without the GVL, so it only uses the system allocator. Returns 0
+   if the connection had to be dropped */
+static int NIO_Selector_accepted(struct NIO_Operation *operation, int fd)
+{
+    int capacity, *sockets;
+
+    if (operation->sockets_count == operation->sockets_capacity) {
+        capacity = operation->sockets_capacity ? operation->sockets_capacity * 2 : 16;
+        sockets = realloc(operation->sockets, capacity * sizeof(int));
+        if (!sockets) {
+            close(fd);
+            return 0;
+        }
+
+        operation->sockets = sockets;
+        operation->sockets_capacity = capacity;
+    }
+
+    operation->sockets[operation->sockets_count++] = fd;
+    NIO_Selector_enqueue(operation);
+
+    return 1;
+}
+
+/* Wrap the connections an accept has taken since it was last selected */
+static VALUE NIO_Selector_collect_sockets(struct NIO_Operation *operation)
+{
+    VALUE sockets = rb_ary_new_capa(operation->sockets_count);
+    ID for_fd = rb_intern("for_fd");
+    int i;
+
+    for (i = 0; i < operation->sockets_count; i++) {
+        rb_ary_push(sockets, rb_funcall(operation->socket_class, for_fd, 1, INT2NUM(operation->sockets[i])));
+    }
+
+    operation->sockets_count = 0;
+
+    return sockets;
+}
+
+/* Turn on SO_ZEROCOPY for a monitor's socket, the first time it's asked for.
+   Returns whether its writes can be sent with MSG_ZEROCOPY */
+static int NIO_Selector_zerocopy_enable(struct NIO_Selector *selector, struct NIO_Monitor *monitor)
+{
+#ifdef NIO_ZEROCOPY
+    int one = 1;
+
+    if (monitor->zerocopy == 0) {
+        /* Only TCP and UDP sockets support it */
+        monitor->zerocopy = setsockopt(monitor->ev_io.fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0 ? 1 : -1;
+    }
+
+    if (monitor->zerocopy < 0) {
+        return 0;
+    }
+
+    if (selector->zerocopy_epoll < 0) {
+        selector->zerocopy_epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (selector->zerocopy_epoll < 0) {
+            return 0;
+        }
+
+        ev_io_init(&selector->zerocopy_watcher, NIO_Selector_zerocopy_callback, selector->zerocopy_epoll, EV_READ);
+        selector->zerocopy_watcher.data = (void *)selector;
+        ev_io_start(selector->ev_loop, &selector->zerocopy_watcher);
+    }
+
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/* Send with MSG_ZEROCOPY. Once the kernel has the buffer, the operation waits
+   for the completion on the socket's error queue */
+static ssize_t NIO_Selector_zerocopy_send(struct NIO_Operation *operation, int fd, char *data)
+{
+#ifdef NIO_ZEROCOPY
+    struct NIO_Monitor *monitor = NIO_Monitor_unwrap(operation->monitor);
+    struct epoll_event event = {0};
+    ssize_t result = send(fd, data, operation->length, MSG_ZEROCOPY);
+
+    /* Out of locked memory to pin the buffer with, so copy it instead */
+    if (result < 0 && errno == ENOBUFS) {
+        operation->zerocopy = NIO_ZEROCOPY_OFF;
+        return write(fd, data, operation->length);
+    }
+
+    if (result > 0) {
+        operation->result = (int)result;
+        operation->zerocopy = NIO_ZEROCOPY_SENT;
+        operation->zerocopy_id = monitor->zerocopy_id++;
+
+        /* Without any events, epoll only reports errors: completions among them.
+           The monitor is kept alive by its sends, even once it's deregistered */
+        if (monitor->zerocopy_pending++ == 0) {
+            event.data.ptr = (void *)monitor;
+            epoll_ctl(operation->selector->zerocopy_epoll, EPOLL_CTL_ADD, fd, &event);
+        }
+    }
+
+    return result;
+#else
+    operation->zerocopy = NIO_ZEROCOPY_OFF;
+    return write(fd, data, operation->length);
+#endif
+}
+
+/* Complete a monitor's zero-copy sends from lo to hi, which the kernel has let
+   go of, and stop watching its error queue once none are left */
+static void NIO_Selector_zerocopy_release(struct NIO_Selector *selector, struct NIO_Monitor *monitor, unsigned int lo, unsigned int hi, enum NIO_Zerocopy_state state)
+{
+    struct NIO_Operation *operation, *next;
+
+    for (operation = selector->operations; operation; operation = next) {
+        next = operation->next;
+
+        /* The range may wrap around */
+        if (operation->monitor != monitor->self || operation->zerocopy != NIO_ZEROCOPY_SENT || operation->zerocopy_id - lo > hi - lo) {
+            continue;
+        }
+
+        operation->zerocopy = state;
+        monitor->zerocopy_pending--;
+        NIO_Selector_complete(operation, operation->result);
+    }
+
+#ifdef NIO_ZEROCOPY
+    if (monitor->zerocopy_pending == 0) {
+        epoll_ctl(selector->zerocopy_epoll, EPOLL_CTL_DEL, monitor->ev_io.fd, 0);
+    }
+#endif
+}
+
+#ifdef NIO_ZEROCOPY
+/* libev callback fired when sockets with zero-copy sends in flight have
+   something on their error queues */
+static void NIO_Selector_zerocopy_callback(struct ev_loop *ev_loop, struct ev_io *io, int revents)
+{
+    struct NIO_Selector *selector = (struct NIO_Selector *)io->data;
+    struct NIO_Monitor *monitor;
+    struct epoll_event events[64];
+    struct sock_extended_err *error;
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    char control[128];
+    int i, fd, count, released;
+
+    count = epoll_wait(selector->zerocopy_epoll, events, 64, 0);
+
+    for (i = 0; i < count; i++) {
+        monitor = (struct NIO_Monitor *)events[i].data.ptr;
+        fd = monitor->ev_io.fd;
+        released = 0;
+
+        for (;;) {
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+                break;
+            }
+
+            for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+                    !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+                    continue;
+                }
+
+                error = (struct sock_extended_err *)CMSG_DATA(cmsg);
+                if (error->ee_errno != 0 || error->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                    continue;
+                }
+
+                /* ee_info and ee_data are the first and last sends completed */
+                NIO_Selector_zerocopy_release(selector, monitor, error->ee_info, error->ee_data,
+                                              error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED ? NIO_ZEROCOPY_COPIED : NIO_ZEROCOPY_DONE);
+                released = 1;
+            }
+        }
+
+        /* Once the connection has failed or hung up, the kernel has purged what
+           it was going to send, so nothing is waiting on the buffers any more.
+           Errors are left for the next read or write to report */
+        if (monitor->zerocopy_pending > 0 && ((events[i].events & EPOLLHUP) || ((events[i].events & EPOLLERR) && !released))) {
+            NIO_Selector_zerocopy_release(selector, monitor, 0, UINT_MAX, NIO_ZEROCOPY_COPIED);
+        }
+    }
+}
+#endif
+
+/* Called by the io_uring backend for every buffer a multishot receive fills,
+   and once more if it has stopped. This runs without the GVL, so received
+   buffers are only chained to the operation until it's delivered */
+static void NIO_Selector_iouring_receive_callback(struct ev_loop *ev_loop, struct ev_iouring_op *iouring, int result, unsigned int flags)
+{
+#ifdef HAVE_TYPE_STRUCT_IO_URING_BUF_REG
+    struct NIO_Operation *operation = (struct NIO_Operation *)((char *)iouring - offsetof(struct NIO_Operation, iouring));
+    struct NIO_BufferPool *pool = &operation->selector->buffer_pool;
+    int id;
+
+    if (flags & IORING_CQE_F_BUFFER) {
+        id = flags >> IORING_CQE_BUFFER_SHIFT;
+
+        if (result > 0) {
+            pool->in_use++;
+            pool->lengths[id] = result;
+            pool->next[id] = -1;
+
+            if (operation->chunks_tail < 0) {
+                operation->chunks = id;
+            } else {
+                pool->next[operation->chunks_tail] = id;
+            }
+
+            operation->chunks_tail = id;
+            NIO_Selector_enqueue(operation);
+        } else {
+            NIO_BufferPool_recycle(pool, id);
+        }
+    }
+
+    if (flags & IORING_CQE_F_MORE) {
+        return;
+    }
+
+    /* The kernel stops receiving once it runs out of buffers, or for reasons
+       of its own after some data, in which case we start it again */
+    if (result == -ENOBUFS || result > 0) {
+        if (result == -ENOBUFS) {
+            pool->exhausted++;
+        }
+
+        operation->resubmit = 1;
+        NIO_Selector_enqueue(operation);
+        return;
+    }
+
+    NIO_Selector_complete(operation, result);
+#endif
 }
 
 /* libev callback fired whenever a monitor gets an event */
@@ -594,13 +2094,374 @@ void NIO_Selector_monitor_callback(struct ev_loop *ev_loop, struct ev_io *io, in
     assert(monitor_data->interests != 0);
 
     assert(selector != 0);
-    selector->ready_count++;
     monitor_data->revents = revents;
 
-    if (rb_block_given_p()) {
-        rb_yield(monitor);
+    /* Being selected is what keeps a monitor from going idle */
+    if (monitor_data->idle_timeout > 0) {
+        monitor_data->last_active = ev_now(ev_loop);
+        if (!ev_is_active(&monitor_data->idle_timer)) {
+            ev_timer_set(&monitor_data->idle_timer, monitor_data->idle_timeout, 0.);
+            ev_timer_start(ev_loop, &monitor_data->idle_timer);
+        }
+    }
+
+    /* One-shot monitors stay disarmed until NIO::Monitor#rearm. libev leaves
+       the descriptor with the backend until it's reported again, so epoll
+       wakes the loop up once more before it's removed */
+    if (monitor_data->mode == NIO_MONITOR_ONESHOT) {
+        ev_io_stop(ev_loop, io);
+    }
+
+    NIO_Selector_report(selector, monitor, io->fd, revents);
+}
+
+/* libev callback fired when a timer's deadline passes, or the deadline it had
+   before it was rescheduled */
+void NIO_Selector_timer_callback(struct ev_loop *ev_loop, struct ev_timer *ev_timer, int revents)
+{
+    struct NIO_Timer *timer = (struct NIO_Timer *)ev_timer->data;
+    struct NIO_Selector *selector = timer->selector;
+    VALUE self = timer->self;
+    ev_tstamp remaining = timer->deadline - ev_now(ev_loop);
+
+    assert(selector != 0);
+
+    if (remaining > 0) {
+        ev_timer_set(ev_timer, remaining, 0.);
+        ev_timer_start(ev_loop, ev_timer);
+        return;
+    }
+
+    NIO_Timer_stop(timer);
+    NIO_Selector_report(selector, self, -1, 0);
+
+    RB_GC_GUARD(self);
+}
+
+/* libev callback fired when a monitor may have been idle for its idle_timeout.
+   It's selected as :timeout unless it has been selected since the timer was
+   started, in which case the timer is started again for the time that's left */
+void NIO_Selector_idle_callback(struct ev_loop *ev_loop, struct ev_timer *timer, int revents)
+{
+    struct NIO_Monitor *monitor_data = (struct NIO_Monitor *)timer->data;
+    struct NIO_Selector *selector = monitor_data->selector;
+    VALUE monitor = monitor_data->self;
+    ev_tstamp remaining = monitor_data->last_active + monitor_data->idle_timeout - ev_now(ev_loop);
+
+    assert(selector != 0);
+
+    /* Ready in the same iteration, which libev calls back for afterwards */
+    if (ev_is_pending(&monitor_data->ev_io)) {
+        remaining = monitor_data->idle_timeout;
+    }
+
+    if (remaining > 0) {
+        ev_timer_set(timer, remaining, 0.);
+        ev_timer_start(ev_loop, timer);
+        return;
+    }
+
+    monitor_data->revents = EV_TIMER;
+    NIO_Selector_report(selector, monitor, monitor_data->ev_io.fd, EV_TIMER);
+}
+
+/* Add a timer which is selected, along with any ready monitors, once the
+   given number of seconds have passed. The value is for the caller, like a
+   monitor's, and can be anything */
+static VALUE NIO_Selector_add_timer(int argc, VALUE *argv, VALUE self)
+{
+    VALUE interval, value;
+
+    rb_scan_args(argc, argv, "11", &interval, &value);
+
+    if (NUM2DBL(interval) < 0) {
+        rb_raise(rb_eArgError, "time interval must be positive");
+    }
+
+    return NIO_Timer_new(self, NUM2DBL(interval), value);
+}
+
+/* The dispatch mode named by a Symbol */
+static enum NIO_Selector_dispatch NIO_Selector_dispatch_mode(VALUE dispatch)
+{
+    if (dispatch == ID2SYM(rb_intern("inline"))) {
+        return NIO_DISPATCH_INLINE;
+    } else if (dispatch == ID2SYM(rb_intern("deferred"))) {
+        return NIO_DISPATCH_DEFERRED;
+    } else if (dispatch == ID2SYM(rb_intern("call"))) {
+        return NIO_DISPATCH_CALL;
+    }
+
+    rb_raise(rb_eArgError, "invalid dispatch: %" PRIsVALUE " (expected :inline, :deferred or :call)", dispatch);
+}
+
+/* How select hands over what's ready: :inline yields each one as the loop
+   finds it, :deferred collects them and yields them once it's done, and :call
+   does the same but calls the value of any monitor which is a Proc or Method
+   with the monitor instead of yielding it or returning it */
+static VALUE NIO_Selector_get_dispatch(VALUE self)
+{
+    switch (NIO_Selector_unwrap(self)->dispatch) {
+    case NIO_DISPATCH_DEFERRED:
+        return ID2SYM(rb_intern("deferred"));
+    case NIO_DISPATCH_CALL:
+        return ID2SYM(rb_intern("call"));
+    default:
+        return ID2SYM(rb_intern("inline"));
+    }
+}
+
+static VALUE NIO_Selector_set_dispatch(VALUE self, VALUE dispatch)
+{
+    NIO_Selector_unwrap(self)->dispatch = NIO_Selector_dispatch_mode(dispatch);
+    return dispatch;
+}
+
+/* Register ByteBuffers with the kernel, so io_uring reads and writes using
+   them don't have to map their memory each time. Returns false if the
+   backend doesn't support it. An empty array unregisters them */
+static VALUE NIO_Selector_register_buffers(VALUE self, VALUE buffers)
+{
+    VALUE args[2] = {self, buffers};
+    return NIO_Selector_synchronize(self, NIO_Selector_register_buffers_synchronized, (VALUE)args);
+}
+
+static VALUE NIO_Selector_register_buffers_synchronized(VALUE _args)
+{
+    struct NIO_Selector *selector;
+    struct NIO_ByteBuffer *bytebuffer;
+    struct iovec *iovecs;
+    VALUE *args = (VALUE *)_args;
+    VALUE self = args[0];
+    VALUE buffers = rb_ary_dup(rb_convert_type(args[1], T_ARRAY, "Array", "to_ary"));
+    long i, count = RARRAY_LEN(buffers);
+    int result;
+
+    TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
+    if (selector->closed) {
+        rb_raise(rb_eIOError, "selector is closed");
+    }
+
+    iovecs = ALLOCA_N(struct iovec, count > 0 ? count : 1);
+    for (i = 0; i < count; i++) {
+        bytebuffer = NIO_ByteBuffer_unwrap(RARRAY_AREF(buffers, i));
+        NIO_ByteBuffer_modify(bytebuffer, 1);
+        iovecs[i].iov_base = bytebuffer->buffer;
+        iovecs[i].iov_len = bytebuffer->capacity;
+    }
+
+#ifdef HAVE_TYPE_STRUCT_IO_URING_BUF_REG
+    if (selector->fixed_buffers != Qnil) {
+        ev_iouring_register(selector->ev_loop, IORING_UNREGISTER_BUFFERS, 0, 0);
+        NIO_Selector_pin_fixed_buffers(selector, 0);
+        RB_OBJ_WRITE(self, &selector->fixed_buffers, Qnil);
+    }
+
+    if (count == 0) {
+        return Qfalse;
+    }
+
+    result = ev_iouring_register(selector->ev_loop, IORING_REGISTER_BUFFERS, iovecs, (unsigned int)count);
+    if (result < 0) {
+        if (errno == ENOSYS) {
+            return Qfalse;
+        }
+
+        rb_sys_fail("io_uring_register");
+    }
+
+    RB_OBJ_WRITE(self, &selector->fixed_buffers, rb_ary_freeze(buffers));
+    NIO_Selector_pin_fixed_buffers(selector, 1);
+
+    return Qtrue;
+#else
+    return Qfalse;
+#endif
+}
+
+/* Keep registered buffers from being checked back into the pool while
+   they're registered */
+static void NIO_Selector_pin_fixed_buffers(struct NIO_Selector *selector, int pin)
+{
+    long i;
+
+    for (i = 0; i < RARRAY_LEN(selector->fixed_buffers); i++) {
+        if (pin) {
+            NIO_ByteBuffer_pin(NIO_ByteBuffer_unwrap(RARRAY_AREF(selector->fixed_buffers, i)));
+        } else {
+            NIO_ByteBuffer_unpin(NIO_ByteBuffer_unwrap(RARRAY_AREF(selector->fixed_buffers, i)));
+        }
+    }
+}
+
+/* Statistics for the pool multishot receives borrow buffers from */
+static VALUE NIO_Selector_buffer_pool(VALUE self)
+{
+    struct NIO_Selector *selector;
+    VALUE stats = rb_hash_new();
+
+    TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
+
+    rb_hash_aset(stats, ID2SYM(rb_intern("buffers")), INT2NUM(selector->buffer_pool.count));
+    rb_hash_aset(stats, ID2SYM(rb_intern("buffer_size")), INT2NUM(selector->buffer_pool.size));
+    rb_hash_aset(stats, ID2SYM(rb_intern("in_use")), INT2NUM(selector->buffer_pool.in_use));
+    rb_hash_aset(stats, ID2SYM(rb_intern("exhausted")), ULONG2NUM(selector->buffer_pool.exhausted));
+
+    return stats;
+}
+
+/* Set up the provided buffer ring multishot receives use with io_uring, the
+   first time one is submitted. Returns 0 if that isn't possible */
+static int NIO_BufferPool_open(struct NIO_Selector *selector)
+{
+#ifdef HAVE_TYPE_STRUCT_IO_URING_BUF_REG
+    struct NIO_BufferPool *pool = &selector->buffer_pool;
+    struct io_uring_buf_reg reg;
+    size_t ring_size = (size_t)pool->count * sizeof(struct io_uring_buf);
+    int id;
+
+    if (pool->ring) {
+        return 1;
+    }
+
+    if (pool->unavailable || ev_backend(selector->ev_loop) != EVBACKEND_IOURING) {
+        return 0;
+    }
+
+    /* The kernel requires the ring to be page aligned */
+    if (posix_memalign(&pool->ring, sysconf(_SC_PAGESIZE), ring_size) != 0) {
+        pool->ring = 0;
+        rb_memerror();
+    }
+
+    memset(pool->ring, 0, ring_size);
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uintptr_t)pool->ring;
+    reg.ring_entries = pool->count;
+    reg.bgid = 0;
+
+    if (ev_iouring_register(selector->ev_loop, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        free(pool->ring);
+        pool->ring = 0;
+        pool->unavailable = 1;
+        return 0;
+    }
+
+    pool->buffers = xmalloc2(pool->count, pool->size);
+    pool->lengths = ALLOC_N(int, pool->count);
+    pool->next = ALLOC_N(int, pool->count);
+
+    for (id = 0; id < pool->count; id++) {
+        NIO_BufferPool_recycle(pool, id);
+    }
+
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+static void NIO_BufferPool_close(struct NIO_BufferPool *pool)
+{
+    if (pool->ring) {
+        free(pool->ring);
+        pool->ring = 0;
+    }
+
+    xfree(pool->buffers);
+    xfree(pool->lengths);
+    xfree(pool->next);
+    xfree(pool->scratch);
+    pool->buffers = pool->scratch = 0;
+    pool->lengths = pool->next = 0;
+    pool->in_use = 0;
+}
+
+/* Hand a buffer back to the kernel. This may run without the GVL */
+static void NIO_BufferPool_recycle(struct NIO_BufferPool *pool, int id)
+{
+#ifdef HAVE_TYPE_STRUCT_IO_URING_BUF_REG
+    struct io_uring_buf_ring *ring = (struct io_uring_buf_ring *)pool->ring;
+    struct io_uring_buf *buf = &ring->bufs[pool->tail & (pool->count - 1)];
+
+    buf->addr = (uintptr_t)(pool->buffers + (size_t)id * pool->size);
+    buf->len = pool->size;
+    buf->bid = id;
+
+    pool->tail++;
+    __atomic_store_n(&ring->tail, (unsigned short)pool->tail, __ATOMIC_RELEASE);
+#endif
+}
+
+/* Append the buffers a receive has filled to data, handing them back */
+static VALUE NIO_BufferPool_collect(struct NIO_BufferPool *pool, struct NIO_Operation *operation, VALUE data)
+{
+    int id, next;
+
+    for (id = operation->chunks; id >= 0; id = next) {
+        next = pool->next[id];
+        rb_str_cat(data, pool->buffers + (size_t)id * pool->size, pool->lengths[id]);
+        NIO_BufferPool_recycle(pool, id);
+        pool->in_use--;
+    }
+
+    operation->chunks = operation->chunks_tail = -1;
+
+    return data;
+}
+
+/* Accept connections from a listening socket whenever they arrive: with
+   io_uring a single multishot accept takes them, otherwise up to batch are
+   accepted per readiness event. The returned operation is selected with an
+   array of new sockets as its data. The server is registered without any
+   interests if it isn't already */
+static VALUE NIO_Selector_accept_loop(int argc, VALUE *argv, VALUE self)
+{
+    VALUE server, options, monitor;
+    struct NIO_Selector *selector;
+    struct NIO_Monitor *existing;
+
+    TypedData_Get_Struct(self, struct NIO_Selector, &NIO_Selector_type, selector);
+
+    rb_scan_args(argc, argv, "1:", &server, &options);
+    NIO_Operation_socket_class(server);
+
+    existing = NIO_Selector_lookup(selector, server);
+    if (existing) {
+        monitor = existing->self;
     } else {
-        assert(selector->ready_array != Qnil);
-        rb_ary_push(selector->ready_array, monitor);
+        monitor = NIO_Selector_register(self, server, ID2SYM(rb_intern("r")));
+        rb_funcall(monitor, rb_intern("interests="), 1, Qnil);
     }
+
+    return NIO_Monitor_accept(monitor, options);
+}
+
+/* Read into the buffers of every readable monitor given, typically the ones
+   just selected, as Monitor#read_into would. Returns a hash of the results
+   by monitor: the number of bytes read, nil at end of file, or the exception
+   read_into would have raised. Monitors without buffers are skipped */
+static VALUE NIO_Selector_read_ready(VALUE self, VALUE monitors)
+{
+    VALUE monitor, buffer, results = rb_hash_new();
+    ID buffer_id = rb_intern("buffer");
+    long i;
+
+    monitors = rb_convert_type(monitors, T_ARRAY, "Array", "to_ary");
+
+    for (i = 0; i < RARRAY_LEN(monitors); i++) {
+        monitor = RARRAY_AREF(monitors, i);
+        if (!rb_obj_is_kind_of(monitor, cNIO_Monitor) || !(NIO_Monitor_unwrap(monitor)->revents & EV_READ)) {
+            continue;
+        }
+
+        buffer = rb_ivar_get(monitor, buffer_id);
+        if (buffer == Qnil) {
+            continue;
+        }
+
+        rb_hash_aset(results, monitor, NIO_Monitor_read_into_buffer(monitor, buffer));
+    }
+
+    return results;
 }
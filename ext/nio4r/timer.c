@@ -0,0 +1,296 @@
+/*
+ * Distributed under the MIT License. See LICENSE.txt for further details.
+ */
+
+#include "nio4r.h"
+
+static VALUE mNIO = Qnil;
+static VALUE cNIO_Timer = Qnil;
+
+/* Allocator/deallocator */
+static void NIO_Timer_mark(void *data);
+static void NIO_Timer_free(void *data);
+static size_t NIO_Timer_memsize(const void *data);
+
+/* Methods */
+static VALUE NIO_Timer_selector(VALUE self);
+static VALUE NIO_Timer_interval(VALUE self);
+static VALUE NIO_Timer_get_value(VALUE self);
+static VALUE NIO_Timer_set_value(VALUE self, VALUE value);
+static VALUE NIO_Timer_is_active(VALUE self);
+static VALUE NIO_Timer_remaining(VALUE self);
+static VALUE NIO_Timer_cancel(VALUE self);
+static VALUE NIO_Timer_reschedule(int argc, VALUE *argv, VALUE self);
+
+/* Internal functions */
+static struct NIO_Timer *NIO_Timer_unwrap(VALUE self);
+static VALUE NIO_Timer_start_synchronized(VALUE self);
+static VALUE NIO_Timer_reschedule_synchronized(VALUE arg);
+static VALUE NIO_Timer_cancel_synchronized(VALUE self);
+static void NIO_Timer_start(struct NIO_Timer *timer, struct NIO_Selector *selector);
+static ev_tstamp NIO_Timer_now(struct NIO_Selector *selector);
+static ev_tstamp NIO_Timer_interval_value(VALUE interval);
+
+/* Timers are added to selectors with NIO::Selector#add_timer, and selected
+   along with ready monitors once they expire */
+void Init_NIO_Timer()
+{
+    mNIO = rb_define_module("NIO");
+    cNIO_Timer = rb_define_class_under(mNIO, "Timer", rb_cObject);
+    rb_undef_alloc_func(cNIO_Timer);
+
+    rb_define_method(cNIO_Timer, "selector", NIO_Timer_selector, 0);
+    rb_define_method(cNIO_Timer, "interval", NIO_Timer_interval, 0);
+    rb_define_method(cNIO_Timer, "value", NIO_Timer_get_value, 0);
+    rb_define_method(cNIO_Timer, "value=", NIO_Timer_set_value, 1);
+    rb_define_method(cNIO_Timer, "active?", NIO_Timer_is_active, 0);
+    rb_define_method(cNIO_Timer, "remaining", NIO_Timer_remaining, 0);
+    rb_define_method(cNIO_Timer, "cancel", NIO_Timer_cancel, 0);
+    rb_define_method(cNIO_Timer, "reschedule", NIO_Timer_reschedule, -1);
+}
+
+static const rb_data_type_t NIO_Timer_type = {
+    "NIO::Timer",
+    {
+        NIO_Timer_mark,
+        NIO_Timer_free,
+        NIO_Timer_memsize,
+    },
+    0,
+    0,
+    RUBY_TYPED_FREE_IMMEDIATELY | RUBY_TYPED_WB_PROTECTED
+};
+
+VALUE NIO_Timer_new(VALUE selector_obj, ev_tstamp interval, VALUE value)
+{
+    struct NIO_Timer *timer;
+    VALUE self = TypedData_Make_Struct(cNIO_Timer, struct NIO_Timer, &NIO_Timer_type, timer);
+
+    RB_OBJ_WRITE(self, &timer->self, self);
+    RB_OBJ_WRITE(self, &timer->selector_obj, selector_obj);
+    RB_OBJ_WRITE(self, &timer->value, value);
+    timer->interval = interval;
+
+    ev_init(&timer->ev_timer, NIO_Selector_timer_callback);
+    timer->ev_timer.data = (void *)timer;
+
+    NIO_Selector_synchronize_timer(selector_obj, ev_time() + interval, NIO_Timer_start_synchronized, self);
+
+    return self;
+}
+
+static VALUE NIO_Timer_start_synchronized(VALUE self)
+{
+    struct NIO_Timer *timer = NIO_Timer_unwrap(self);
+
+    NIO_Timer_start(timer, NIO_Selector_unwrap(timer->selector_obj));
+    return self;
+}
+
+static struct NIO_Timer *NIO_Timer_unwrap(VALUE self)
+{
+    struct NIO_Timer *timer;
+    TypedData_Get_Struct(self, struct NIO_Timer, &NIO_Timer_type, timer);
+    return timer;
+}
+
+static void NIO_Timer_mark(void *data)
+{
+    struct NIO_Timer *timer = (struct NIO_Timer *)data;
+    rb_gc_mark(timer->self);
+    rb_gc_mark(timer->selector_obj);
+    rb_gc_mark(timer->value);
+}
+
+/* Pending timers are marked by their selector, so one which is collected
+   either isn't pending or is going away along with its selector */
+static void NIO_Timer_free(void *data)
+{
+    xfree(data);
+}
+
+static size_t NIO_Timer_memsize(const void *data)
+{
+    return sizeof(struct NIO_Timer);
+}
+
+/* The loop's idea of the time is from its last iteration. Bring it up to date
+   unless another thread is in the middle of running it */
+static ev_tstamp NIO_Timer_now(struct NIO_Selector *selector)
+{
+    if (!selector->selecting) {
+        ev_now_update(selector->ev_loop);
+    }
+
+    return ev_now(selector->ev_loop);
+}
+
+static ev_tstamp NIO_Timer_interval_value(VALUE interval)
+{
+    ev_tstamp value = NUM2DBL(interval);
+
+    if (value < 0) {
+        rb_raise(rb_eArgError, "time interval must be positive");
+    }
+
+    return value;
+}
+
+/* Schedule the timer for its interval from now, and link it in with the
+   selector's other pending timers */
+static void NIO_Timer_start(struct NIO_Timer *timer, struct NIO_Selector *selector)
+{
+    if (selector->closed) {
+        rb_raise(rb_eIOError, "selector is closed");
+    }
+
+    timer->deadline = NIO_Timer_now(selector) + timer->interval;
+    ev_timer_set(&timer->ev_timer, timer->interval, 0.);
+    ev_timer_start(selector->ev_loop, &timer->ev_timer);
+
+    /* The selector marks its pending timers, including ones nothing else
+       refers to */
+    RB_OBJ_WRITTEN(timer->selector_obj, Qundef, timer->self);
+
+    timer->selector = selector;
+    timer->prev = 0;
+    timer->next = selector->timers;
+    if (selector->timers) {
+        selector->timers->prev = timer;
+    }
+    selector->timers = timer;
+}
+
+int NIO_Timer_stop(struct NIO_Timer *timer)
+{
+    struct NIO_Selector *selector = timer->selector;
+
+    if (!selector) {
+        return 0;
+    }
+
+    if (selector->ev_loop) {
+        ev_timer_stop(selector->ev_loop, &timer->ev_timer);
+    }
+
+    if (timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        selector->timers = timer->next;
+    }
+
+    if (timer->next) {
+        timer->next->prev = timer->prev;
+    }
+
+    timer->prev = timer->next = 0;
+    timer->selector = 0;
+
+    return 1;
+}
+
+static VALUE NIO_Timer_selector(VALUE self)
+{
+    return NIO_Timer_unwrap(self)->selector_obj;
+}
+
+/* Seconds the timer was last scheduled for */
+static VALUE NIO_Timer_interval(VALUE self)
+{
+    return DBL2NUM(NIO_Timer_unwrap(self)->interval);
+}
+
+static VALUE NIO_Timer_get_value(VALUE self)
+{
+    return NIO_Timer_unwrap(self)->value;
+}
+
+static VALUE NIO_Timer_set_value(VALUE self, VALUE value)
+{
+    RB_OBJ_WRITE(self, &NIO_Timer_unwrap(self)->value, value);
+    return value;
+}
+
+/* Is the timer yet to fire? */
+static VALUE NIO_Timer_is_active(VALUE self)
+{
+    return NIO_Timer_unwrap(self)->selector ? Qtrue : Qfalse;
+}
+
+/* Seconds until the timer fires, or nil if it isn't pending */
+static VALUE NIO_Timer_remaining(VALUE self)
+{
+    struct NIO_Timer *timer = NIO_Timer_unwrap(self);
+    ev_tstamp remaining;
+
+    if (!timer->selector) {
+        return Qnil;
+    }
+
+    remaining = timer->deadline - NIO_Timer_now(timer->selector);
+    return DBL2NUM(remaining > 0 ? remaining : 0.);
+}
+
+/* Stop the timer from firing. Returns false if it wasn't pending */
+static VALUE NIO_Timer_cancel(VALUE self)
+{
+    return NIO_Selector_synchronize(NIO_Timer_unwrap(self)->selector_obj, NIO_Timer_cancel_synchronized, self);
+}
+
+static VALUE NIO_Timer_cancel_synchronized(VALUE self)
+{
+    return NIO_Timer_stop(NIO_Timer_unwrap(self)) ? Qtrue : Qfalse;
+}
+
+/* Schedule the timer to fire after the given interval from now, or the same
+   interval as before, whether or not it's still pending. Moving a pending
+   timer's deadline later doesn't touch the selector's timer heap */
+static VALUE NIO_Timer_reschedule(int argc, VALUE *argv, VALUE self)
+{
+    struct NIO_Timer *timer = NIO_Timer_unwrap(self);
+    VALUE interval;
+    ev_tstamp interval_value;
+    VALUE args[2];
+
+    rb_scan_args(argc, argv, "01", &interval);
+
+    interval_value = interval == Qnil ? timer->interval : NIO_Timer_interval_value(interval);
+
+    args[0] = self;
+    args[1] = DBL2NUM(interval_value);
+
+    NIO_Selector_synchronize_timer(timer->selector_obj, ev_time() + interval_value, NIO_Timer_reschedule_synchronized, (VALUE)args);
+
+    return self;
+}
+
+static VALUE NIO_Timer_reschedule_synchronized(VALUE arg)
+{
+    VALUE *args = (VALUE *)arg;
+    VALUE self = args[0];
+    struct NIO_Timer *timer = NIO_Timer_unwrap(self);
+    struct NIO_Selector *selector = timer->selector;
+    ev_tstamp deadline;
+
+    timer->interval = NUM2DBL(args[1]);
+
+    if (!selector) {
+        NIO_Timer_start(timer, NIO_Selector_unwrap(timer->selector_obj));
+        return self;
+    }
+
+    deadline = NIO_Timer_now(selector) + timer->interval;
+
+    /* The callback starts the timer again for whatever's left */
+    if (deadline >= timer->deadline) {
+        timer->deadline = deadline;
+        return self;
+    }
+
+    timer->deadline = deadline;
+    ev_timer_stop(selector->ev_loop, &timer->ev_timer);
+    ev_timer_set(&timer->ev_timer, timer->interval, 0.);
+    ev_timer_start(selector->ev_loop, &timer->ev_timer);
+
+    return self;
+}
@@ -46,6 +46,12 @@ if NIO.pure?
   require "nio/monitor"
   require "nio/selector"
   require "nio/bytebuffer"
+  require "nio/bytebuffer_pool"
+  require "nio/bytebuffer_view"
+  require "nio/operation"
+  require "nio/timer"
+  require "nio/fileregion"
+  require "nio/chunkedbuffer"
   NIO::ENGINE = "ruby"
 else
   require "nio4r_ext"
@@ -59,3 +65,5 @@ else
     NIO::ENGINE = "libev"
   end
 end
+
+require "nio/selector_pool"
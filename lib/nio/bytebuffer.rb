@@ -22,6 +22,78 @@ module NIO
     # Mark has not been set
     MarkUnsetError = Class.new(IOError)
 
+    @gvl_threshold = 65_536
+
+    class << self
+      # Size in bytes from which reads and writes release the GVL. Ruby's own
+      # IO already does this for every transfer, so it's only recorded here
+      attr_reader :gvl_threshold
+
+      def gvl_threshold=(threshold)
+        raise ArgumentError, "negative threshold given" if threshold.negative?
+
+        @gvl_threshold = threshold
+      end
+    end
+
+    # Perform a non-blocking write of the remaining contents of several buffers
+    # at once, advancing each of them past what was written
+    #
+    # @param [IO] Ruby IO object to write to
+    # @param [Array<NIO::ByteBuffer>] buffers to write, in order
+    #
+    # @raise [NIO::ByteBuffer::UnderflowError] no data remaining in any buffer
+    #
+    # @return [Integer] number of bytes written (0 if the write would block)
+    def self.write_all_to(io, buffers)
+      buffers = buffers.to_ary.reject { |buffer| buffer.remaining.zero? }
+      raise UnderflowError, "no data remaining in buffers" if buffers.empty?
+
+      data = buffers.map { |buffer| buffer.send(:remaining_data) }.join
+      bytes_written = IO.try_convert(io).write_nonblock(data, exception: false)
+      return 0 if bytes_written == :wait_writable
+
+      remaining = bytes_written
+      buffers.each do |buffer|
+        break if remaining.zero?
+
+        length = [buffer.remaining, remaining].min
+        buffer.position += length
+        remaining -= length
+      end
+
+      bytes_written
+    end
+
+    # Perform a non-blocking read into the space remaining in several buffers
+    # at once, filling them in order
+    #
+    # @param [IO] Ruby IO object to read from
+    # @param [Array<NIO::ByteBuffer>] buffers to read into, in order
+    #
+    # @raise [NIO::ByteBuffer::OverflowError] every buffer is full
+    #
+    # @return [Integer, nil] number of bytes read (0 if none were available, nil at end of file)
+    def self.read_all_from(io, buffers)
+      buffers = buffers.to_ary.reject(&:full?)
+      raise OverflowError, "buffers are full" if buffers.empty?
+
+      data = IO.try_convert(io).read_nonblock(buffers.sum(&:remaining), exception: false)
+      return 0 if data == :wait_readable
+      return nil unless data
+
+      offset = 0
+      buffers.each do |buffer|
+        break if offset == data.bytesize
+
+        length = [buffer.remaining, data.bytesize - offset].min
+        buffer << data.byteslice(offset, length)
+        offset += length
+      end
+
+      data.bytesize
+    end
+
     # Create a new ByteBuffer, either with a specified capacity or populating
     # it from a given string
     #
@@ -99,7 +171,24 @@ module NIO
       raise ArgumentError, "negative length given" if length < 0
       raise UnderflowError, "not enough data in buffer" if length > @limit - @position
 
-      result = @buffer[@position...length]
+      result = @buffer[@position, length]
+      @position += length
+      result
+    end
+
+    # Like get, but returns a View of the data rather than a String. Here
+    # Views wrap frozen Strings, which Ruby may share with the buffer
+    #
+    # @param length [Integer] number of bytes to view (defaults to all remaining)
+    #
+    # @raise [NIO::ByteBuffer::UnderflowError] not enough data remaining in buffer
+    #
+    # @return [NIO::ByteBuffer::View] view of the data
+    def view(length = remaining)
+      raise ArgumentError, "negative length given" if length < 0
+      raise UnderflowError, "not enough data in buffer" if length > @limit - @position
+
+      result = View.new(@buffer.byteslice(@position, length))
       @position += length
       result
     end
@@ -116,6 +205,59 @@ module NIO
       @buffer.bytes[index]
     end
 
+    # Index of the first occurrence of a byte or String between the offset and
+    # the limit
+    #
+    # @param pattern [Integer, String] byte or String to search for
+    # @param offset [Integer] where to start searching (defaults to the position)
+    #
+    # @raise [ArgumentError] negative offset, or a byte out of range
+    #
+    # @return [Integer, nil] index of the pattern, or nil if it wasn't found
+    def index(pattern, offset = @position)
+      raise ArgumentError, "negative offset given" if offset < 0
+
+      if pattern.is_a?(Integer)
+        raise ArgumentError, "byte out of range: #{pattern}" unless pattern.between?(0, 255)
+
+        pattern = pattern.chr
+      end
+
+      pattern = pattern.to_str.b
+      return nil if offset > @limit
+
+      found = @buffer.index(pattern, offset)
+      found if found && found + pattern.bytesize <= @limit
+    end
+
+    # Read up to and including the next occurrence of the delimiter
+    #
+    # @param delimiter [Integer, String] byte or String to stop reading at
+    # @param chomp [true, false] leave the delimiter out of the String
+    #
+    # @return [String, nil] data read, or nil (leaving the position where it
+    #   is) if the delimiter isn't before the limit
+    def read_until(delimiter, chomp: false)
+      found = index(delimiter)
+      return nil unless found
+
+      length = delimiter.is_a?(Integer) ? 1 : delimiter.to_str.bytesize
+      result = @buffer[@position...(chomp ? found : found + length)]
+      @position = found + length
+      result
+    end
+
+    # Read the next line, if the buffer holds all of it
+    #
+    # @param chomp [true, false] leave the line ending (LF or CRLF) out of the String
+    #
+    # @return [String, nil] line read, or nil if there isn't a whole line
+    def read_line(chomp: false)
+      line = read_until("\n", chomp: chomp)
+      line.chomp!("\r") if line && chomp
+      line
+    end
+
     # Add a String to the buffer
     #
     # @param str [#to_str] data to add to the buffer
@@ -231,5 +373,23 @@ module NIO
         @capacity
       )
     end
+
+    private
+
+    # Contents between the position and the limit, for write_all_to
+    def remaining_data
+      @buffer[@position...@limit]
+    end
+
+    # Give up the buffer's contents as it's checked into the pool
+    #
+    # @return [true, false] was the buffer checked out of the pool?
+    def detach
+      pooled = @pooled || false
+      @pooled = false
+      @capacity = 0
+      clear
+      pooled
+    end
   end
 end
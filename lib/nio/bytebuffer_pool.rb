@@ -0,0 +1,72 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+module NIO
+  class ByteBuffer
+    # Reuse of ByteBuffer memory across short-lived buffers, instead of
+    # allocating and freeing it for each one. Strings can't be resized in
+    # place, so here every checkout allocates a new buffer
+    module Pool
+      # Smallest and largest size classes, which are powers of 2
+      MIN_SIZE = 64
+      MAX_SIZE = 1_048_576
+
+      @lock = Mutex.new
+      @misses = 0
+      @checked_out = 0
+      @max_retained_bytes = 32 * 1_048_576
+
+      class << self
+        # Memory checked in beyond this many bytes is freed
+        attr_accessor :max_retained_bytes
+
+        # Check a cleared ByteBuffer of the given capacity out of the pool.
+        # Given a block, the buffer is yielded and checked back in afterwards
+        #
+        # @param capacity [Integer] size of the buffer in bytes
+        #
+        # @return [NIO::ByteBuffer, Object] the buffer, or what the block returned
+        def checkout(capacity)
+          raise ArgumentError, "negative capacity" if capacity.negative?
+
+          buffer = ByteBuffer.new(capacity)
+          buffer.instance_variable_set(:@pooled, true) if capacity <= MAX_SIZE
+          @lock.synchronize do
+            @misses += 1
+            @checked_out += 1 if capacity <= MAX_SIZE
+          end
+          return buffer unless block_given?
+
+          begin
+            yield buffer
+          ensure
+            checkin(buffer)
+          end
+        end
+
+        # Give a buffer's memory back to the pool. The buffer is left empty,
+        # with a capacity of 0
+        #
+        # @param buffer [NIO::ByteBuffer] buffer to check in
+        def checkin(buffer)
+          raise TypeError, "expected NIO::ByteBuffer, got #{buffer.class}" unless buffer.is_a?(ByteBuffer)
+
+          @lock.synchronize { @checked_out -= 1 } if buffer.send(:detach)
+          nil
+        end
+
+        # Reuse statistics: checkouts served from the pool (hits) or by
+        # allocating memory (misses), pooled buffers which are checked out, and
+        # the memory the pool holds on to in between
+        #
+        # @return [Hash]
+        def stats
+          @lock.synchronize do
+            {hits: 0, misses: @misses, checked_out: @checked_out, retained_bytes: 0}
+          end
+        end
+      end
+    end
+  end
+end
@@ -0,0 +1,67 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+module NIO
+  class ByteBuffer
+    # Read-only views of data in ByteBuffers, which share the buffer's memory
+    # rather than copying it until the buffer is written to
+    class View
+      # :nodoc:
+      def initialize(string)
+        @string = string.freeze
+        freeze
+      end
+
+      # Number of bytes in the view
+      #
+      # @return [Integer]
+      def size
+        @string.bytesize
+      end
+      alias bytesize size
+
+      # Copy the data into a String
+      #
+      # @return [String]
+      def to_s
+        @string.dup
+      end
+      alias to_str to_s
+
+      # The byte at the given index, counting back from the end if it's
+      # negative, or nil if it's out of range
+      #
+      # @return [Integer, nil]
+      def getbyte(index)
+        @string.getbyte(index)
+      end
+
+      # Byte offset of the first occurrence of a string at or after the given
+      # offset, or nil if there isn't one
+      #
+      # @return [Integer, nil]
+      def index(substring, offset = 0)
+        # The String is binary, so characters are bytes
+        @string.index(substring.to_str.b, offset)
+      end
+
+      def start_with?(prefix)
+        @string.start_with?(prefix.to_str.b)
+      end
+
+      # Views are equal to Strings and other Views with the same bytes
+      def ==(other)
+        case other
+        when String then @string == other.b
+        when View then @string == other.instance_variable_get(:@string)
+        else false
+        end
+      end
+
+      def inspect
+        format("#<%s:0x%x @size=%d>", self.class, object_id << 1, size)
+      end
+    end
+  end
+end
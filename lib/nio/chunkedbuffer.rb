@@ -0,0 +1,124 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+module NIO
+  # Byte buffers which grow a chunk at a time, rather than being sized for the
+  # most they'll ever hold up front. Data is appended at the end and read from
+  # the front, so there's no need to flip them
+  class ChunkedBuffer
+    # Size of the chunks buffers grow by
+    CHUNK_SIZE = 4096
+
+    # How much read_from reads at a time
+    READ_SIZE = CHUNK_SIZE * 16
+
+    # Statistics for the process-wide pool chunks are taken from. The native
+    # extension carves chunks out of shared slabs, while here buffers are
+    # plain Strings
+    #
+    # @return [Hash]
+    def self.pool
+      {chunk_size: CHUNK_SIZE, slabs: 0, chunks_in_use: 0, chunks_free: 0}
+    end
+
+    # Create a new, empty buffer
+    def initialize
+      clear
+    end
+
+    # Number of bytes which haven't been read out of the buffer yet
+    #
+    # @return [Integer]
+    def remaining
+      @buffer.bytesize - @offset
+    end
+
+    # Size of the chunks the buffer holds
+    #
+    # @return [Integer]
+    def capacity
+      (@buffer.bytesize + CHUNK_SIZE - 1) / CHUNK_SIZE * CHUNK_SIZE
+    end
+
+    # Append a String, growing the buffer as needed
+    #
+    # @param str [#to_str] data to add to the buffer
+    #
+    # @return [self]
+    def <<(str)
+      @buffer << str.to_str.b
+      self
+    end
+
+    # Read the requested number of bytes out of the buffer, or all of them
+    #
+    # @raise [NIO::ByteBuffer::UnderflowError] not enough data remaining in buffer
+    #
+    # @return [String] bytes read from buffer
+    def get(length = remaining)
+      raise ArgumentError, "negative length given" if length.negative?
+      raise ByteBuffer::UnderflowError, "not enough data in buffer" if length > remaining
+
+      result = @buffer.byteslice(@offset, length)
+      @offset += length
+      result
+    end
+
+    # Perform a non-blocking read from the given IO object, growing the buffer
+    # to fit what's available
+    #
+    # @param [IO] Ruby IO object to read from
+    #
+    # @return [Integer, nil] number of bytes read (0 if none were available, nil at end of file)
+    def read_from(io)
+      data = IO.try_convert(io).read_nonblock(READ_SIZE, exception: false)
+      return 0 if data == :wait_readable
+      return nil unless data
+
+      @buffer << data
+      data.bytesize
+    end
+
+    # Perform a non-blocking write of what remains in the buffer to the given
+    # IO object
+    #
+    # @param [IO] Ruby IO object to write to
+    #
+    # @return [Integer] number of bytes written (0 if the write would block)
+    def write_to(io)
+      raise ByteBuffer::UnderflowError, "no data remaining in buffer" if remaining.zero?
+
+      bytes_written = IO.try_convert(io).write_nonblock(@buffer.byteslice(@offset, remaining), exception: false)
+      return 0 if bytes_written == :wait_writable
+
+      @offset += bytes_written
+      bytes_written
+    end
+
+    # Empty the buffer
+    #
+    # @return [self]
+    def clear
+      @buffer = String.new(encoding: Encoding::BINARY)
+      @offset = 0
+      self
+    end
+
+    # Let go of what has been read out of the buffer
+    #
+    # @return [self]
+    def compact
+      @buffer = @buffer.byteslice(@offset, remaining)
+      @offset = 0
+      self
+    end
+
+    # Inspect the state of the buffer
+    #
+    # @return [String] string describing the state of the buffer
+    def inspect
+      format("#<%s:0x%x @remaining=%d @chunks=%d>", self.class, object_id << 1, remaining, capacity / CHUNK_SIZE)
+    end
+  end
+end
@@ -0,0 +1,74 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+module NIO
+  # Regions of files, written to sockets and pipes by the kernel without
+  # copying them through a ByteBuffer
+  class FileRegion
+    # How much write_to reads from the file at a time
+    COPY_SIZE = 16_384
+
+    attr_reader :io, :offset, :remaining
+
+    # Create a region of a file, given either an open File or a path to open.
+    # The region extends to the end of the file unless a length is given
+    #
+    # @param file [File, String] file, or path to the file
+    # @param offset [Integer] where the region starts in the file
+    # @param length [Integer] size of the region in bytes
+    #
+    # @return [NIO::FileRegion]
+    def initialize(file, offset = 0, length = nil)
+      if file.is_a?(String) || file.respond_to?(:to_path)
+        @io = File.open(file, "rb")
+        @owned = true
+      else
+        @io = IO.try_convert(file) or raise TypeError, "no implicit conversion of #{file.class} into IO"
+        @owned = false
+      end
+
+      size = @io.stat.size
+      raise ArgumentError, "offset is outside the file" if offset.negative? || offset > size
+
+      @offset = offset
+      @remaining = length || size - offset
+      raise ArgumentError, "negative length" if @remaining.negative?
+      raise ArgumentError, "length is past the end of the file" if @remaining > size - offset
+    end
+
+    # Perform a non-blocking write of the region to the given IO object,
+    # advancing the offset past what was written
+    #
+    # @param [IO] Ruby IO object to write to
+    #
+    # @raise [NIO::ByteBuffer::UnderflowError] no data remaining in the region
+    # @raise [EOFError] the file was truncated after the region was created
+    #
+    # @return [Integer] number of bytes written (0 if the write would block)
+    def write_to(io)
+      raise ByteBuffer::UnderflowError, "no data remaining in region" if @remaining.zero?
+
+      data = @io.pread([@remaining, COPY_SIZE].min, @offset)
+      bytes_written = IO.try_convert(io).write_nonblock(data, exception: false)
+      return 0 if bytes_written == :wait_writable
+
+      @offset += bytes_written
+      @remaining -= bytes_written
+      bytes_written
+    end
+
+    # Close the file if the region opened it
+    def close
+      @io.close if @owned
+      nil
+    end
+
+    # Inspect the state of the region
+    #
+    # @return [String] string describing the state of the region
+    def inspect
+      format("#<%s:0x%x @offset=%d @remaining=%d>", self.class, object_id << 1, @offset, @remaining)
+    end
+  end
+end
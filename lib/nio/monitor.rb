@@ -10,9 +10,16 @@
 module NIO
   # Monitors watch IO objects for specific events
   class Monitor
-    attr_reader :io, :interests, :selector
+    attr_reader :io, :interests, :selector, :mode, :buffer
     attr_accessor :value, :readiness
 
+    # Seconds the monitor can go without being selected before it's selected
+    # with a readiness of :timeout, or nil
+    attr_reader :idle_timeout
+
+    # :nodoc:
+    attr_reader :idle_deadline
+
     # :nodoc:
     def initialize(io, interests, selector)
       unless defined?(::OpenSSL) && io.is_a?(::OpenSSL::SSL::SSLSocket)
@@ -31,6 +38,118 @@ module NIO
       @interests = interests
       @selector  = selector
       @closed    = false
+      @mode      = :level
+      @armed     = true
+      @buffer    = nil
+      @eof       = false
+    end
+
+    # Set the ByteBuffer read_into reads into by default
+    def buffer=(buffer)
+      raise TypeError, "expected NIO::ByteBuffer, got #{buffer.class}" unless buffer.nil? || buffer.is_a?(ByteBuffer)
+
+      @buffer = buffer
+    end
+
+    # Read from the IO into the buffer (the monitor's own by default) until it
+    # would block or the buffer is full, without any exceptions for the former.
+    # If the end of file comes after some data, that's returned first and the
+    # next call returns nil
+    #
+    # @param buffer [NIO::ByteBuffer] buffer to read into
+    #
+    # @return [Integer, nil] number of bytes read, or nil at end of file
+    def read_into(buffer = @buffer)
+      raise ArgumentError, "no buffer to read into" unless buffer
+      raise EOFError, "monitor is closed" if closed?
+      return if @eof
+      raise ByteBuffer::OverflowError, "buffer is full" if buffer.remaining.zero?
+
+      total = 0
+
+      while buffer.remaining.positive?
+        data = @io.read_nonblock(buffer.remaining, exception: false)
+        break if data == :wait_readable
+
+        unless data
+          @eof = true
+          return total.zero? ? nil : total
+        end
+
+        buffer << data
+        total += data.bytesize
+      end
+
+      total
+    rescue SystemCallError
+      raise if total.zero?
+
+      total
+    end
+
+    # Change how the monitor is notified of readiness:
+    # * :level - whenever the IO is ready (the default)
+    # * :edge - when the IO becomes ready. Backends which can't do this
+    #   (including this one) notify as :level does. Where they can, operations
+    #   submitted through the monitor and fibers waiting on its IO are only
+    #   woken up on edges too
+    # * :oneshot - once, after which the monitor must be rearmed
+    #
+    # @param mode [:level, :edge, :oneshot] new notification mode
+    #
+    # @return [Symbol] new mode
+    def mode=(mode)
+      raise EOFError, "monitor is closed" if closed?
+      raise ArgumentError, "bad mode: #{mode}" unless [:level, :edge, :oneshot].include?(mode)
+
+      @armed = true
+      @mode = mode
+    end
+
+    # Enable a :oneshot monitor again after it has been selected
+    #
+    # @return [self]
+    def rearm
+      raise EOFError, "monitor is closed" if closed?
+
+      @armed = true
+      self
+    end
+
+    # :nodoc:
+    def armed?
+      @armed
+    end
+
+    # Setting the idle timeout starts counting from now, whether or not it has
+    # already run out. Once it has, it starts again when the monitor is next
+    # selected. Nil turns it off
+    #
+    # @param timeout [Numeric, nil] seconds without being selected
+    #
+    # @return [Numeric, nil] the timeout
+    def idle_timeout=(timeout)
+      raise EOFError, "monitor is closed" if closed?
+      raise ArgumentError, "idle timeout must be positive" unless timeout.nil? || timeout.positive?
+
+      @idle_timeout = timeout&.to_f
+      @idle_deadline = timeout && Process.clock_gettime(Process::CLOCK_MONOTONIC) + @idle_timeout
+    end
+
+    # :nodoc:
+    def touch(now)
+      @idle_deadline = now + @idle_timeout if @idle_timeout
+    end
+
+    # :nodoc:
+    def expire
+      @idle_deadline = nil
+      @readiness = :timeout
+    end
+
+    # :nodoc:
+    def disarm
+      @armed = false if @mode == :oneshot
     end
 
     # Replace the existing interest set with a new one
@@ -99,6 +218,58 @@ module NIO
       end
     end
 
+    # Read into the remaining part of the buffer once the IO is readable. The
+    # selector returns the operation alongside ready monitors once it has
+    # completed, and the buffer's position is advanced past the data read
+    #
+    # @param buffer [NIO::ByteBuffer] buffer to read into
+    #
+    # @return [NIO::Operation]
+    def submit_read(buffer)
+      submit(buffer, :read)
+    end
+
+    # Write the remaining part of the buffer once the IO is writable. The
+    # selector returns the operation alongside ready monitors once it has
+    # completed, and the buffer's position is advanced past the data written.
+    #
+    # With zerocopy: true, the native extension sends from the buffer with
+    # MSG_ZEROCOPY on Linux, and only completes the operation once the kernel
+    # has let go of it: for TCP, once the data has been acknowledged. Here it
+    # writes as usual
+    #
+    # @param buffer [NIO::ByteBuffer] buffer to write from
+    # @param zerocopy [Boolean] send straight from the buffer, if supported
+    #
+    # @return [NIO::Operation]
+    def submit_write(buffer, zerocopy: false) # rubocop:disable Lint/UnusedMethodArgument
+      submit(buffer, :write)
+    end
+
+    # Receive data whenever it arrives, until the end of the stream. The
+    # selector returns the operation each time data has been received, which
+    # is then available as its data. With io_uring, the kernel receives into
+    # buffers borrowed from the selector's pool rather than one per IO
+    #
+    # @return [NIO::Operation]
+    def submit_receive
+      submit(nil, :receive)
+    end
+
+    # Accept connections whenever they arrive on a listening socket. The
+    # selector returns the operation each time, with the new sockets as its
+    # data. With io_uring a single multishot accept takes the connections,
+    # otherwise up to batch of them are accepted per readiness event
+    #
+    # @param batch [Integer] most connections to accept at a time
+    #
+    # @return [NIO::Operation]
+    def submit_accept(batch: 64)
+      raise ArgumentError, "batch must be positive" unless batch.is_a?(Integer) && batch.positive?
+
+      submit(nil, :accept) { |operation| operation.batch = batch }
+    end
+
     # Is the IO object readable?
     def readable?
       readiness == :r || readiness == :rw
@@ -120,5 +291,16 @@ module NIO
       @closed = true
       @selector.deregister(io) if deregister
     end
+
+    private
+
+    def submit(buffer, type)
+      raise EOFError, "monitor is closed" if closed?
+
+      operation = Operation.new(self, buffer, type)
+      yield operation if block_given?
+      @selector.submit(operation)
+      operation
+    end
   end
 end
@@ -0,0 +1,169 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+module NIO
+  # Operations are reads and writes of ByteBuffers, submitted through monitors
+  # and returned by the selector once they've completed. Receives and accepts
+  # are returned whenever data or connections have arrived
+  class Operation
+    attr_reader :monitor, :buffer, :type
+
+    # Data received, or an array of sockets accepted, since the operation was
+    # last selected. Nil for reads and writes, which transfer their buffer
+    attr_reader :data
+
+    # :nodoc:
+    attr_writer :batch
+
+    # :nodoc:
+    def initialize(monitor, buffer, type)
+      if type == :accept
+        unless defined?(::BasicSocket) && monitor.io.is_a?(::BasicSocket)
+          raise TypeError, "can't accept connections from #{monitor.io.class}"
+        end
+      elsif type != :receive
+        raise TypeError, "expected NIO::ByteBuffer, got #{buffer.class}" unless buffer.is_a?(ByteBuffer)
+      end
+
+      if buffer&.remaining&.zero?
+        raise ByteBuffer::OverflowError, "buffer is full" if type == :read
+
+        raise ByteBuffer::UnderflowError, "no data remaining in buffer"
+      end
+
+      @monitor   = monitor
+      @buffer    = buffer
+      @type      = type
+      @result    = nil
+      @error     = nil
+      @completed = false
+      @data      = nil
+      @received  = nil
+    end
+
+    # IO object the operation reads from or writes to
+    def io
+      @monitor.io
+    end
+
+    # Has the operation completed?
+    def completed?
+      @completed
+    end
+
+    # Did the kernel transmit a zero-copy write straight from the buffer? Writes
+    # are always copied here
+    def zerocopy?
+      false
+    end
+
+    # Number of bytes transferred (0 for a read at end of file), or nil if the
+    # operation hasn't completed yet. Raises the error if it failed.
+    #
+    # For receives and accepts, the number of bytes or connections in data, or
+    # nil if nothing has been selected yet
+    #
+    # @return [Integer, nil]
+    def result
+      raise @error if @error
+
+      @result
+    end
+
+    # :nodoc:
+    #
+    # Attempt the transfer now the IO is ready
+    #
+    # @param receive_size [Integer] how much a receive reads at a time
+    #
+    # @return [true, false] is there anything to select?
+    def perform(receive_size)
+      return receive(receive_size) if @type == :receive
+      return accept if @type == :accept
+
+      if @type == :read
+        data = io.read_nonblock(@buffer.remaining, exception: false)
+        return false if data == :wait_readable
+
+        @buffer << data if data
+        @result = data ? data.bytesize : 0
+      else
+        @result = @buffer.write_to(io)
+        return false if @result.zero?
+      end
+
+      @completed = true
+    rescue IOError, SystemCallError => e
+      @error = e
+      @completed = true
+    end
+
+    # :nodoc:
+    def cancel
+      @error = Errno::ECANCELED.new(@type == :receive ? "recv" : @type.to_s)
+      @received&.each(&:close) if @type == :accept
+      @received = nil
+      @completed = true
+    end
+
+    # :nodoc:
+    #
+    # Hand received data over as the operation is selected
+    #
+    # @return [true, false] is there anything to report?
+    def collect
+      return true unless @type == :receive || @type == :accept
+
+      data = @received || (@type == :accept ? [] : String.new)
+      @received = nil
+      return false if data.empty? && !@completed
+
+      @data = data
+      @result = data.size unless @error
+      true
+    end
+
+    private
+
+    # Read until the IO is drained, or the end of the stream
+    def receive(size)
+      loop do
+        data = io.read_nonblock(size, exception: false)
+        break if data == :wait_readable
+
+        unless data
+          @result = 0
+          @completed = true
+          break
+        end
+
+        (@received ||= String.new) << data
+        break if data.bytesize < size
+      end
+
+      @completed || !@received.nil?
+    rescue IOError, SystemCallError => e
+      @error = e
+      @completed = true
+    end
+
+    # Accept up to a batch of connections
+    def accept
+      @batch.times do
+        socket = io.accept_nonblock(exception: false)
+        break if socket == :wait_readable
+
+        # Socket#accept_nonblock returns the address as well
+        (@received ||= []) << (socket.is_a?(Array) ? socket.first : socket)
+      end
+
+      !@received.nil?
+    rescue Errno::ECONNABORTED, Errno::EPROTO
+      retry
+    rescue IOError, SystemCallError => e
+      @error = e
+      @completed = true
+    end
+  end
+end
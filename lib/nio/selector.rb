@@ -20,6 +20,10 @@ require "set"
 module NIO
   # Selectors monitor IO objects for events of interest
   class Selector
+    # Readiness as packed by #select_raw
+    RAW_READINESS = {r: 1, w: 2, rw: 3, timeout: 4}.freeze
+    private_constant :RAW_READINESS
+
     # Return supported backends as symbols
     #
     # See `#backend` method definition for all possible backends
@@ -28,17 +32,53 @@ module NIO
     end
 
     # Create a new NIO::Selector
-    def initialize(backend = :ruby)
+    #
+    # @param backend [Symbol, nil] one of the supported backends
+    # @param buffer_count [Integer] buffers in the pool receives borrow from
+    # @param buffer_size [Integer] size of each of them
+    # @param dispatch [:inline, :deferred, :call] see #dispatch
+    def initialize(backend = :ruby, buffer_count: 128, buffer_size: 16_384, dispatch: :inline)
       raise ArgumentError, "unsupported backend: #{backend}" unless [:ruby, nil].include?(backend)
 
+      unless buffer_count.is_a?(Integer) && buffer_count.between?(1, 32_768) && (buffer_count & (buffer_count - 1)).zero?
+        raise ArgumentError, "buffer_count must be a power of 2 no greater than 32768"
+      end
+
+      raise ArgumentError, "buffer_size must be positive" unless buffer_size.is_a?(Integer) && buffer_size.positive?
+
+      @buffer_count = buffer_count
+      @buffer_size = buffer_size
+      self.dispatch = dispatch
+
       @selectables = {}
+      @operations = []
+      @completed = []
+      @timers = {}
+      @waiters = {}
+      @unblocked = Thread::Queue.new
       @lock = Mutex.new
+      @scheduling = 0 # threads waiting for the lock to schedule timers
+      @wait_deadline = nil
 
       # Other threads can wake up a selector
       @wakeup, @waker = IO.pipe
       @closed = false
     end
 
+    # How select hands over what's ready: :inline and :deferred both yield
+    # everything once Kernel.select returns here, while :call calls the value of
+    # any monitor which is a Proc or Method with the monitor instead of yielding
+    # it or returning it
+    attr_reader :dispatch
+
+    def dispatch=(dispatch)
+      unless %i[inline deferred call].include?(dispatch)
+        raise ArgumentError, "invalid dispatch: #{dispatch.inspect} (expected :inline, :deferred or :call)"
+      end
+
+      @dispatch = dispatch
+    end
+
     # Return a symbol representing the backend I/O multiplexing mechanism used.
     # Supported backends are:
     # * :ruby     - pure Ruby (i.e IO.select)
@@ -83,57 +123,386 @@ module NIO
       @lock.synchronize do
         monitor = @selectables.delete IO.try_convert(io)
         monitor.close(false) if monitor && !monitor.closed?
+
+        # Cancelled operations are returned by the next select
+        @operations.reject! do |operation|
+          next false unless operation.monitor.equal?(monitor)
+
+          operation.cancel
+          @completed << operation unless @completed.include?(operation)
+        end
+
         monitor
       end
     end
 
+    # Register many IO objects with the selector for the same interests. If
+    # any of them can't be registered, none of them are
+    #
+    # @param ios [Array<IO>] IO objects to register
+    # @param interest [:r, :w, :rw] I/O readiness we're interested in
+    #
+    # @return [Array<NIO::Monitor>] monitors for each of the given IO objects
+    def register_all(ios, interest)
+      monitors = []
+      ios.each { |io| monitors << register(io, interest) }
+      monitors
+    rescue Exception # rubocop:disable Lint/RescueException
+      monitors.each(&:close)
+      raise
+    end
+
+    # Deregister many IO objects from the selector
+    #
+    # @param ios [Array<IO>] IO objects to deregister
+    #
+    # @return [Array<NIO::Monitor, nil>] monitors which were deregistered
+    def deregister_all(ios)
+      ios.map { |io| deregister(io) }
+    end
+
+    # :nodoc:
+    def submit(operation)
+      @lock.synchronize do
+        raise IOError, "selector is closed" if closed?
+
+        @operations << operation
+      end
+    end
+
+    # Register ByteBuffers with the kernel for io_uring reads and writes, which
+    # the pure Ruby selector can't do
+    #
+    # @param buffers [Array<NIO::ByteBuffer>] buffers to register
+    #
+    # @return [false]
+    def register_buffers(buffers)
+      buffers.each do |buffer|
+        raise TypeError, "expected NIO::ByteBuffer, got #{buffer.class}" unless buffer.is_a?(ByteBuffer)
+      end
+
+      false
+    end
+
+    # Statistics for the pool receives borrow buffers from. Receives here read
+    # straight into strings, so no buffers are ever in use
+    #
+    # @return [Hash]
+    def buffer_pool
+      {buffers: @buffer_count, buffer_size: @buffer_size, in_use: 0, exhausted: 0}
+    end
+
+    # Accept connections from a listening socket whenever they arrive. The
+    # returned operation is selected with an array of new sockets as its data.
+    # The server is registered without any interests if it isn't already
+    #
+    # @param server [BasicSocket] listening socket
+    # @param batch [Integer] most connections to accept per readiness event
+    #
+    # @return [NIO::Operation]
+    def accept_loop(server, batch: 64)
+      unless defined?(::BasicSocket) && server.is_a?(::BasicSocket)
+        raise TypeError, "can't accept connections from #{server.class}"
+      end
+
+      monitor = @lock.synchronize { @selectables[IO.try_convert(server)] }
+
+      unless monitor
+        monitor = register(server, :r)
+        monitor.interests = nil
+      end
+
+      monitor.submit_accept(batch: batch)
+    end
+
+    # Read into the buffers of every readable monitor given, typically the ones
+    # just selected, as Monitor#read_into would. Monitors without buffers are
+    # skipped
+    #
+    # @param monitors [Array<NIO::Monitor>] monitors to read from
+    #
+    # @return [Hash] the number of bytes read, nil at end of file, or the
+    #   exception read_into would have raised, by monitor
+    def read_ready(monitors)
+      monitors.each_with_object({}) do |monitor, results|
+        next unless monitor.is_a?(Monitor) && monitor.readable? && monitor.buffer
+
+        results[monitor] = begin
+          monitor.read_into
+        rescue IOError, SystemCallError => e
+          e
+        end
+      end
+    end
+
+    # Add a timer which is selected, along with any ready monitors, once the
+    # given number of seconds have passed
+    #
+    # @param interval [Numeric] seconds until the timer fires
+    # @param value [Object] anything, for the caller
+    #
+    # @return [NIO::Timer]
+    def add_timer(interval, value = nil)
+      raise ArgumentError, "time interval must be positive" if interval.negative?
+
+      Timer.new(self, interval.to_f, value).tap { |timer| schedule(timer) }
+    end
+
+    # Suspend the current fiber until the IO is ready for any of the given
+    # events, as a Fiber::Scheduler's io_wait hook would, without registering
+    # it. The fiber yields to the one which resumed it, and is resumed by #select
+    #
+    # @param io [IO] IO object to wait for
+    # @param events [Integer] IO::READABLE, IO::PRIORITY and IO::WRITABLE
+    # @param timeout [Numeric, nil] seconds to wait at most
+    #
+    # @return [Integer, false] the events which are ready, or false on timeout
+    def io_wait(io, events, timeout = nil)
+      raise ArgumentError, "no events to wait for" if (events & (IO::READABLE | IO::PRIORITY | IO::WRITABLE)).zero?
+
+      io = IO.try_convert(io) || raise(TypeError, "can't convert #{io.class} into IO")
+      wait(timeout, io, events)
+    end
+
+    # Suspend the current fiber for the given number of seconds, or until it's
+    # unblocked if that's nil
+    #
+    # @return [Boolean] false if the time ran out
+    def kernel_sleep(duration = nil)
+      wait(duration)
+    end
+
+    # Suspend the current fiber until it's unblocked or the timeout passes
+    #
+    # @return [Boolean] true if it was unblocked, false on timeout
+    def block(_blocker, timeout = nil)
+      wait(timeout)
+    end
+
+    # Resume a fiber waiting on this selector with true the next time it's
+    # selected. Safe to call from other threads
+    def unblock(_blocker, fiber)
+      return if closed?
+
+      @unblocked << fiber
+      wakeup
+    end
+
     # Is the given IO object registered with the selector?
     def registered?(io)
       @lock.synchronize { @selectables.key? io }
     end
 
-    # Select which monitors are ready
+    # Select which monitors are ready, along with any operations which have
+    # completed and any timers which have expired
     def select(timeout = nil)
       selected_monitors = Set.new
+      completed = nil
+      expired = nil
+      resumable = []
+
+      # Let threads scheduling timers have the lock first, or selecting in a
+      # loop would take it straight back from them
+      Thread.pass while @scheduling.positive? && !@lock.locked?
 
       @lock.synchronize do
         readers = [@wakeup]
         writers = []
+        deadlines = @timers.each_key.map(&:deadline)
+
+        @waiters.each_value do |io, events, deadline|
+          deadlines << deadline if deadline
+          next unless io
+
+          readers << io if events.anybits?(IO::READABLE | IO::PRIORITY)
+          writers << io if events.anybits?(IO::WRITABLE)
+        end
 
         @selectables.each do |io, monitor|
+          deadlines << monitor.idle_deadline if monitor.idle_deadline
+          next unless monitor.armed?
+
           readers << io if monitor.interests == :r || monitor.interests == :rw
           writers << io if monitor.interests == :w || monitor.interests == :rw
           monitor.readiness = nil
         end
 
-        ready_readers, ready_writers = Kernel.select(readers, writers, [], timeout)
-        return unless ready_readers # timeout
+        @operations.each do |operation|
+          (operation.type == :write ? writers : readers) << operation.io
+        end
+
+        # Don't wait if operations have completed since the last select
+        timeout = 0 unless @completed.empty?
+
+        # ...or past the next timer's deadline, or the next monitor's idle timeout
+        unless deadlines.empty?
+          wait = [deadlines.min - Process.clock_gettime(Process::CLOCK_MONOTONIC), 0].max
+          timeout = timeout ? [timeout, wait].min : wait
+        end
+
+        # When we'll give up, for other threads scheduling timers
+        @wait_deadline = timeout ? Process.clock_gettime(Process::CLOCK_MONOTONIC) + timeout : Float::INFINITY
+
+        begin
+          ready_readers, ready_writers = Kernel.select(readers.uniq, writers.uniq, [], timeout)
+        ensure
+          @wait_deadline = nil
+        end
+
+        if ready_readers
+          ready_readers.each do |io|
+            if io == @wakeup
+              # Clear all wakeup signals we've received by reading them
+              # Wakeups should have level triggered behavior
+              # (pipes report a zero size from stat so read until empty)
+              loop do
+                break unless @wakeup.read_nonblock(1024, exception: false).is_a?(String)
+              end
+            else
+              # The IO may only have been selected for an operation
+              monitor = @selectables[io]
+              next unless monitor&.armed? && (monitor.interests == :r || monitor.interests == :rw)
 
-        ready_readers.each do |io|
-          if io == @wakeup
-            # Clear all wakeup signals we've received by reading them
-            # Wakeups should have level triggered behavior
-            @wakeup.read(@wakeup.stat.size)
-          else
+              monitor.readiness = :r
+              selected_monitors << monitor
+            end
+          end
+
+          ready_writers.each do |io|
             monitor = @selectables[io]
-            monitor.readiness = :r
+            next unless monitor&.armed? && (monitor.interests == :w || monitor.interests == :rw)
+
+            monitor.readiness = monitor.readiness == :r ? :rw : :w
             selected_monitors << monitor
           end
+
+          selected_monitors.each(&:disarm)
+
+          @operations.reject! do |operation|
+            ready = operation.type == :write ? ready_writers : ready_readers
+            next false unless ready.include?(operation.io) && operation.perform(@buffer_size)
+
+            # Receives stay in flight until the end of the stream
+            @completed << operation unless @completed.include?(operation)
+            operation.completed?
+          end
+        end
+
+        now = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+        expired = @timers.each_key.select { |timer| timer.deadline <= now }
+        expired.each do |timer|
+          @timers.delete(timer)
+          timer.stop
         end
 
-        ready_writers.each do |io|
-          monitor = @selectables[io]
-          monitor.readiness = monitor.readiness == :r ? :rw : :w
+        # Being selected is what keeps a monitor from going idle
+        selected_monitors.each { |monitor| monitor.touch(now) }
+        @selectables.each_value do |monitor|
+          next unless monitor.idle_deadline && monitor.idle_deadline <= now
+
+          monitor.expire
           selected_monitors << monitor
         end
+
+        @waiters.each do |fiber, waiter|
+          io, events, deadline = waiter
+          ready = 0
+
+          if io && ready_readers
+            ready |= events & (IO::READABLE | IO::PRIORITY) if ready_readers.include?(io)
+            ready |= events & IO::WRITABLE if ready_writers.include?(io)
+          end
+
+          if ready.positive?
+            resumable << [fiber, waiter, ready]
+          elsif deadline && deadline <= now
+            resumable << [fiber, waiter, false]
+          end
+        end
+
+        until @unblocked.empty?
+          fiber = @unblocked.pop
+          waiter = @waiters[fiber]
+          resumable << [fiber, waiter, true] if waiter && resumable.none? { |other, _| other.equal?(fiber) }
+        end
+
+        return if !ready_readers && selected_monitors.empty? && @completed.empty? && expired.empty? && resumable.empty? # timeout
+
+        completed = @completed.select(&:collect)
+        @completed = []
+      end
+
+      called = 0
+      if @dispatch == :call
+        selected_monitors.delete_if do |monitor|
+          next false unless monitor.value.is_a?(Proc) || monitor.value.is_a?(Method)
+
+          monitor.value.call(monitor)
+          called += 1
+        end
+      end
+
+      # Fibers run until they wait again, so only once the selector is unlocked.
+      # One which was resumed by something else in the meantime is left alone
+      resumable.each do |fiber, waiter, result|
+        fiber.resume(result) if @waiters[fiber].equal?(waiter)
       end
 
       if block_given?
         selected_monitors.each { |m| yield m }
-        selected_monitors.size
+        completed.each { |operation| yield operation }
+        expired.each { |timer| yield timer }
+        called + selected_monitors.size + completed.size + expired.size
       else
-        selected_monitors.to_a
+        selected_monitors.to_a.concat(completed, expired)
+      end
+    end
+
+    # Select which monitors are ready, storing them in the given array rather
+    # than allocating a new one. The array is cleared before selecting.
+    #
+    # @param ready [Array] array to fill with ready monitors
+    # @param timeout [Numeric, nil] maximum time to wait in seconds
+    #
+    # @return [Array, nil] the given array, or nil if the timeout elapsed
+    def select_into(ready, timeout = nil)
+      raise TypeError, "expected Array, got #{ready.class}" unless ready.is_a?(Array)
+
+      ready.clear
+      ready if select(timeout) { |monitor| ready << monitor }
+    end
+
+    # Select which monitors are ready, packing each one's file descriptor and
+    # readiness into a binary String as a pair of native 32-bit integers
+    # (`unpack("l*")`) rather than returning monitors. Readiness is 1 when
+    # readable, 2 when writable (3 for both) and 4 when the monitor's idle
+    # timeout has passed. Timers and operations are yielded to the block,
+    # which is required while any are pending. The dispatch mode is ignored.
+    #
+    # @param timeout [Numeric, nil] maximum time to wait in seconds
+    # @param buffer [String, nil] string to clear and reuse
+    #
+    # @return [String, nil] the packed pairs, or nil if the timeout elapsed
+    def select_raw(timeout = nil, buffer = nil)
+      if !block_given? && !(@timers.empty? && @operations.empty? && @completed.empty?)
+        raise ArgumentError, "select_raw needs a block while timers or operations are pending"
       end
+
+      buffer = buffer ? buffer.clear.force_encoding(Encoding::BINARY) : String.new(encoding: Encoding::BINARY)
+      dispatch = @dispatch
+      @dispatch = :inline
+
+      ready = select(timeout) do |object|
+        if object.is_a?(Monitor)
+          [object.io.fileno, RAW_READINESS.fetch(object.readiness)].pack("l2", buffer: buffer)
+        elsif block_given?
+          yield object
+        end
+      end
+
+      buffer if ready
+    ensure
+      @dispatch = dispatch
     end
 
     # Wake up a thread that's in the middle of selecting on this selector, if
@@ -172,6 +541,19 @@ module NIO
         rescue IOError
         end
 
+        # Operations still in flight are abandoned
+        @operations.each(&:cancel)
+        @operations.clear
+        @completed.clear
+
+        # Timers which haven't fired never will
+        @timers.each_key(&:stop)
+        @timers.clear
+
+        # ...and fibers still waiting are never resumed
+        @waiters.clear
+        @unblocked.clear
+
         @closed = true
       end
     end
@@ -184,5 +566,60 @@ module NIO
     def empty?
       @selectables.empty?
     end
+
+    private
+
+    # Start a timer, or restart it if it's pending. Another thread holding the
+    # lock may be blocked in #select, which only takes the timer into account
+    # once it's been woken up and let go of the lock. Unless it's already due
+    # back before the timer, wake it up first rather than waiting for it
+    def schedule(timer)
+      deadline = Process.clock_gettime(Process::CLOCK_MONOTONIC) + timer.interval
+      wakeup if !closed? && @lock.locked? && (@wait_deadline.nil? || deadline < @wait_deadline)
+
+      @scheduling += 1
+      begin
+        @lock.lock
+      ensure
+        @scheduling -= 1
+      end
+
+      begin
+        raise IOError, "selector is closed" if closed?
+
+        @timers[timer] = true
+        timer.start
+      ensure
+        @lock.unlock
+      end
+    end
+
+    # Yield until #select resumes the current fiber, waiting for the IO's events
+    # if there is one
+    def wait(timeout, io = nil, events = 0)
+      raise ArgumentError, "time interval must be positive" if timeout&.negative?
+      raise IOError, "selector is closed" if closed?
+
+      fiber = Fiber.current
+      deadline = Process.clock_gettime(Process::CLOCK_MONOTONIC) + timeout if timeout
+      @waiters[fiber] = [io, events, deadline]
+
+      begin
+        Fiber.yield
+      ensure
+        @waiters.delete(fiber)
+      end
+    end
+
+    # Stop a pending timer, returning whether it was pending
+    def unschedule(timer)
+      @lock.synchronize do
+        next false unless timer.active?
+
+        @timers.delete(timer)
+        timer.stop
+        true
+      end
+    end
   end
 end
@@ -0,0 +1,279 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+require "etc"
+
+module NIO
+  # A pool of selectors, each running on its own thread, which share out the
+  # IO objects registered with the pool. Selecting releases the GVL, so the
+  # selectors all wait for readiness in parallel.
+  #
+  # Ready monitors are either passed to the block given to `#initialize`,
+  # which is called on the selector's thread, or queued for `#pop`. Queued
+  # monitors are in :oneshot mode, so they're only queued once until they
+  # are handed back to `#rearm`.
+  class SelectorPool
+    # A selector and the thread running it
+    class Shard
+      attr_reader :selector
+
+      # Number of IO objects registered with the selector, kept by the pool
+      attr_accessor :count
+
+      def initialize(backend)
+        @selector = Selector.new(backend)
+        @pending = Thread::Queue.new
+        @lock = Thread::Mutex.new
+        @count = 0
+        @thread = nil
+        @running = false
+        @stopped = false
+        @error = nil
+      end
+
+      # Start selecting on a new thread, yielding ready monitors. If the block
+      # raises, the thread stops and `#invoke` raises the same error
+      def start(&block)
+        @running = true
+        @thread = Thread.new do
+          while @running
+            run_pending
+            @selector.select(&block)
+          end
+        rescue Exception => error # rubocop:disable Lint/RescueException
+          @error = error
+          raise
+        ensure
+          # Nothing can be queued for the thread once it has stopped, so this
+          # answers every block that was
+          @lock.synchronize { @stopped = true }
+          run_pending(@error)
+        end
+      end
+
+      # Stop the thread and close the selector
+      def stop
+        @running = false
+
+        if @thread
+          @selector.wakeup
+
+          begin
+            @thread.join
+          rescue Exception # rubocop:disable Lint/RescueException
+            # The thread has already reported what its block raised
+          end
+
+          @thread = nil
+        end
+
+        @selector.close
+      end
+
+      # Run the given block on the selector's thread, since the selector is
+      # locked whilst it's selecting
+      #
+      # @return [Object] result of the block
+      def invoke(&block)
+        return yield unless @thread && Thread.current != @thread
+
+        result = Thread::Queue.new
+
+        stopped = @lock.synchronize do
+          @pending << [block, result] unless @stopped
+          @stopped
+        end
+
+        if stopped
+          raise @error if @error
+
+          return yield
+        end
+
+        @selector.wakeup
+
+        value, error = result.pop
+        raise error if error
+
+        value
+      end
+
+      # Register an IO object with the selector in the given mode
+      def register(io, interest, mode)
+        invoke do
+          monitor = @selector.register(io, interest)
+          monitor.mode = mode
+          monitor
+        end
+      end
+
+      # Deregister an IO object from the selector
+      def deregister(io)
+        invoke { @selector.deregister(io) }
+      end
+
+      private
+
+      def run_pending(error = nil)
+        until @pending.empty?
+          block, result = @pending.pop
+          next result << [nil, error] if error
+
+          begin
+            result << [block.call, nil]
+          rescue Exception => error # rubocop:disable Lint/RescueException
+            result << [nil, error]
+          end
+        end
+      end
+    end
+
+    # Sharding strategies, choosing the selector for a given IO object:
+    # * :descriptor   - by file descriptor number
+    # * :least_loaded - the selector with the fewest registered IO objects
+    STRATEGIES = %i[descriptor least_loaded].freeze
+
+    attr_reader :strategy
+
+    # Create a new NIO::SelectorPool and start its selectors
+    #
+    # @param size [Integer] number of selectors (and threads)
+    # @param strategy [:descriptor, :least_loaded] how IO objects are shared out
+    # @param backend [Symbol, nil] backend for each of the selectors
+    #
+    # @yield [NIO::Monitor] ready monitors, on the thread of their selector
+    def initialize(size = Etc.nprocessors, strategy: :descriptor, backend: nil, &block)
+      raise ArgumentError, "pool size must be positive" unless size.positive?
+      raise ArgumentError, "unsupported strategy: #{strategy}" unless STRATEGIES.include?(strategy)
+
+      @strategy = strategy
+      @shards = Array.new(size) { Shard.new(backend) }
+      @lock = Thread::Mutex.new
+      @registered = {}
+
+      if block
+        @ready = nil
+        @shards.each { |shard| shard.start(&block) }
+      else
+        @ready = Thread::Queue.new
+        @shards.each { |shard| shard.start { |monitor| @ready << monitor } }
+      end
+
+      @closed = false
+    end
+
+    # Number of selectors in the pool
+    def size
+      @shards.size
+    end
+
+    # The selectors in the pool
+    def selectors
+      @shards.map(&:selector)
+    end
+
+    # Register interest in an IO object with one of the pool's selectors
+    #
+    # @param io [IO] IO object to monitor
+    # @param interest [:r, :w, :rw] I/O readiness we're interested in
+    #
+    # @return [NIO::Monitor]
+    def register(io, interest)
+      key = IO.try_convert(io)
+      raise TypeError, "can't convert #{io.class} into IO" unless key
+
+      shard = @lock.synchronize do
+        raise IOError, "selector pool is closed" if closed?
+        raise ArgumentError, "this IO is already registered with selector pool" if @registered.key?(key)
+
+        shard = shard_for(key)
+        shard.count += 1
+        @registered[key] = shard
+      end
+
+      begin
+        shard.register(io, interest, @ready ? :oneshot : :level)
+      rescue Exception # rubocop:disable Lint/RescueException
+        release(key)
+        raise
+      end
+    end
+
+    # Deregister the given IO object from the pool
+    #
+    # @return [NIO::Monitor, nil] the monitor, if the IO object was registered
+    def deregister(io)
+      shard = release(IO.try_convert(io))
+      shard&.deregister(io)
+    end
+
+    # Is the given IO object registered with the pool?
+    def registered?(io)
+      @lock.synchronize { @registered.key?(IO.try_convert(io)) }
+    end
+
+    # Are there no IO objects registered with the pool?
+    def empty?
+      @lock.synchronize { @registered.empty? }
+    end
+
+    # Wait for the next ready monitor, when no block was given to `#initialize`
+    #
+    # @return [NIO::Monitor, nil] ready monitor, or nil once the pool is closed
+    def pop
+      raise ArgumentError, "ready monitors are passed to the block given to #initialize" unless @ready
+
+      @ready.pop
+    end
+
+    # Enable a monitor returned by `#pop` again, on its selector's thread
+    #
+    # @return [NIO::Monitor]
+    def rearm(monitor)
+      shard = @shards.find { |candidate| candidate.selector.equal?(monitor.selector) }
+      raise ArgumentError, "monitor does not belong to this selector pool" unless shard
+
+      shard.invoke { monitor.rearm }
+    end
+
+    # Stop the pool's threads and close its selectors
+    def close
+      @lock.synchronize do
+        return if @closed
+
+        @closed = true
+        @registered.clear
+      end
+
+      @shards.each(&:stop)
+      @ready&.close
+
+      nil
+    end
+
+    # Is this selector pool closed?
+    def closed?
+      @closed
+    end
+
+    private
+
+    def release(io)
+      @lock.synchronize do
+        shard = @registered.delete(io)
+        shard.count -= 1 if shard
+        shard
+      end
+    end
+
+    def shard_for(io)
+      case @strategy
+      when :descriptor
+        @shards[io.fileno % @shards.size]
+      when :least_loaded
+        @shards.min_by(&:count)
+      end
+    end
+  end
+end
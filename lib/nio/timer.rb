@@ -0,0 +1,70 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+module NIO
+  # Timers are added to selectors with NIO::Selector#add_timer, and selected
+  # along with ready monitors once they expire
+  class Timer
+    attr_reader :selector, :interval
+    attr_accessor :value
+
+    # :nodoc:
+    attr_reader :deadline
+
+    # :nodoc:
+    def initialize(selector, interval, value)
+      @selector = selector
+      @interval = interval
+      @value = value
+      @active = false
+    end
+
+    # Is the timer yet to fire?
+    def active?
+      @active
+    end
+
+    # Seconds until the timer fires, or nil if it isn't pending
+    def remaining
+      return unless @active
+
+      [@deadline - Process.clock_gettime(Process::CLOCK_MONOTONIC), 0.0].max
+    end
+
+    # Stop the timer from firing
+    #
+    # @return [Boolean] whether the timer was still pending
+    def cancel
+      @selector.send(:unschedule, self)
+    end
+
+    # Schedule the timer to fire after the given interval from now, or the
+    # same interval as before, whether or not it's still pending
+    #
+    # @param interval [Numeric, nil] seconds until the timer fires
+    #
+    # @return [NIO::Timer] self
+    def reschedule(interval = nil)
+      unless interval.nil?
+        raise ArgumentError, "time interval must be positive" if interval.negative?
+
+        @interval = interval.to_f
+      end
+
+      @selector.send(:schedule, self)
+      self
+    end
+
+    # :nodoc:
+    def start
+      @deadline = Process.clock_gettime(Process::CLOCK_MONOTONIC) + @interval
+      @active = true
+    end
+
+    # :nodoc:
+    def stop
+      @active = false
+    end
+  end
+end
@@ -0,0 +1,100 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+require "spec_helper"
+require "socket"
+
+RSpec.describe NIO::ByteBuffer::Pool do
+  let(:pooled) { NIO.engine == "libev" }
+
+  it "checks out cleared buffers of the requested capacity" do
+    buffer = described_class.checkout(100)
+    expect(buffer).to be_a NIO::ByteBuffer
+    expect(buffer.capacity).to eq 100
+    expect(buffer.limit).to eq 100
+    expect(buffer.position).to eq 0
+
+    buffer << "x" * 100
+    described_class.checkin(buffer)
+
+    buffer = described_class.checkout(100)
+    expect(buffer.get).to eq "\0" * 100
+    described_class.checkin(buffer)
+  end
+
+  it "reuses memory which was checked in" do
+    skip "#{NIO.engine} doesn't reuse buffer memory" unless pooled
+
+    described_class.checkin(described_class.checkout(1000))
+    hits = described_class.stats[:hits]
+
+    described_class.checkin(described_class.checkout(1024))
+    expect(described_class.stats[:hits]).to eq hits + 1
+  end
+
+  it "empties buffers as they're checked in" do
+    buffer = described_class.checkout(16)
+    buffer << "ohai"
+    expect(described_class.checkin(buffer)).to be_nil
+
+    expect(buffer.capacity).to eq 0
+    expect(buffer.remaining).to eq 0
+    expect { buffer << "x" }.to raise_exception NIO::ByteBuffer::OverflowError
+  end
+
+  it "checks buffers back in after a block" do
+    checked_out = described_class.stats[:checked_out]
+
+    result = described_class.checkout(64) do |buffer|
+      expect(described_class.stats[:checked_out]).to eq checked_out + 1
+      buffer.capacity
+    end
+
+    expect(result).to eq 64
+    expect(described_class.stats[:checked_out]).to eq checked_out
+  end
+
+  it "allocates buffers too large to pool as usual" do
+    buffer = described_class.checkout(described_class::MAX_SIZE + 1)
+    expect(buffer.capacity).to eq described_class::MAX_SIZE + 1
+    described_class.checkin(buffer)
+  end
+
+  it "reports statistics" do
+    expect(described_class.stats.keys).to eq %i[hits misses checked_out retained_bytes]
+  end
+
+  it "doesn't retain memory beyond the limit" do
+    skip "#{NIO.engine} doesn't reuse buffer memory" unless pooled
+
+    limit = described_class.max_retained_bytes
+    described_class.max_retained_bytes = 0
+    buffer = described_class.checkout(4096)
+    retained = described_class.stats[:retained_bytes]
+
+    described_class.checkin(buffer)
+    expect(described_class.stats[:retained_bytes]).to eq retained
+  ensure
+    described_class.max_retained_bytes = limit
+  end
+
+  it "won't check in buffers operations are using" do
+    skip "#{NIO.engine} doesn't share buffer memory with the kernel" unless pooled
+
+    selector = NIO::Selector.new
+    reader, writer = UNIXSocket.pair
+    buffer = described_class.checkout(16)
+    operation = selector.register(reader, :r).submit_read(buffer)
+
+    expect { described_class.checkin(buffer) }.to raise_exception ArgumentError
+
+    writer << "ohai"
+    selector.select(1)
+    expect(operation).to be_completed
+    described_class.checkin(buffer)
+  ensure
+    selector&.close
+    [reader, writer].compact.each(&:close)
+  end
+end
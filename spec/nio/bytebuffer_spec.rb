@@ -7,6 +7,7 @@
 # Copyright, 2020, by Thomas Dziedzic.
 
 require "spec_helper"
+require "tempfile"
 
 RSpec.describe NIO::ByteBuffer do
   let(:capacity)       { 256 }
@@ -159,6 +160,142 @@ RSpec.describe NIO::ByteBuffer do
     end
   end
 
+  describe "#index" do
+    before { skip "#{NIO.engine} doesn't support searching" unless described_class.method_defined?(:read_until) }
+
+    before do
+      bytebuffer << example_string
+      bytebuffer.flip
+    end
+
+    it "finds bytes and strings from the position" do
+      expect(bytebuffer.index(" ".ord)).to eq 7
+      expect(bytebuffer.index("2 3")).to eq 10
+      bytebuffer.get(8)
+      expect(bytebuffer.index(" ".ord)).to eq 9
+    end
+
+    it "starts from the given offset" do
+      expect(bytebuffer.index(" ", 8)).to eq 9
+    end
+
+    it "doesn't search beyond the limit" do
+      bytebuffer.limit = 11
+      expect(bytebuffer.index("2")).to eq 10
+      expect(bytebuffer.index("2 3")).to be_nil
+      expect(bytebuffer.index("3")).to be_nil
+    end
+
+    it "finds matches spanning whole blocks of data" do
+      data = ("x" * 100) + "needle" + ("x" * 100)
+      buffer = described_class.new(data.bytesize)
+      buffer << data
+      buffer.flip
+
+      expect(buffer.index("needle")).to eq 100
+      expect(buffer.index("xn")).to eq 99
+      expect(buffer.index("le")).to eq 104
+      expect(buffer.index("needles")).to be_nil
+      expect(buffer.index("x" * 101)).to be_nil
+    end
+
+    it "raises ArgumentError for bytes out of range" do
+      expect { bytebuffer.index(256) }.to raise_error(ArgumentError)
+    end
+  end
+
+  describe "#read_until" do
+    before { skip "#{NIO.engine} doesn't support searching" unless described_class.method_defined?(:read_until) }
+
+    it "reads up to and including the delimiter" do
+      bytebuffer << "GET / HTTP/1.1\r\nHost: example.com\r\n"
+      bytebuffer.flip
+
+      expect(bytebuffer.read_until(" ")).to eq "GET "
+      expect(bytebuffer.read_until(" ", chomp: true)).to eq "/"
+      expect(bytebuffer.read_until("\r\n", chomp: true)).to eq "HTTP/1.1"
+      expect(bytebuffer.read_until("\r\n")).to eq "Host: example.com\r\n"
+      expect(bytebuffer.remaining).to eq 0
+    end
+
+    it "returns nil without moving if the delimiter hasn't arrived yet" do
+      bytebuffer << example_string
+      bytebuffer.flip
+
+      expect(bytebuffer.read_until("!")).to be_nil
+      expect(bytebuffer.position).to eq 0
+    end
+  end
+
+  describe "#read_line" do
+    before { skip "#{NIO.engine} doesn't support searching" unless described_class.method_defined?(:read_line) }
+
+    it "reads whole lines" do
+      bytebuffer << "first\nsecond\r\nthird"
+      bytebuffer.flip
+
+      expect(bytebuffer.read_line).to eq "first\n"
+      expect(bytebuffer.read_line(chomp: true)).to eq "second"
+      expect(bytebuffer.read_line).to be_nil
+      expect(bytebuffer.get).to eq "third"
+    end
+  end
+
+  describe "#view" do
+    before { skip "#{NIO.engine} doesn't support views" unless described_class.method_defined?(:view) }
+
+    before do
+      bytebuffer << example_string
+      bytebuffer.flip
+    end
+
+    it "views data without copying it out of the buffer" do
+      view = bytebuffer.view(7)
+      expect(view).to be_a NIO::ByteBuffer::View
+      expect(view).to be_frozen
+      expect(view.size).to eq 7
+      expect(view.to_s).to eq "Testing"
+      expect(view).to eq "Testing"
+      expect(bytebuffer.position).to eq 7
+    end
+
+    it "views all remaining data if no length is given" do
+      bytebuffer.get(8)
+      expect(bytebuffer.view).to eq "1 2 3..."
+    end
+
+    it "searches the data" do
+      view = bytebuffer.view
+      expect(view.index("2")).to eq 10
+      expect(view.index("2", 11)).to be_nil
+      expect(view.getbyte(0)).to eq "T".ord
+      expect(view.getbyte(-1)).to eq ".".ord
+      expect(view.getbyte(100)).to be_nil
+      expect(view).to be_start_with "Test"
+    end
+
+    it "keeps its data when the buffer is written to" do
+      view = bytebuffer.view
+      bytebuffer.clear
+      bytebuffer << "x" * example_string.length
+      expect(view).to eq example_string
+
+      bytebuffer.flip
+      expect(bytebuffer.get).to eq "x" * example_string.length
+    end
+
+    it "keeps its data when the buffer is compacted" do
+      view = bytebuffer.view(8)
+      bytebuffer.compact
+      expect(view).to eq "Testing "
+      expect(bytebuffer.position).to eq 8
+    end
+
+    it "raises NIO::ByteBuffer::UnderflowError if there is not enough data in the buffer" do
+      expect { bytebuffer.view(example_string.length + 1) }.to raise_error(NIO::ByteBuffer::UnderflowError)
+    end
+  end
+
   describe "#[]" do
     it "obtains bytes at a given index without altering position" do
       bytebuffer << example_string
@@ -291,6 +428,73 @@ RSpec.describe NIO::ByteBuffer do
     end
   end
 
+  describe ".map" do
+    before { skip "#{NIO.engine} doesn't support memory-mapped buffers" unless described_class.respond_to?(:map) }
+
+    let(:file) do
+      Tempfile.new("nio4r").tap do |tempfile|
+        tempfile.write("0123456789" * 1000)
+        tempfile.flush
+      end
+    end
+
+    after { file.close! }
+
+    it "maps a whole file, ready to be read" do
+      buffer = described_class.map(file)
+
+      expect(buffer).to be_mapped
+      expect(buffer.size).to eq 10_000
+      expect(buffer.remaining).to eq 10_000
+      expect(buffer.get(10)).to eq "0123456789"
+    end
+
+    it "maps part of a file at an unaligned offset" do
+      buffer = described_class.map(file.path, 4103, 5)
+      expect(buffer.get).to eq "34567"
+    end
+
+    it "raises ArgumentError if the region extends past the end of the file" do
+      expect { described_class.map(file.path, 9996, 5) }.to raise_error(ArgumentError)
+      expect { described_class.map(file.path, 0, 10_001, :rw) }.to raise_error(ArgumentError)
+      expect(described_class.map(file.path, 9996, 4).get).to eq "6789"
+    end
+
+    it "raises IOError when writing to a read-only mapping" do
+      buffer = described_class.map(file)
+      buffer.clear
+      expect { buffer << "x" }.to raise_error(IOError)
+    end
+
+    it "writes through to the file in :rw mode" do
+      buffer = described_class.map(file.path, 0, 4, :rw)
+      buffer.clear
+      buffer << "abcd"
+
+      expect(File.binread(file.path, 6)).to eq "abcd45"
+    end
+
+    it "maps anonymous memory" do
+      buffer = described_class.map(nil, 0, 4096, huge_pages: true)
+      buffer.clear
+      buffer << example_string
+      buffer.flip
+
+      expect(buffer.get).to eq example_string
+    end
+
+    it "takes advice about how the mapping will be used" do
+      buffer = described_class.map(file)
+      expect(buffer.advise(:sequential)).to eq buffer
+      expect { buffer.advise(:bogus) }.to raise_error(ArgumentError)
+      expect { described_class.new(16).advise(:willneed) }.to raise_error(IOError)
+    end
+
+    it "isn't mapped for ordinary buffers" do
+      expect(bytebuffer).not_to be_mapped
+    end
+  end
+
   context "I/O" do
     let(:addr)   { "127.0.0.1" }
     let(:server) { TCPServer.new(addr, 0) }
@@ -356,5 +560,105 @@ RSpec.describe NIO::ByteBuffer do
         expect { bytebuffer.write_to(peer) }.to raise_error(NIO::ByteBuffer::UnderflowError)
       end
     end
+
+    describe ".gvl_threshold" do
+      after { described_class.gvl_threshold = 65_536 }
+
+      it "defaults to 64 KiB" do
+        expect(described_class.gvl_threshold).to eq 65_536
+      end
+
+      it "raises ArgumentError if given a negative threshold" do
+        expect { described_class.gvl_threshold = -1 }.to raise_error(ArgumentError)
+      end
+
+      # Transfers always set the IO non-blocking, so there's no way to make one
+      # wait long enough for a spec to see other threads running meanwhile
+      it "makes the same transfers once past the threshold" do
+        described_class.gvl_threshold = 0
+
+        bytebuffer << example_string
+        bytebuffer.flip
+        expect(bytebuffer.write_to(client)).to eq example_string.length
+
+        buffer = described_class.new(capacity)
+        expect(buffer.read_from(peer)).to eq example_string.length
+        expect(buffer.flip.get).to eq example_string
+
+        buffers = [described_class.new(4), described_class.new(4)]
+        buffers.each { |buffer| buffer << "abcd" }.each(&:flip)
+        expect(described_class.write_all_to(client, buffers)).to eq 8
+        expect(described_class.read_all_from(peer, [described_class.new(capacity)])).to eq 8
+      end
+    end
+
+    describe ".write_all_to" do
+      before { skip "#{NIO.engine} doesn't support vectored I/O" unless described_class.respond_to?(:write_all_to) }
+
+      let(:buffers) { Array.new(3) { described_class.new(capacity) } }
+
+      it "writes the remaining data of every buffer" do
+        buffers.each_with_index do |buffer, index|
+          buffer << "#{index}:#{example_string}"
+          buffer.flip
+        end
+        buffers[1].get(2)
+
+        expect(described_class.write_all_to(client, buffers)).to eq example_string.length * 3 + 4
+        expect(buffers.map(&:remaining)).to eq [0, 0, 0]
+
+        client.close
+        expect(peer.read).to eq "0:#{example_string}#{example_string}2:#{example_string}"
+      end
+
+      it "advances each buffer past a partial write" do
+        client.setsockopt(Socket::SOL_SOCKET, Socket::SO_SNDBUF, 4096)
+        buffers = Array.new(64) { described_class.new(16_384).tap { |buffer| buffer << "X" * 16_384 }.flip }
+
+        written = described_class.write_all_to(client, buffers)
+        expect(written).to be < 16_384 * 64
+        expect(buffers.sum(&:remaining)).to eq 16_384 * 64 - written
+        expect(buffers.map(&:position).sort.reverse).to eq buffers.map(&:position)
+      end
+
+      it "raises NIO::ByteBuffer::UnderflowError if every buffer is out of data" do
+        expect { described_class.write_all_to(client, buffers.each(&:flip)) }.to raise_error(NIO::ByteBuffer::UnderflowError)
+      end
+    end
+
+    describe ".read_all_from" do
+      before { skip "#{NIO.engine} doesn't support vectored I/O" unless described_class.respond_to?(:read_all_from) }
+
+      let(:buffers) { [described_class.new(4), described_class.new(capacity)] }
+
+      it "fills the buffers in order" do
+        client.write(example_string)
+        expect(described_class.read_all_from(peer, buffers)).to eq example_string.length
+
+        expect(buffers.map { |buffer| buffer.flip.get }).to eq [example_string[0, 4], example_string[4..]]
+      end
+
+      it "skips buffers which are already full" do
+        buffers.first << "XXXX"
+        client.write(example_string)
+
+        expect(described_class.read_all_from(peer, buffers)).to eq example_string.length
+        expect(buffers.last.flip.get).to eq example_string
+      end
+
+      it "returns 0 if no data is available" do
+        expect(described_class.read_all_from(peer, buffers)).to eq 0
+      end
+
+      it "returns nil at end of file" do
+        client.close
+        expect(described_class.read_all_from(peer, buffers)).to be_nil
+      end
+
+      it "raises NIO::ByteBuffer::OverflowError if every buffer is full" do
+        buffers.each { |buffer| buffer << "X" * buffer.capacity }
+        expect { described_class.read_all_from(peer, buffers) }.to raise_error(NIO::ByteBuffer::OverflowError)
+      end
+    end
   end
 end
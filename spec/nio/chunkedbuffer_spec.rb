@@ -0,0 +1,120 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+require "spec_helper"
+require "socket"
+
+RSpec.describe "NIO::ChunkedBuffer" do
+  let(:chunk_size)     { NIO::ChunkedBuffer::CHUNK_SIZE }
+  let(:example_string) { "Testing 1 2 3..." }
+  let(:pair)           { UNIXSocket.pair }
+  let(:reader)         { pair.first }
+  let(:writer)         { pair.last }
+
+  subject(:buffer) { NIO::ChunkedBuffer.new }
+
+  before { skip "#{NIO.engine} doesn't support chunked buffers" unless defined?(NIO::ChunkedBuffer) }
+
+  after { pair.each(&:close) }
+
+  it "starts out empty" do
+    expect(buffer.remaining).to eq 0
+    expect(buffer.capacity).to eq 0
+  end
+
+  it "grows a chunk at a time" do
+    buffer << "x" * (chunk_size + 1)
+
+    expect(buffer.remaining).to eq chunk_size + 1
+    expect(buffer.capacity).to eq chunk_size * 2
+  end
+
+  it "reads data back out across chunks" do
+    buffer << "x" * (chunk_size - 4)
+    buffer << example_string
+
+    expect(buffer.get(chunk_size - 4)).to eq "x" * (chunk_size - 4)
+    expect(buffer.get(4)).to eq example_string[0, 4]
+    expect(buffer.get).to eq example_string[4..]
+    expect(buffer.remaining).to eq 0
+  end
+
+  it "raises NIO::ByteBuffer::UnderflowError if there isn't enough data" do
+    buffer << example_string
+    expect { buffer.get(example_string.length + 1) }.to raise_error(NIO::ByteBuffer::UnderflowError)
+  end
+
+  describe "#read_from" do
+    it "reads everything available, growing as needed" do
+      writer << ("x" * chunk_size * 3)
+
+      expect(buffer.read_from(reader)).to eq chunk_size * 3
+      expect(buffer.get).to eq "x" * chunk_size * 3
+    end
+
+    it "fills the last chunk first" do
+      buffer << example_string
+      writer << example_string
+
+      expect(buffer.read_from(reader)).to eq example_string.length
+      expect(buffer.capacity).to eq chunk_size
+      expect(buffer.get).to eq example_string * 2
+    end
+
+    it "returns 0 if no data is available" do
+      expect(buffer.read_from(reader)).to eq 0
+      expect(buffer.capacity).to eq 0
+    end
+
+    it "returns nil at end of file" do
+      writer.close
+      expect(buffer.read_from(reader)).to be_nil
+    end
+  end
+
+  describe "#write_to" do
+    it "writes data from every chunk" do
+      data = Array.new(chunk_size * 2 + 100) { |i| (i % 256).chr }.join
+      buffer << data
+
+      expect(buffer.write_to(writer)).to eq data.bytesize
+      expect(buffer.remaining).to eq 0
+      expect(reader.read_nonblock(data.bytesize * 2)).to eq data
+    end
+
+    it "raises NIO::ByteBuffer::UnderflowError if the buffer is empty" do
+      expect { buffer.write_to(writer) }.to raise_error(NIO::ByteBuffer::UnderflowError)
+    end
+  end
+
+  describe "#compact" do
+    it "lets go of chunks which have been read" do
+      buffer << "x" * (chunk_size * 2 + 1)
+      buffer.get(chunk_size * 2)
+      buffer.compact
+
+      expect(buffer.capacity).to eq chunk_size
+      expect(buffer.get).to eq "x"
+    end
+  end
+
+  describe "#clear" do
+    it "lets go of every chunk" do
+      buffer << "x" * chunk_size * 2
+      buffer.clear
+
+      expect(buffer.remaining).to eq 0
+      expect(buffer.capacity).to eq 0
+    end
+  end
+
+  it "returns chunks to the pool" do
+    in_use = NIO::ChunkedBuffer.pool[:chunks_in_use]
+    buffer << "x" * chunk_size * 2
+    buffer.clear
+
+    expect(NIO::ChunkedBuffer.pool[:chunks_in_use]).to eq in_use
+    expect(NIO::ChunkedBuffer.pool[:chunk_size]).to eq chunk_size
+  end
+end
@@ -0,0 +1,101 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+require "spec_helper"
+require "tempfile"
+require "io/wait"
+
+RSpec.describe "NIO::FileRegion" do
+  let(:contents) { "Testing 1 2 3..." }
+  let(:tempfile) { Tempfile.new("nio4r").tap { |file| file.write(contents) }.tap(&:flush) }
+  let(:pair)     { UNIXSocket.pair }
+  let(:reader)   { pair.first }
+  let(:writer)   { pair.last }
+
+  before { skip "#{NIO.engine} doesn't support file regions" unless defined?(NIO::FileRegion) }
+
+  after { pair.each(&:close) }
+  after { tempfile.close! }
+
+  it "writes the file to a socket" do
+    region = NIO::FileRegion.new(tempfile.path)
+    expect(region.remaining).to eq contents.bytesize
+
+    expect(region.write_to(writer)).to eq contents.bytesize
+    expect(region.offset).to eq contents.bytesize
+    expect(region.remaining).to eq 0
+    expect(reader.read_nonblock(64)).to eq contents
+  ensure
+    region&.close
+  end
+
+  it "writes part of the file" do
+    region = NIO::FileRegion.new(tempfile.to_io, 8, 5)
+    expect(region.write_to(writer)).to eq 5
+    expect(reader.read_nonblock(64)).to eq "1 2 3"
+  end
+
+  it "writes the file to a pipe" do
+    pipe = IO.pipe
+    region = NIO::FileRegion.new(tempfile.path)
+
+    expect(region.write_to(pipe.last)).to eq contents.bytesize
+    expect(pipe.first.read_nonblock(64)).to eq contents
+  ensure
+    region&.close
+    pipe.each(&:close)
+  end
+
+  it "writes the rest once the socket is writable again" do
+    tempfile.write("X" * 1_048_576)
+    tempfile.flush
+    region = NIO::FileRegion.new(tempfile.path)
+    selector = NIO::Selector.new
+    selector.register(writer, :w)
+
+    writes = []
+    received = 0
+    until region.remaining.zero?
+      expect(selector.select(1)).not_to be_nil
+      writes << region.write_to(writer)
+      received += reader.read_nonblock(65_536).bytesize while reader.wait_readable(0)
+    end
+
+    expect(writes.size).to be > 1
+    expect(received).to eq contents.bytesize + 1_048_576
+  ensure
+    region&.close
+    selector&.close
+  end
+
+  it "raises NIO::ByteBuffer::UnderflowError once the region has been written" do
+    region = NIO::FileRegion.new(tempfile.to_io, contents.bytesize)
+    expect { region.write_to(writer) }.to raise_error(NIO::ByteBuffer::UnderflowError)
+  end
+
+  it "raises EOFError if the file was truncated" do
+    region = NIO::FileRegion.new(tempfile.to_io)
+    tempfile.truncate(0)
+
+    expect { region.write_to(writer) }.to raise_error(EOFError)
+  end
+
+  it "raises ArgumentError if the offset is outside the file" do
+    expect { NIO::FileRegion.new(tempfile.to_io, contents.bytesize + 1) }.to raise_error(ArgumentError)
+  end
+
+  it "raises ArgumentError if the length is past the end of the file" do
+    expect { NIO::FileRegion.new(tempfile.to_io, 4, contents.bytesize - 3) }.to raise_error(ArgumentError)
+    expect(NIO::FileRegion.new(tempfile.to_io, 4, contents.bytesize - 4).remaining).to eq contents.bytesize - 4
+  end
+
+  it "only closes files it opened" do
+    NIO::FileRegion.new(tempfile.to_io).close
+    expect(tempfile).not_to be_closed
+
+    region = NIO::FileRegion.new(tempfile.path)
+    region.close
+    expect(region.io).to be_closed
+  end
+end
@@ -148,6 +148,161 @@ RSpec.describe NIO::Monitor do
     end
   end
 
+  describe "#mode=" do
+    it "defaults to level-triggered" do
+      expect(monitor.mode).to eq(:level)
+      expect(selector.select(0)).to include(monitor)
+      expect(selector.select(0)).to include(monitor)
+    end
+
+    it "selects one-shot monitors once until they are rearmed" do
+      monitor.mode = :oneshot
+      expect(monitor.mode).to eq(:oneshot)
+
+      expect(selector.select(0)).to include(monitor)
+      expect(monitor).to be_writable
+      expect(selector.select(0)).to be_nil
+
+      monitor.rearm
+      expect(selector.select(0)).to include(monitor)
+    end
+
+    it "waits out the timeout once a one-shot monitor has been selected" do
+      monitor.mode = :oneshot
+      expect(selector.select(0)).to include(monitor)
+
+      started_at = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      expect(selector.select(0.2)).to be_nil
+      expect(Process.clock_gettime(Process::CLOCK_MONOTONIC) - started_at).to be >= 0.15
+    end
+
+    it "selects edge-triggered monitors when the IO becomes ready" do
+      skip "#{selector.backend} is level-triggered" unless [:epoll, :kqueue].include?(selector.backend)
+
+      pipe_reader, pipe_writer = IO.pipe
+      edge = selector.register(pipe_reader, :r)
+      edge.mode = :edge
+
+      pipe_writer << "ohai"
+      expect(selector.select(0)).to eq [edge]
+      expect(selector.select(0)).to be_nil
+
+      pipe_writer << "thar"
+      expect(selector.select(0)).to eq [edge]
+    ensure
+      pipe_reader&.close
+      pipe_writer&.close
+    end
+
+    it "raises ArgumentError if given a bogus mode" do
+      expect { monitor.mode = :derp }.to raise_error(ArgumentError)
+    end
+
+    it "raises EOFError if the mode is changed after the monitor is closed" do
+      monitor.close
+      expect { monitor.mode = :oneshot }.to raise_error(EOFError)
+      expect { monitor.rearm }.to raise_error(EOFError)
+    end
+  end
+
+  describe "#read_into" do
+    let(:pair)   { UNIXSocket.pair }
+    let(:buffer) { NIO::ByteBuffer.new(8) }
+    let(:source) { selector.register(pair.first, :r) }
+
+    before { skip "#{NIO.engine} doesn't support read_into" unless NIO::Monitor.method_defined?(:read_into) }
+    after  { pair.each(&:close) }
+
+    it "reads until the IO would block" do
+      expect(source.read_into(buffer)).to eq 0
+
+      pair.last << "ohai"
+      expect(source.read_into(buffer)).to eq 4
+      expect(buffer.flip.get).to eq "ohai"
+    end
+
+    it "reads what the IO has buffered already first" do
+      pair.last << "ohai\nthere"
+      expect(pair.first.gets).to eq "ohai\n"
+
+      expect(source.read_into(buffer)).to eq 5
+      expect(buffer.flip.get).to eq "there"
+    end
+
+    it "stops once the buffer is full" do
+      pair.last << "x" * 12
+      source.buffer = buffer
+      expect(source.read_into).to eq 8
+      expect { source.read_into }.to raise_error(NIO::ByteBuffer::OverflowError)
+    end
+
+    it "returns the data before end of file, then nil" do
+      pair.last << "ohai"
+      pair.last.close
+      expect(source.read_into(buffer)).to eq 4
+      expect(source.read_into(buffer)).to be_nil
+    end
+
+    it "reads from every ready monitor with a buffer" do
+      source.buffer = buffer
+      pair.last << "ohai"
+
+      ready = selector.select(1)
+      expect(selector.read_ready(ready)).to eq(source => 4)
+      expect(selector.read_ready(ready)).to eq(source => 0)
+    end
+  end
+
+  describe "#idle_timeout=" do
+    let(:pair)   { UNIXSocket.pair }
+    let(:source) { selector.register(pair.first, :r) }
+
+    before { skip "#{NIO.engine} doesn't support idle timeouts" unless NIO::Monitor.method_defined?(:idle_timeout=) }
+    after  { pair.each(&:close) }
+
+    it "is off by default" do
+      expect(source.idle_timeout).to be_nil
+    end
+
+    it "selects the monitor as :timeout once it has been idle" do
+      source.idle_timeout = 0.05
+      expect(source.idle_timeout).to eq 0.05
+      expect(selector.select(0)).to be_nil
+
+      expect(selector.select(1)).to eq [source]
+      expect(source.readiness).to eq :timeout
+      expect(source).not_to be_readable
+
+      # Only once, until it's selected again
+      expect(selector.select(0.1)).to be_nil
+    end
+
+    it "starts again whenever the monitor is selected" do
+      source.idle_timeout = 0.2
+
+      sleep 0.1
+      pair.last << "ohai"
+      expect(selector.select(1)).to eq [source]
+      expect(source.readiness).to eq :r
+      pair.first.read_nonblock(4)
+
+      # Past the original timeout, but not since the monitor was selected
+      expect(selector.select(0.15)).to be_nil
+      expect(selector.select(1)).to eq [source]
+      expect(source.readiness).to eq :timeout
+    end
+
+    it "can be turned off" do
+      source.idle_timeout = 0.01
+      source.idle_timeout = nil
+      expect(selector.select(0.05)).to be_nil
+    end
+
+    it "raises ArgumentError unless positive" do
+      expect { source.idle_timeout = 0 }.to raise_error(ArgumentError)
+    end
+  end
+
   describe "#close" do
     it "closes" do
       expect(monitor).not_to be_closed
@@ -0,0 +1,260 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+require "spec_helper"
+require "socket"
+
+RSpec.describe NIO::Operation do
+  let(:pair)   { UNIXSocket.pair }
+  let(:reader) { pair.first }
+  let(:writer) { pair.last }
+
+  let(:backend)  { nil }
+  let(:options)  { {} }
+  let(:selector) { NIO::Selector.new(backend, **options) }
+  let(:monitor)  { selector.register(reader, :r) }
+  let(:buffer)   { NIO::ByteBuffer.new(16) }
+
+  before { skip "#{NIO.engine} doesn't support operations" unless NIO::Monitor.method_defined?(:submit_read) }
+
+  after { selector.close }
+  after { pair.each(&:close) }
+
+  shared_examples "an operation" do
+    it "reads into the buffer once data arrives" do
+      monitor.interests = nil
+      operation = monitor.submit_read(buffer)
+      expect(operation.type).to eq :read
+      expect(operation.io).to equal reader
+      expect(selector.select(0)).to be_nil
+      expect(operation).not_to be_completed
+
+      writer << "ohai"
+      expect(selector.select(1)).to eq [operation]
+      expect(operation).to be_completed
+      expect(operation.result).to eq 4
+      expect(buffer.position).to eq 4
+    end
+
+    it "writes from the buffer" do
+      buffer << "ohai"
+      buffer.flip
+
+      operation = selector.register(writer, :w).submit_write(buffer)
+      expect(operation.type).to eq :write
+
+      selected = selector.select(1)
+      expect(selected).to include operation
+      expect(operation.result).to eq 4
+      expect(buffer.remaining).to eq 0
+      expect(reader.read_nonblock(4)).to eq "ohai"
+    end
+
+    it "yields completed operations" do
+      monitor.interests = nil
+      operation = monitor.submit_read(buffer)
+      writer << "ohai"
+
+      selected = []
+      expect(selector.select(1) { |ready| selected << ready }).to eq 1
+      expect(selected).to eq [operation]
+    end
+
+    it "reads nothing at end of file" do
+      monitor.interests = nil
+      operation = monitor.submit_read(buffer)
+      writer.close
+
+      expect(selector.select(1)).to eq [operation]
+      expect(operation.result).to eq 0
+    end
+
+    it "cancels operations when the IO is deregistered" do
+      operation = monitor.submit_read(buffer)
+      selector.deregister(reader)
+
+      expect(selector.select(1)).to eq [operation]
+      expect { operation.result }.to raise_exception Errno::ECANCELED
+    end
+
+    it "receives data whenever it arrives" do
+      monitor.interests = nil
+      operation = monitor.submit_receive
+      expect(operation.type).to eq :receive
+      expect(selector.select(0)).to be_nil
+      expect(operation.result).to be_nil
+
+      writer << "ohai"
+      expect(selector.select(1)).to eq [operation]
+      expect(operation.data).to eq "ohai"
+      expect(operation.result).to eq 4
+      expect(operation).not_to be_completed
+
+      writer << "again"
+      expect(selector.select(1)).to eq [operation]
+      expect(operation.data).to eq "again"
+      expect(selector.buffer_pool[:in_use]).to eq 0
+    end
+
+    it "receives more than fits in the buffer pool" do
+      options.update(buffer_count: 2, buffer_size: 4)
+      monitor.interests = nil
+      operation = monitor.submit_receive
+
+      writer << "x" * 64
+      received = String.new
+      received << operation.data while received.size < 64 && selector.select(1)
+
+      expect(received).to eq "x" * 64
+    end
+
+    it "completes receives at end of stream" do
+      monitor.interests = nil
+      operation = monitor.submit_receive
+      writer.close
+
+      expect(selector.select(1)).to eq [operation]
+      expect(operation).to be_completed
+      expect(operation.result).to eq 0
+      expect(operation.data).to eq ""
+    end
+
+    it "cancels receives when the IO is deregistered" do
+      operation = monitor.submit_receive
+      selector.deregister(reader)
+
+      expect(selector.select(1)).to eq [operation]
+      expect { operation.result }.to raise_exception Errno::ECANCELED
+    end
+
+    context "zero-copy writes" do
+      let(:server) { TCPServer.new("127.0.0.1", 0) }
+      let(:client) { TCPSocket.new("127.0.0.1", server.local_address.ip_port) }
+      let(:peer)   { server.accept }
+      let(:buffer) { NIO::ByteBuffer.new(65_536) }
+
+      before { buffer << "x" * buffer.capacity }
+      before { buffer.flip }
+
+      after { [client, peer, server].each(&:close) }
+
+      it "completes once the kernel has let go of the buffer" do
+        client_monitor = selector.register(client, :w)
+        client_monitor.interests = nil
+        operation = client_monitor.submit_write(buffer, zerocopy: true)
+
+        # Written once the socket is writable, then completed by the kernel
+        20.times { operation.completed? ? break : selector.select(0.1) }
+        expect(operation).to be_completed
+        expect(operation.result).to be > 0
+        expect(buffer.position).to eq operation.result
+        expect([true, false]).to include operation.zerocopy?
+
+        received = String.new
+        received << peer.readpartial(65_536) while received.size < operation.result
+        expect(received).to eq "x" * operation.result
+      end
+
+      it "waits for the kernel to let go of the buffer once the IO is deregistered" do
+        client_monitor = selector.register(client, :w)
+        client_monitor.interests = nil
+        operation = client_monitor.submit_write(buffer, zerocopy: true)
+
+        selector.select(1)
+        selector.deregister(client)
+
+        20.times { operation.completed? ? break : selector.select(0.1) }
+        expect(operation).to be_completed
+        expect(operation.result).to eq buffer.position
+      end
+
+      it "writes as usual to IO objects without zero-copy support" do
+        operation = selector.register(writer, :w).submit_write(buffer, zerocopy: true)
+
+        expect(selector.select(1)).to include operation
+        expect(operation.result).to be > 0
+        expect(operation).not_to be_zerocopy
+      end
+    end
+
+    context "accepting connections" do
+      let(:server) { TCPServer.new("127.0.0.1", 0) }
+      let(:clients) { [] }
+      let(:accepted) { [] }
+
+      after { (accepted + clients).each(&:close) }
+      after { server.close }
+
+      it "accepts connections whenever they arrive" do
+        operation = selector.accept_loop(server, batch: 2)
+        expect(operation.type).to eq :accept
+        expect(selector.select(0)).to be_nil
+
+        3.times { clients << TCPSocket.new("127.0.0.1", server.local_address.ip_port) }
+        while accepted.size < 3 && selector.select(1)
+          expect(operation.result).to eq operation.data.size
+          accepted.concat(operation.data)
+        end
+
+        expect(accepted.size).to eq 3
+        expect(accepted.map(&:class).uniq).to eq [TCPSocket]
+
+        accepted.first.write "ohai"
+        expect(clients.map { |client| client.read_nonblock(4, exception: false) }).to include "ohai"
+      end
+
+      it "cancels accepts when the server is deregistered" do
+        operation = selector.accept_loop(server)
+        selector.deregister(server)
+
+        expect(selector.select(1)).to eq [operation]
+        expect { operation.result }.to raise_exception Errno::ECANCELED
+      end
+    end
+  end
+
+  context "with the default backend" do
+    include_examples "an operation"
+  end
+
+  context "with io_uring" do
+    let(:backend) { :io_uring }
+
+    before { skip "io_uring is unavailable" unless NIO::Selector.backends.include?(:io_uring) }
+
+    include_examples "an operation"
+  end
+
+  it "raises OverflowError if the buffer is full" do
+    buffer << "x" * buffer.capacity
+    expect { monitor.submit_read(buffer) }.to raise_exception NIO::ByteBuffer::OverflowError
+  end
+
+  it "reports the buffer pool" do
+    options.update(buffer_count: 4, buffer_size: 1024)
+    expect(selector.buffer_pool).to eq(buffers: 4, buffer_size: 1024, in_use: 0, exhausted: 0)
+  end
+
+  it "rejects buffer pools which aren't a power of 2" do
+    expect { NIO::Selector.new(nil, buffer_count: 3) }.to raise_exception ArgumentError
+  end
+
+  it "registers buffers if the backend supports it" do
+    expect(selector.register_buffers([buffer])).to eq(selector.backend == :io_uring)
+    expect { selector.register_buffers([:buffer]) }.to raise_exception TypeError
+  end
+
+  it "only accepts connections from sockets" do
+    pipe = IO.pipe
+    expect { selector.accept_loop(pipe.first) }.to raise_exception TypeError
+    expect(selector).not_to be_registered(pipe.first)
+  ensure
+    pipe.each(&:close)
+  end
+
+  it "raises EOFError if the monitor is closed" do
+    monitor.close
+    expect { monitor.submit_read(buffer) }.to raise_exception EOFError
+  end
+end
@@ -0,0 +1,133 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+require "spec_helper"
+require "timeout"
+
+RSpec.describe NIO::SelectorPool do
+  let(:pipes) { Array.new(4) { IO.pipe } }
+  let(:readers) { pipes.map(&:first) }
+  let(:writers) { pipes.map(&:last) }
+
+  subject(:pool) { described_class.new(2) }
+
+  after { pipes.flatten.each(&:close) }
+  after { pool.close }
+
+  context "#initialize" do
+    it "starts a selector per shard" do
+      expect(pool.size).to eq 2
+      expect(pool.selectors.uniq.size).to eq 2
+    end
+
+    it "raises ArgumentError if given a bogus strategy" do
+      expect { described_class.new(1, strategy: :derp) }.to raise_exception ArgumentError
+    end
+  end
+
+  context "register" do
+    it "shares IO objects out by descriptor" do
+      monitors = readers.map { |io| pool.register(io, :r) }
+
+      monitors.zip(readers).each do |monitor, io|
+        expect(monitor.selector).to equal pool.selectors[io.fileno % 2]
+      end
+    end
+
+    it "shares IO objects out to the least loaded selector" do
+      pool = described_class.new(2, strategy: :least_loaded)
+      monitors = readers.map { |io| pool.register(io, :r) }
+
+      expect(monitors.count { |monitor| monitor.selector.equal?(pool.selectors.first) }).to eq 2
+    ensure
+      pool&.close
+    end
+
+    it "raises ArgumentError if an IO object is already registered" do
+      pool.register(readers.first, :r)
+      expect { pool.register(readers.first, :r) }.to raise_exception ArgumentError
+    end
+
+    it "raises IOError if the pool is closed" do
+      pool.close
+      expect { pool.register(readers.first, :r) }.to raise_exception IOError
+    end
+  end
+
+  it "deregisters IO objects" do
+    monitor = pool.register(readers.first, :r)
+    expect(pool).to be_registered(readers.first)
+
+    expect(pool.deregister(readers.first)).to eq monitor
+    expect(pool).not_to be_registered(readers.first)
+    expect(pool).to be_empty
+    expect(monitor).to be_closed
+  end
+
+  context "pop" do
+    it "returns ready monitors from every selector" do
+      monitors = readers.map { |io| pool.register(io, :r) }
+      writers.each { |io| io << "ohai" }
+
+      ready = Timeout.timeout(2) { Array.new(4) { pool.pop } }
+      expect(ready.sort_by(&:object_id)).to eq monitors.sort_by(&:object_id)
+    end
+
+    it "queues monitors once until they are rearmed" do
+      monitor = pool.register(readers.first, :r)
+      writers.first << "ohai"
+
+      expect(Timeout.timeout(2) { pool.pop }).to equal monitor
+      pool.rearm(monitor)
+      expect(Timeout.timeout(2) { pool.pop }).to equal monitor
+    end
+
+    it "returns nil once the pool is closed" do
+      thread = Thread.new { pool.pop }
+      pool.close
+
+      expect(Timeout.timeout(2) { thread.value }).to be_nil
+    end
+  end
+
+  it "passes ready monitors to the given block" do
+    ready = Thread::Queue.new
+    pool = described_class.new(2) { |monitor| ready << monitor.io.read_nonblock(4) }
+
+    readers.each { |io| pool.register(io, :r) }
+    writers.each { |io| io << "ohai" }
+
+    expect(Timeout.timeout(2) { Array.new(4) { ready.pop } }).to eq ["ohai"] * 4
+  ensure
+    pool&.close
+  end
+
+  it "raises what the given block raised once its selector's thread has stopped" do
+    report_on_exception = Thread.report_on_exception
+    Thread.report_on_exception = false
+
+    raised = Thread::Queue.new
+    pool = described_class.new(1) do
+      raised << true
+      raise ArgumentError, "derp"
+    end
+
+    pool.register(readers.first, :r)
+    writers.first << "ohai"
+    Timeout.timeout(2) { raised.pop }
+
+    expect { Timeout.timeout(2) { pool.register(readers.last, :r) } }.to raise_exception(ArgumentError, "derp")
+  ensure
+    Thread.report_on_exception = report_on_exception
+    pool&.close
+  end
+
+  it "closes" do
+    selectors = pool.selectors
+    pool.close
+
+    expect(pool).to be_closed
+    selectors.each { |selector| expect(selector).to be_closed }
+  end
+end
@@ -96,6 +96,87 @@ RSpec.describe NIO::Selector do
     end.not_to raise_error
   end
 
+  it "returns the monitor when deregistering closed IO objects" do
+    monitor = subject.register(reader, :r)
+    reader.close
+
+    expect(subject).to be_registered(reader)
+    expect(subject.deregister(reader)).to eq monitor
+    expect(subject).not_to be_registered(reader)
+  end
+
+  it "allows registering an IO object which reuses the descriptor of a closed one" do
+    monitor = subject.register(reader, :r)
+    descriptor = reader.fileno
+    reader.close
+
+    reused = IO.pipe.find { |io| io.fileno == descriptor }
+    skip "descriptor was not reused" unless reused
+
+    new_monitor = subject.register(reused, :r)
+    expect(subject).to be_registered(reused)
+    expect(new_monitor).not_to eq monitor
+  end
+
+  it "doesn't mistake an IO object which reuses a closed one's descriptor for it" do
+    monitor = subject.register(reader, :r)
+    descriptor = reader.fileno
+    reader.close
+
+    reused = IO.pipe.find { |io| io.fileno == descriptor }
+    skip "descriptor was not reused" unless reused
+
+    expect(subject).not_to be_registered(reused)
+    expect(subject.deregister(reused)).to be_nil
+    expect(monitor).not_to be_closed
+
+    monitor.close
+    expect(subject).not_to be_registered(reader)
+  end
+
+  context "register_all" do
+    it "registers many IO objects" do
+      pipes = Array.new(3) { IO.pipe }
+      readers = pipes.map(&:first)
+
+      monitors = subject.register_all(readers, :r)
+      expect(monitors.size).to eq 3
+      expect(monitors.map(&:io)).to eq readers
+      expect(monitors.map(&:interests)).to eq [:r, :r, :r]
+      readers.each { |io| expect(subject).to be_registered(io) }
+
+      pipes[1].last << "ohai"
+      expect(subject.select(1)).to eq [monitors[1]]
+    end
+
+    it "raises ArgumentError if an IO object is already registered" do
+      subject.register(reader, :r)
+      expect { subject.register_all([reader], :r) }.to raise_exception ArgumentError
+    end
+
+    it "registers none of the IO objects if one of them can't be" do
+      other_reader, other_writer = IO.pipe
+      subject.register(reader, :r)
+
+      expect { subject.register_all([other_reader, reader], :r) }.to raise_exception ArgumentError
+      expect(subject).not_to be_registered(other_reader)
+      expect(subject.register(other_reader, :r)).to be_a NIO::Monitor
+    ensure
+      [other_reader, other_writer].each { |io| io&.close }
+    end
+  end
+
+  context "deregister_all" do
+    it "deregisters many IO objects" do
+      readers = Array.new(3) { IO.pipe.first }
+      monitors = subject.register_all(readers, :r)
+
+      expect(subject.deregister_all(readers + [writer])).to eq monitors + [nil]
+      monitors.each { |monitor| expect(monitor).to be_closed }
+      expect(subject).to be_empty
+    end
+  end
+
   it "reports if it is empty" do
     expect(subject).to be_empty
     subject.register(reader, :r)
@@ -172,6 +253,17 @@ RSpec.describe NIO::Selector do
       expect(thread.value).to be_within(select_precision).of(timeout)
     end
 
+    it "coalesces repeated wakeups into a single select" do
+      subject.register(reader, :r)
+      3.times { subject.wakeup }
+
+      started_at = Time.now
+      subject.select(1)
+      expect(Time.now - started_at).to be_within(select_precision).of(0)
+
+      expect(subject.select(0)).to be_nil
+    end
+
     it "raises IOError if asked to wake up a closed selector" do
       subject.close
       expect(subject).to be_closed
@@ -245,6 +337,242 @@ RSpec.describe NIO::Selector do
     end
   end
 
+  context "select_into" do
+    it "fills the given array with selected IO objects" do
+      writer << "ohai"
+      unready = IO.pipe.first
+
+      reader_monitor  = subject.register(reader, :r)
+      unready_monitor = subject.register(unready, :r)
+
+      ready = []
+      expect(subject.select_into(ready, 0)).to equal ready
+      expect(ready).to eq [reader_monitor]
+      expect(ready).not_to include unready_monitor
+    end
+
+    it "clears the given array before selecting" do
+      writer << "ohai"
+      monitor = subject.register(reader, :r)
+
+      ready = [:stale]
+      subject.select_into(ready, 0)
+      expect(ready).to eq [monitor]
+
+      reader.read(4)
+      expect(subject.select_into(ready, 0)).to be_nil
+      expect(ready).to be_empty
+    end
+
+    it "raises TypeError if not given an array" do
+      expect { subject.select_into(nil, 0) }.to raise_exception TypeError
+    end
+
+    it "raises IOError if asked to select on a closed selector" do
+      subject.close
+
+      expect { subject.select_into([], 0) }.to raise_exception IOError
+    end
+  end
+
+  context "select_raw" do
+    before { skip "#{NIO.engine} doesn't support select_raw" unless described_class.method_defined?(:select_raw) }
+
+    it "packs ready descriptors and their readiness into a string" do
+      subject.register(reader, :r)
+      other_reader, other_writer = IO.pipe
+      subject.register(other_writer, :w)
+      subject.register(other_reader, :r)
+      writer << "ohai"
+
+      raw = subject.select_raw(0)
+      expect(raw.encoding).to eq Encoding::BINARY
+      expect(raw.unpack("l*").each_slice(2).sort).to eq [[reader.fileno, 1], [other_writer.fileno, 2]].sort
+    end
+
+    it "reuses the given string" do
+      subject.register(reader, :r)
+      writer << "ohai"
+
+      buffer = +"stale"
+      expect(subject.select_raw(0, buffer)).to equal buffer
+      expect(buffer.unpack("l*")).to eq [reader.fileno, 1]
+    end
+
+    it "returns nil when the timeout elapses" do
+      subject.register(reader, :r)
+      expect(subject.select_raw(0)).to be_nil
+    end
+
+    it "yields expired timers" do
+      timer = subject.add_timer(0)
+      yielded = []
+
+      expect(subject.select_raw(1) { |object| yielded << object }).to eq ""
+      expect(yielded).to eq [timer]
+    end
+
+    it "raises ArgumentError without a block while timers are pending" do
+      timer = subject.add_timer(0)
+      expect { subject.select_raw(0) }.to raise_exception ArgumentError
+
+      timer.cancel
+      expect(subject.select_raw(0)).to be_nil
+    end
+  end
+
+  context "dispatch" do
+    before { skip "#{NIO.engine} doesn't support dispatch modes" unless described_class.method_defined?(:dispatch) }
+
+    let(:other_pair) { IO.pipe }
+
+    it "yields inline by default" do
+      expect(subject.dispatch).to eq :inline
+    end
+
+    it "can be chosen when creating the selector" do
+      expect(described_class.new(dispatch: :deferred).dispatch).to eq :deferred
+    end
+
+    it "raises ArgumentError for unknown dispatch modes" do
+      expect { subject.dispatch = :later }.to raise_exception ArgumentError
+      expect { described_class.new(dispatch: :later) }.to raise_exception ArgumentError
+    end
+
+    it "yields ready monitors once the loop has run when deferred" do
+      subject.dispatch = :deferred
+      monitors = [subject.register(reader, :r), subject.register(other_pair.first, :r)]
+      writer << "ohai"
+      other_pair.last << "ohai"
+
+      yielded = []
+      expect(subject.select(0) { |monitor| yielded << monitor }).to eq 2
+      expect(yielded).to include(*monitors)
+      expect(yielded.size).to eq 2
+    end
+
+    it "calls monitors' Proc and Method values, handing the others over as usual" do
+      subject.dispatch = :call
+      called = []
+      proc_monitor = subject.register(reader, :r)
+      proc_monitor.value = proc { |monitor| called << monitor }
+      method_monitor = subject.register(other_pair.first, :r)
+      method_monitor.value = called.method(:push)
+      plain_pair = IO.pipe
+      plain_monitor = subject.register(plain_pair.first, :r)
+
+      [writer, other_pair.last, plain_pair.last].each { |io| io << "ohai" }
+
+      expect(subject.select(0)).to eq [plain_monitor]
+      expect(called).to include(proc_monitor, method_monitor)
+      expect(called.size).to eq 2
+
+      called.clear
+      yielded = []
+      expect(subject.select(0) { |monitor| yielded << monitor }).to eq 3
+      expect(yielded).to eq [plain_monitor]
+      expect(called.size).to eq 2
+    end
+  end
+
+  context "fiber scheduler hooks" do
+    before { skip "#{NIO.engine} doesn't support fiber scheduler hooks" unless described_class.method_defined?(:io_wait) }
+
+    it "resumes a fiber waiting on an IO once it's ready" do
+      result = nil
+      fiber = Fiber.new { result = subject.io_wait(reader, IO::READABLE | IO::WRITABLE) }
+      fiber.resume
+
+      expect(subject.select(0)).to be_nil
+      expect(result).to be_nil
+
+      writer << "ohai"
+      expect(subject.select(1)).to eq []
+      expect(result).to eq IO::READABLE
+      expect(fiber).not_to be_alive
+    end
+
+    it "resumes a waiting fiber with false once its timeout passes" do
+      result = nil
+      fiber = Fiber.new { result = subject.io_wait(reader, IO::READABLE, 0.01) }
+      fiber.resume
+
+      subject.select(1)
+      expect(result).to be false
+      expect(fiber).not_to be_alive
+    end
+
+    it "doesn't register a monitor for the IO" do
+      Fiber.new { subject.io_wait(reader, IO::READABLE) }.resume
+
+      expect(subject).not_to be_registered(reader)
+      expect(subject.register(reader, :r)).to be_a NIO::Monitor
+    end
+
+    it "keeps waiting after the fiber is resumed by something else" do
+      results = []
+      fiber = Fiber.new do
+        results << subject.io_wait(reader, IO::READABLE)
+        results << subject.io_wait(reader, IO::READABLE, 0.5)
+      end
+      fiber.resume
+      fiber.resume(:early)
+
+      writer << "ohai"
+      subject.select(1)
+      expect(results).to eq [:early, IO::READABLE]
+    end
+
+    it "resumes the other fibers on the next select when one raises" do
+      results = []
+      fibers = Array.new(3) do |i|
+        Fiber.new do
+          subject.kernel_sleep(0)
+          raise ArgumentError, "derp" if i.zero?
+
+          results << i
+        end
+      end
+      fibers.each(&:resume)
+
+      expect { subject.select(1) }.to raise_exception(ArgumentError, "derp")
+      subject.select(1)
+      expect(results).to eq [1, 2]
+
+      subject.close
+      GC.start
+    end
+
+    it "sleeps fibers" do
+      result = nil
+      Fiber.new { result = subject.kernel_sleep(0.01) }.resume
+
+      subject.select(1)
+      expect(result).to be false
+    end
+
+    it "unblocks blocked fibers from other threads" do
+      result = nil
+      fiber = Fiber.new { result = subject.block(:blocker) }
+      fiber.resume
+
+      Thread.new { subject.unblock(:blocker, fiber) }.join
+      expect(subject.select(1)).to eq []
+      expect(result).to be true
+    end
+
+    it "raises ArgumentError when given no events or a negative timeout" do
+      expect { subject.io_wait(reader, 0) }.to raise_exception ArgumentError
+      expect { subject.kernel_sleep(-1) }.to raise_exception ArgumentError
+    end
+
+    it "raises IOError if the selector is closed" do
+      subject.close
+
+      expect { subject.io_wait(reader, IO::READABLE) }.to raise_exception IOError
+    end
+  end
+
   it "closes" do
     subject.close
     expect(subject).to be_closed
@@ -0,0 +1,134 @@
+# frozen_string_literal: true
+
+# Released under the MIT License.
+
+require "spec_helper"
+
+RSpec.describe NIO::Timer do
+  let(:selector) { NIO::Selector.new }
+
+  before { skip "#{NIO.engine} doesn't support timers" unless NIO::Selector.method_defined?(:add_timer) }
+
+  after { selector.close }
+
+  it "is selected once it expires" do
+    timer = selector.add_timer(0.05, :idle)
+    expect(timer).to be_active
+    expect(timer.value).to eq :idle
+    expect(timer.selector).to eq selector
+    expect(selector.select(0)).to be_nil
+
+    expect(selector.select).to eq [timer]
+    expect(timer).not_to be_active
+    expect(timer.remaining).to be_nil
+  end
+
+  it "is yielded along with ready monitors" do
+    reader, writer = IO.pipe
+    monitor = selector.register(reader, :r)
+    timer = selector.add_timer(0)
+    writer << "ohai"
+
+    selected = []
+    expect(selector.select(1) { |ready| selected << ready }).to eq 2
+    expect(selected).to include(monitor, timer)
+  ensure
+    reader.close
+    writer.close
+  end
+
+  it "survives garbage collection while only the selector refers to it" do
+    GC.start
+    100.times do |i|
+      selector.add_timer(0.001 * (i % 5), i)
+      GC.start(full_mark: false)
+    end
+
+    values = []
+    values.concat(selector.select(0.05).map(&:value)) while values.size < 100
+    expect(values.sort).to eq (0...100).to_a
+  end
+
+  it "doesn't fire once cancelled" do
+    timer = selector.add_timer(0.01)
+    expect(timer.cancel).to be true
+    expect(timer.cancel).to be false
+    expect(selector.select(0.05)).to be_nil
+  end
+
+  it "fires in order of deadline" do
+    later = selector.add_timer(0.1, :later)
+    sooner = selector.add_timer(0.02, :sooner)
+
+    expect(selector.select(1)).to eq [sooner]
+    expect(selector.select(1)).to eq [later]
+  end
+
+  it "can be pushed back" do
+    timer = selector.add_timer(0.05)
+    timer.reschedule(0.5)
+    expect(timer.interval).to eq 0.5
+
+    # Pushed back past its original deadline, so the select times out
+    expect(selector.select(0.2)).to be_nil
+    expect(timer).to be_active
+    expect(selector.select(1)).to eq [timer]
+  end
+
+  it "doesn't wake a select without a timeout when pushed back" do
+    timer = selector.add_timer(0.02)
+    timer.reschedule(0.1)
+
+    started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+    expect(selector.select).to eq [timer]
+    expect(Process.clock_gettime(Process::CLOCK_MONOTONIC) - started).to be >= 0.09
+  end
+
+  it "can be brought forward" do
+    timer = selector.add_timer(10)
+    timer.reschedule(0.01)
+    expect(timer.remaining).to be <= 0.01
+    expect(selector.select(1)).to eq [timer]
+  end
+
+  it "can be restarted once it has fired" do
+    timer = selector.add_timer(0)
+    expect(selector.select(1)).to eq [timer]
+
+    timer.reschedule
+    expect(timer).to be_active
+    expect(selector.select(1)).to eq [timer]
+  end
+
+  it "wakes up a select in another thread which would wait past it" do
+    selector = self.selector
+    thread = Thread.new do
+      started = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      selected = selector.select(2) until selected.is_a?(Array) && !selected.empty?
+      [selected, Process.clock_gettime(Process::CLOCK_MONOTONIC) - started]
+    end
+    Thread.pass while thread.status && thread.status != "sleep"
+
+    timer = selector.add_timer(0.1)
+    later = selector.add_timer(10)
+    later.reschedule(0.2)
+
+    selected, elapsed = thread.value
+    expect(selected).to eq [timer]
+    expect(elapsed).to be < 1
+    expect(selector.select(1)).to eq [later]
+  end
+
+  it "raises ArgumentError if given a negative interval" do
+    expect { selector.add_timer(-1) }.to raise_error(ArgumentError)
+    expect { selector.add_timer(1).reschedule(-1) }.to raise_error(ArgumentError)
+  end
+
+  it "stops when the selector is closed" do
+    timer = selector.add_timer(1)
+    selector.close
+    expect(timer).not_to be_active
+    expect { timer.reschedule }.to raise_error(IOError)
+    expect { selector.add_timer(1) }.to raise_error(IOError)
+  end
+end